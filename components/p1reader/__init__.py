@@ -1,33 +1,124 @@
+import logging
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome import pins
-from esphome.components import uart
+from esphome import automation, pins
+from esphome.components import time, uart, web_server_base
+from esphome.components.web_server_base import CONF_WEB_SERVER_BASE_ID
 from esphome.const import (
-    CONF_UART_ID, CONF_ID
+    CONF_UART_ID, CONF_ID, CONF_PORT, CONF_SIZE, CONF_TIME_ID
 )
+from esphome.core import CORE
+
+_LOGGER = logging.getLogger(__name__)
 
 CODEOWNERS = ["cadwal"]
 
 MULTI_CONF = True
 
 DEPENDENCIES = ["uart"]
-AUTO_LOAD = ["sensor", "text_sensor"]
+
+
+def AUTO_LOAD():
+    # socket is only needed, and only compiled in, when a reader streams to TCP
+    readers = (CORE.raw_config or {}).get("p1reader") or []
+    if isinstance(readers, dict):
+        readers = [readers]
+    if any(isinstance(reader, dict) and CONF_STREAM in reader for reader in readers):
+        return ["sensor", "text_sensor", "socket"]
+    return ["sensor", "text_sensor"]
+
 
 CONF_P1READER_ID = "p1reader_id"
 CONF_BUFFER_SIZE = "buffer_size"
 CONF_PROTOCOL = "protocol"
+CONF_READ_MODE = "read_mode"
+CONF_TRACE_SIZE = "trace_size"
+CONF_DECRYPTION_KEY = "decryption_key"
+CONF_AUTHENTICATION_KEY = "authentication_key"
+CONF_PEAK_PERIOD = "peak_period"
+CONF_PEAK_TOP_N = "peak_top_n"
+CONF_HISTORY = "history"
+CONF_STREAM = "stream"
 
 p1reader_ns = cg.esphome_ns.namespace("esphome::p1_reader")
 P1Reader = p1reader_ns.class_("P1Reader", cg.PollingComponent, uart.UARTDevice)
+DumpTraceAction = p1reader_ns.class_("DumpTraceAction", automation.Action)
+
+
+def validate_key(value):
+    value = cv.string_strict(value).replace(" ", "")
+    if len(value) != 32:
+        raise cv.Invalid("Key must be 32 hex characters (16 bytes)")
+    try:
+        bytes.fromhex(value)
+    except ValueError as err:
+        raise cv.Invalid("Key must be hex characters") from err
+    return value.upper()
+
+
+def validate_buffer_size(value):
+    # Sizes below 64 were accepted before, raise them rather than break existing configs
+    value = cv.int_range(min=1, max=16384)(value)
+    if value < 64:
+        _LOGGER.warning("%s %d is below the minimum, using 64", CONF_BUFFER_SIZE, value)
+        value = 64
+    return value
+
+
+def validate_peak_period(value):
+    value = cv.positive_time_period_seconds(value)
+    if value.total_seconds < 60 or 3600 % value.total_seconds != 0:
+        raise cv.Invalid("peak_period must be whole minutes that divide an hour, such as 15min or 60min")
+    return value
+
+
+def validate_decryption(config):
+    if CONF_DECRYPTION_KEY in config and config[CONF_PROTOCOL] != "hdlc":
+        raise cv.Invalid(f"{CONF_DECRYPTION_KEY} is only supported with protocol hdlc")
+    if CONF_AUTHENTICATION_KEY in config and CONF_DECRYPTION_KEY not in config:
+        raise cv.Invalid(f"{CONF_AUTHENTICATION_KEY} requires {CONF_DECRYPTION_KEY}")
+    return config
+
 
 CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(P1Reader),
-            cv.Optional(CONF_BUFFER_SIZE, default=60): cv.int_,
+            cv.Optional(CONF_BUFFER_SIZE): validate_buffer_size,
             cv.Optional(CONF_PROTOCOL, default="ascii"): cv.string,
+            cv.Optional(CONF_READ_MODE, default="polling"): cv.one_of(
+                "polling", "loop", "adaptive", lower=True
+            ),
+            cv.Optional(CONF_TRACE_SIZE, default=0): cv.int_range(min=0, max=4096),
+            cv.Optional(CONF_DECRYPTION_KEY): validate_key,
+            cv.Optional(CONF_AUTHENTICATION_KEY): validate_key,
+            cv.Optional(CONF_PEAK_PERIOD, default="60min"): validate_peak_period,
+            cv.Optional(CONF_PEAK_TOP_N, default=3): cv.int_range(min=1, max=10),
+            cv.Optional(CONF_TIME_ID): cv.use_id(time.RealTimeClock),
+            # Served at /p1reader/<id>/history, requires web_server
+            cv.Optional(CONF_HISTORY): cv.Schema(
+                {
+                    cv.GenerateID(CONF_WEB_SERVER_BASE_ID): cv.use_id(
+                        web_server_base.WebServerBase
+                    ),
+                    cv.Optional(CONF_SIZE, default=16384): cv.int_range(
+                        min=1024, max=262144
+                    ),
+                }
+            ),
+            # Raw uart data to TCP clients
+            cv.Optional(CONF_STREAM): cv.Schema(
+                {
+                    cv.Optional(CONF_PORT, default=8088): cv.port,
+                    cv.Optional(CONF_BUFFER_SIZE, default=2048): cv.int_range(
+                        min=256, max=32768
+                    ),
+                }
+            ),
         }
     ).extend(uart.UART_DEVICE_SCHEMA),
+    validate_decryption,
     cv.only_with_arduino,
 )
 
@@ -38,7 +129,46 @@ async def to_code(config):
     await cg.register_component(var, config)
 
     cg.add(var.set_protocol_type(config[CONF_PROTOCOL]))
-    if config[CONF_PROTOCOL] == "ascii":
-        cg.add_define("BUF_SIZE", config[CONF_BUFFER_SIZE])
+    cg.add(var.set_read_mode(config[CONF_READ_MODE]))
+    # Holds a line for ascii and a complete frame for hdlc, per instance
+    if CONF_BUFFER_SIZE in config:
+        cg.add(var.set_buffer_size(config[CONF_BUFFER_SIZE]))
+    elif config[CONF_PROTOCOL] == "ascii":
+        cg.add(var.set_buffer_size(256))
     else:
-        cg.add_define("BUF_SIZE", 4096)
+        cg.add(var.set_buffer_size(4096))
+    cg.add(var.set_trace_size(config[CONF_TRACE_SIZE]))
+    if CONF_DECRYPTION_KEY in config:
+        cg.add_define("USE_P1READER_DECRYPTION")
+        cg.add(var.set_decryption_key(config[CONF_DECRYPTION_KEY]))
+    if CONF_AUTHENTICATION_KEY in config:
+        cg.add(var.set_authentication_key(config[CONF_AUTHENTICATION_KEY]))
+    cg.add(var.set_peak_period(config[CONF_PEAK_PERIOD].total_seconds))
+    cg.add(var.set_peak_top_n(config[CONF_PEAK_TOP_N]))
+    if CONF_HISTORY in config:
+        history = config[CONF_HISTORY]
+        server = await cg.get_variable(history[CONF_WEB_SERVER_BASE_ID])
+        cg.add_define("USE_P1READER_HISTORY")
+        cg.add(
+            var.set_history(
+                server, history[CONF_SIZE], f"/p1reader/{config[CONF_ID].id}/history"
+            )
+        )
+    if CONF_STREAM in config:
+        stream = config[CONF_STREAM]
+        cg.add_define("USE_P1READER_STREAM")
+        cg.add(var.set_stream(stream[CONF_PORT], stream[CONF_BUFFER_SIZE]))
+    if CONF_TIME_ID in config:
+        time_ = await cg.get_variable(config[CONF_TIME_ID])
+        cg.add(var.set_time(time_))
+
+
+@automation.register_action(
+    "p1reader.dump_trace",
+    DumpTraceAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(P1Reader)}),
+)
+async def p1reader_dump_trace_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
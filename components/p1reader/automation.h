@@ -0,0 +1,26 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/automation.h"
+#include "p1reader.h"
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        template<typename... Ts> class DumpTraceAction : public Action<Ts...>, public Parented<P1Reader>
+        {
+        public:
+            void play(Ts... x) override
+            {
+                this->parent_->dump_trace();
+            }
+        };
+    } // namespace p1_reader
+} // namespace esphome
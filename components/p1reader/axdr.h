@@ -0,0 +1,239 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // A-XDR encoded DLMS/COSEM data (IEC 62056-6-2) as sent in HDLC push notifications
+        const uint8_t AXDR_NULL = 0x00;
+        const uint8_t AXDR_ARRAY = 0x01;
+        const uint8_t AXDR_STRUCTURE = 0x02;
+        const uint8_t AXDR_OCTET_STRING = 0x09;
+        const uint8_t AXDR_VISIBLE_STRING = 0x0a;
+        const uint8_t AXDR_UTF8_STRING = 0x0c;
+        const uint8_t AXDR_INTEGER = 0x0f;
+        const uint8_t AXDR_COMPACT_ARRAY = 0x13;
+        const uint8_t AXDR_ENUM = 0x16;
+        const uint8_t AXDR_DATE_TIME = 0x19;
+        const uint8_t AXDR_FLOAT32 = 0x17;
+        const uint8_t AXDR_FLOAT64 = 0x18;
+
+        // Contents length of a type, either a fixed number of bytes or one of these
+        const int8_t AXDR_LENGTH_BYTES = -1;     // BER length in bytes
+        const int8_t AXDR_LENGTH_BITS = -2;      // BER length in bits
+        const int8_t AXDR_LENGTH_ELEMENTS = -3;  // BER element count, the elements follow as items of their own
+        const int8_t AXDR_LENGTH_COMPACT = -4;   // Type description followed by BER length in bytes
+        const int8_t AXDR_LENGTH_UNKNOWN = -5;
+
+        const uint8_t AXDR_NUMBER = 0x01;
+        const uint8_t AXDR_SIGNED = 0x02;
+        const uint8_t AXDR_FLOAT = 0x04;
+
+        struct AxdrType
+        {
+            int8_t length;
+            uint8_t flags;
+        };
+
+        // Indexed by type tag
+        static constexpr AxdrType AXDR_TYPES[] = {
+            { 0, 0 },                                   // 0x00 null-data
+            { AXDR_LENGTH_ELEMENTS, 0 },                // 0x01 array
+            { AXDR_LENGTH_ELEMENTS, 0 },                // 0x02 structure
+            { 1, 0 },                                   // 0x03 boolean
+            { AXDR_LENGTH_BITS, 0 },                    // 0x04 bit-string
+            { 4, AXDR_NUMBER | AXDR_SIGNED },           // 0x05 double-long
+            { 4, AXDR_NUMBER },                         // 0x06 double-long-unsigned
+            { AXDR_LENGTH_UNKNOWN, 0 },                 // 0x07 floating-point (not used in A-XDR)
+            { AXDR_LENGTH_UNKNOWN, 0 },                 // 0x08 unused
+            { AXDR_LENGTH_BYTES, 0 },                   // 0x09 octet-string
+            { AXDR_LENGTH_BYTES, 0 },                   // 0x0a visible-string
+            { AXDR_LENGTH_UNKNOWN, 0 },                 // 0x0b unused
+            { AXDR_LENGTH_BYTES, 0 },                   // 0x0c utf8-string
+            { 1, 0 },                                   // 0x0d bcd
+            { AXDR_LENGTH_UNKNOWN, 0 },                 // 0x0e unused
+            { 1, AXDR_NUMBER | AXDR_SIGNED },           // 0x0f integer
+            { 2, AXDR_NUMBER | AXDR_SIGNED },           // 0x10 long
+            { 1, AXDR_NUMBER },                         // 0x11 unsigned
+            { 2, AXDR_NUMBER },                         // 0x12 long-unsigned
+            { AXDR_LENGTH_COMPACT, 0 },                 // 0x13 compact-array
+            { 8, AXDR_NUMBER | AXDR_SIGNED },           // 0x14 long64
+            { 8, AXDR_NUMBER },                         // 0x15 long64-unsigned
+            { 1, 0 },                                   // 0x16 enum
+            { 4, AXDR_NUMBER | AXDR_SIGNED | AXDR_FLOAT }, // 0x17 float32
+            { 8, AXDR_NUMBER | AXDR_SIGNED | AXDR_FLOAT }, // 0x18 float64
+            { 12, 0 },                                  // 0x19 date-time
+            { 5, 0 },                                   // 0x1a date
+            { 4, 0 },                                   // 0x1b time
+        };
+
+        static constexpr uint8_t AXDR_TYPE_COUNT = sizeof(AXDR_TYPES) / sizeof(AXDR_TYPES[0]);
+
+        struct AxdrItem
+        {
+            uint8_t tag;
+            const uint8_t* data;
+            uint16_t length;    // Contents in bytes, or number of elements for arrays and structures
+        };
+
+        inline bool axdrLength(const uint8_t*& pos, const uint8_t* end, uint16_t& length)
+        {
+            if (pos >= end)
+                return false;
+
+            uint8_t first = *pos++;
+            if (first < 0x80)
+            {
+                length = first;
+                return true;
+            }
+
+            uint8_t bytes = first & 0x7f;
+            if (bytes == 0 || bytes > 2 || end - pos < bytes)
+                return false;
+
+            length = 0;
+            while (bytes-- > 0)
+                length = (length << 8) | *pos++;
+            return true;
+        }
+
+        // Type descriptions only appear in compact arrays, nesting is bounded to keep the stack small
+        inline bool axdrSkipTypeDescription(const uint8_t*& pos, const uint8_t* end, uint8_t depth = 0)
+        {
+            if (pos >= end || depth > 4)
+                return false;
+
+            uint8_t tag = *pos++;
+            if (tag == AXDR_ARRAY)
+            {
+                if (end - pos < 2)
+                    return false;
+                pos += 2;
+                return axdrSkipTypeDescription(pos, end, depth + 1);
+            }
+            if (tag == AXDR_STRUCTURE)
+            {
+                uint16_t count;
+                if (!axdrLength(pos, end, count))
+                    return false;
+                for (uint16_t i = 0; i < count; i++)
+                {
+                    if (!axdrSkipTypeDescription(pos, end, depth + 1))
+                        return false;
+                }
+                return true;
+            }
+            return tag < AXDR_TYPE_COUNT && AXDR_TYPES[tag].length != AXDR_LENGTH_UNKNOWN;
+        }
+
+        // Read the item at pos and move past it. Arrays and structures only consume their header,
+        // their elements are returned by the following calls. Returns false at the end of the data
+        // or when the data can not be decoded any further.
+        inline bool axdrNext(const uint8_t*& pos, const uint8_t* end, AxdrItem& item)
+        {
+            if (pos >= end)
+                return false;
+
+            item.tag = *pos++;
+            int8_t length = item.tag < AXDR_TYPE_COUNT ? AXDR_TYPES[item.tag].length : AXDR_LENGTH_UNKNOWN;
+            switch (length)
+            {
+                case AXDR_LENGTH_UNKNOWN:
+                    return false;
+                case AXDR_LENGTH_ELEMENTS:
+                    item.data = nullptr;
+                    return axdrLength(pos, end, item.length);
+                case AXDR_LENGTH_COMPACT:
+                    if (!axdrSkipTypeDescription(pos, end) || !axdrLength(pos, end, item.length))
+                        return false;
+                    break;
+                case AXDR_LENGTH_BITS:
+                    if (!axdrLength(pos, end, item.length))
+                        return false;
+                    item.length = (item.length + 7) / 8;
+                    break;
+                case AXDR_LENGTH_BYTES:
+                    if (!axdrLength(pos, end, item.length))
+                        return false;
+                    break;
+                default:
+                    item.length = length;
+                    break;
+            }
+
+            if (end - pos < item.length)
+                return false;
+
+            item.data = pos;
+            pos += item.length;
+            return true;
+        }
+
+        inline bool axdrIsNumber(const AxdrItem& item)
+        {
+            return item.tag < AXDR_TYPE_COUNT && (AXDR_TYPES[item.tag].flags & AXDR_NUMBER);
+        }
+
+        inline bool axdrIsFloat(const AxdrItem& item)
+        {
+            return AXDR_TYPES[item.tag].flags & AXDR_FLOAT;
+        }
+
+        // Value of an integer number item, sign extended from its length
+        inline int64_t axdrInteger(const AxdrItem& item)
+        {
+            uint64_t value = 0;
+            for (uint16_t i = 0; i < item.length; i++)
+                value = (value << 8) | item.data[i];
+
+            if ((AXDR_TYPES[item.tag].flags & AXDR_SIGNED) && item.length < 8 && (item.data[0] & 0x80))
+                value |= ~0ULL << (item.length * 8);
+
+            return (int64_t)value;
+        }
+
+        // Value of any number item, including the IEEE 754 float types
+        inline double axdrValue(const AxdrItem& item)
+        {
+            if (!(AXDR_TYPES[item.tag].flags & AXDR_FLOAT))
+                return (double)axdrInteger(item);
+
+            uint64_t bits = 0;
+            for (uint16_t i = 0; i < item.length; i++)
+                bits = (bits << 8) | item.data[i];
+
+            if (item.tag == AXDR_FLOAT32)
+            {
+                uint32_t bits32 = (uint32_t)bits;
+                float value;
+                memcpy(&value, &bits32, sizeof(value));
+                return value;
+            }
+
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // COSEM units (IEC 62056-6-2 table 4) reported by the sensors in kilo
+        const uint8_t AXDR_UNIT_W = 27;
+        const uint8_t AXDR_UNIT_VARH = 32;
+
+        inline bool axdrUnitIsKilo(uint8_t unit)
+        {
+            // W, VA, var, Wh, VAh, varh
+            return unit >= AXDR_UNIT_W && unit <= AXDR_UNIT_VARH;
+        }
+    } // namespace p1_reader
+} // namespace esphome
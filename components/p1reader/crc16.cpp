@@ -0,0 +1,122 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#include "crc16.h"
+
+#ifdef USE_ESP32
+#include "esp_rom_crc.h"
+#endif
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        namespace
+        {
+            constexpr uint16_t XMODEM_POLY = 0x1021;
+            constexpr uint16_t X25_POLY = 0x8408; // 0x1021 reflected
+
+            // Entry i is the CRC of the BITS wide value i, msb first
+            template <size_t N, int BITS>
+            constexpr Crc16Table<N> msbFirstTable()
+            {
+                Crc16Table<N> table{};
+                for (size_t i = 0; i < N; i++)
+                {
+                    uint16_t crc = (uint16_t)(i << (16 - BITS));
+                    for (int k = 0; k < BITS; k++)
+                        crc = (crc & 0x8000) != 0 ? (uint16_t)((crc << 1) ^ XMODEM_POLY) : (uint16_t)(crc << 1);
+                    table.entry[i] = crc;
+                }
+                return table;
+            }
+
+            // Entry i is the CRC of the BITS wide value i, lsb first
+            template <size_t N, int BITS>
+            constexpr Crc16Table<N> reflectedTable()
+            {
+                Crc16Table<N> table{};
+                for (size_t i = 0; i < N; i++)
+                {
+                    uint16_t crc = (uint16_t)i;
+                    for (int k = 0; k < BITS; k++)
+                        crc = (crc & 1) != 0 ? (uint16_t)((crc >> 1) ^ X25_POLY) : (uint16_t)(crc >> 1);
+                    table.entry[i] = crc;
+                }
+                return table;
+            }
+
+#if !defined(USE_ESP8266) && !defined(USE_ESP32)
+            // Slicing-by-4, slice k entry n is the CRC of byte n followed by k zero bytes
+            struct X25Slices
+            {
+                Crc16Table<256> slice[4];
+            };
+
+            constexpr X25Slices x25Slices()
+            {
+                X25Slices slices{};
+                slices.slice[0] = reflectedTable<256, 8>();
+                for (size_t k = 1; k < 4; k++)
+                    for (size_t n = 0; n < 256; n++)
+                    {
+                        uint16_t prev = slices.slice[k - 1].entry[n];
+                        slices.slice[k].entry[n] = (uint16_t)((prev >> 8) ^ slices.slice[0].entry[prev & 0xff]);
+                    }
+                return slices;
+            }
+
+            constexpr X25Slices X25_SLICES = x25Slices();
+#elif defined(USE_ESP8266)
+            constexpr Crc16Table<16> X25_NIBBLE = reflectedTable<16, 4>();
+#endif
+        }
+
+#ifdef USE_ESP8266
+        const Crc16Table<16> CRC16_XMODEM_NIBBLE = msbFirstTable<16, 4>();
+
+        uint16_t crc16X25(const uint8_t* data, size_t len, uint16_t crc)
+        {
+            crc = ~crc;
+            for (size_t i = 0; i < len; i++)
+            {
+                crc = (uint16_t)((crc >> 4) ^ X25_NIBBLE.entry[(crc ^ data[i]) & 0x0f]);
+                crc = (uint16_t)((crc >> 4) ^ X25_NIBBLE.entry[(crc ^ (data[i] >> 4)) & 0x0f]);
+            }
+            return ~crc;
+        }
+#else
+        const Crc16Table<256> CRC16_XMODEM_TABLE = msbFirstTable<256, 8>();
+#endif
+
+#ifdef USE_ESP32
+        uint16_t crc16X25(const uint8_t* data, size_t len, uint16_t crc)
+        {
+            // The ROM routine inverts on entry and exit, matching X-25 init and xorout
+            return esp_rom_crc16_le(crc, data, len);
+        }
+#elif !defined(USE_ESP8266)
+        uint16_t crc16X25(const uint8_t* data, size_t len, uint16_t crc)
+        {
+            crc = ~crc;
+            while (len >= 4)
+            {
+                crc ^= (uint16_t)(data[0] | (data[1] << 8));
+                crc = (uint16_t)(X25_SLICES.slice[3].entry[crc & 0xff] ^ X25_SLICES.slice[2].entry[crc >> 8] ^
+                                 X25_SLICES.slice[1].entry[data[2]] ^ X25_SLICES.slice[0].entry[data[3]]);
+                data += 4;
+                len -= 4;
+            }
+            while (len-- > 0)
+            {
+                crc = (uint16_t)((crc >> 8) ^ X25_SLICES.slice[0].entry[(crc ^ *data++) & 0xff]);
+            }
+            return ~crc;
+        }
+#endif
+    } // namespace p1_reader
+} // namespace esphome
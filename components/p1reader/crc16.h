@@ -0,0 +1,57 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        /*  Table driven CRC16 implementations for the two framings.
+
+            ASCII telegrams use CRC-16/XMODEM (polynomial 0x1021, msb first, init 0) which
+            is updated one byte at a time as the telegram streams in. HDLC frames use
+            CRC-16/X-25 (polynomial 0x1021 reflected, init and xorout 0xffff) calculated
+            over a buffer.
+
+            ESP8266 keeps flash and RAM usage down with 16 entry nibble tables. Other
+            targets use full 256 entry byte tables and slicing-by-4 for buffers. On ESP32
+            the X-25 buffer CRC is calculated by the ROM routine.
+        */
+        template <size_t N>
+        struct Crc16Table
+        {
+            uint16_t entry[N];
+        };
+
+#ifdef USE_ESP8266
+        extern const Crc16Table<16> CRC16_XMODEM_NIBBLE;
+
+        inline uint16_t crc16XmodemUpdate(uint16_t crc, uint8_t b)
+        {
+            crc = (uint16_t)((crc << 4) ^ CRC16_XMODEM_NIBBLE.entry[(crc >> 12) ^ (b >> 4)]);
+            crc = (uint16_t)((crc << 4) ^ CRC16_XMODEM_NIBBLE.entry[(crc >> 12) ^ (b & 0x0f)]);
+            return crc;
+        }
+#else
+        extern const Crc16Table<256> CRC16_XMODEM_TABLE;
+
+        inline uint16_t crc16XmodemUpdate(uint16_t crc, uint8_t b)
+        {
+            return (uint16_t)((crc << 8) ^ CRC16_XMODEM_TABLE.entry[(crc >> 8) ^ b]);
+        }
+#endif
+
+        // CRC-16/X-25 of a buffer. Pass the result of a previous call as crc to continue
+        // the calculation over data that is not contiguous.
+        uint16_t crc16X25(const uint8_t* data, size_t len, uint16_t crc = 0);
+    } // namespace p1_reader
+} // namespace esphome
@@ -0,0 +1,174 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/log.h"
+#include <cstdint>
+#include <cstring>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Histogram of how long a phase (read, parse, publish) takes. Bucket i counts
+        // durations below 64us << i, the last bucket everything from 16ms and up.
+        class PhaseTiming
+        {
+        public:
+            static const uint8_t BUCKETS = 10;
+
+            uint32_t buckets[BUCKETS];
+            uint32_t count;
+            uint32_t maxUs;
+
+            PhaseTiming() { reset(); }
+
+            void record(uint32_t us)
+            {
+                uint8_t bucket = 0;
+                while (bucket < BUCKETS - 1 && us >= (64u << bucket))
+                    bucket++;
+
+                buckets[bucket]++;
+                count++;
+                if (us > maxUs)
+                    maxUs = us;
+            }
+
+            void reset()
+            {
+                memset(buckets, 0, sizeof(buckets));
+                count = 0;
+                maxUs = 0;
+            }
+
+            void log(const char* phase) const
+            {
+                ESP_LOGD("diagnostics", "%-7s n=%u max=%uus <64us:%u <128:%u <256:%u <512:%u <1ms:%u <2ms:%u <4ms:%u <8ms:%u <16ms:%u >=16ms:%u",
+                         phase, (unsigned)count, (unsigned)maxUs,
+                         (unsigned)buckets[0], (unsigned)buckets[1], (unsigned)buckets[2], (unsigned)buckets[3], (unsigned)buckets[4],
+                         (unsigned)buckets[5], (unsigned)buckets[6], (unsigned)buckets[7], (unsigned)buckets[8], (unsigned)buckets[9]);
+            }
+        };
+
+        // Time from the meter's timestamp of a telegram to a point in the reader, in ms by the
+        // device clock. Meters stamp whole seconds (ASCII) or hundredths (some HDLC meters), so
+        // this includes up to a second of truncation.
+        class LatencyStats
+        {
+        public:
+            uint32_t count;
+            int64_t sumMs;
+            int32_t minMs;
+            int32_t maxMs;
+
+            LatencyStats() { reset(); }
+
+            void record(int32_t ms)
+            {
+                if (count == 0 || ms < minMs)
+                    minMs = ms;
+                if (count == 0 || ms > maxMs)
+                    maxMs = ms;
+                sumMs += ms;
+                count++;
+            }
+
+            float averageMs() const
+            {
+                return count > 0 ? (float)sumMs / count : 0.0f;
+            }
+
+            void reset()
+            {
+                count = 0;
+                sumMs = 0;
+                minMs = 0;
+                maxMs = 0;
+            }
+
+            void log(const char* point) const
+            {
+                ESP_LOGD("diagnostics", "latency to %-9s n=%u avg=%.0fms min=%dms max=%dms",
+                         point, (unsigned)count, averageMs(), (int)minMs, (int)maxMs);
+            }
+        };
+
+        // Variation in the time from the meter's timestamp to the arrival of a telegram, as the
+        // interarrival jitter of RFC 3550. Only differences between telegrams are used, so the
+        // offset between the meter's clock and millis() does not matter and no synced clock is
+        // needed.
+        class TransitJitter
+        {
+        public:
+            float jitterMs = 0.0f;
+            uint32_t maxMs = 0;     // Largest single difference, reset every period
+
+            void record(uint32_t arrivalMs, int64_t meterMs)
+            {
+                int64_t meterDelta = meterMs - _lastMeterMs;
+                bool valid = _haveLast && meterDelta > 0 && meterDelta < 300000;
+                if (valid)
+                {
+                    int64_t difference = (int64_t)(uint32_t)(arrivalMs - _lastArrivalMs) - meterDelta;
+                    uint32_t absolute = (uint32_t)(difference < 0 ? -difference : difference);
+                    jitterMs += (absolute - jitterMs) / 16.0f;
+                    if (absolute > maxMs)
+                        maxMs = absolute;
+                }
+
+                // A meter clock that jumps (set, daylight saving) starts over
+                _haveLast = true;
+                _lastArrivalMs = arrivalMs;
+                _lastMeterMs = meterMs;
+            }
+
+        protected:
+            bool _haveLast = false;
+            uint32_t _lastArrivalMs = 0;
+            int64_t _lastMeterMs = 0;
+        };
+
+        // Counters for the reader itself, collected on the hot path without logging
+        class ReaderDiagnostics
+        {
+        public:
+            uint32_t bytesRead = 0;
+            uint32_t telegrams = 0;
+            uint32_t crcFailures = 0;
+            uint32_t bufferOverflows = 0;
+            uint32_t framesDroppedLength = 0;
+            uint32_t framesDroppedCrc = 0;
+            uint32_t messagesIncomplete = 0;    // Segments dropped because the rest never came
+            uint32_t gcmFailures = 0;     // Messages that failed decryption or authentication
+
+            // Timing is reset every reporting period
+            PhaseTiming read;
+            PhaseTiming parse;
+            PhaseTiming publish;     // Per call, a telegram may be published over several calls
+            PhaseTiming sensors;     // Per telegram, all sensors
+            PhaseTiming batch;       // Per telegram, the telegram text sensor
+            PhaseTiming decrypt;
+
+            // Most bytes found waiting in the uart buffer by one read, and read by one call
+            uint32_t peakFill = 0;
+            uint32_t peakSliceBytes = 0;
+
+            // From the meter's timestamp to the end of the telegram, its parsing and publishing
+            LatencyStats latencyFrame;
+            LatencyStats latencyParse;
+            LatencyStats latencyPublish;
+            TransitJitter jitter;
+
+            // Counter values at the start of the reporting period, for the rates
+            uint32_t periodStartMs = 0;
+            uint32_t periodBytesRead = 0;
+            uint32_t periodTelegrams = 0;
+        };
+    } // namespace p1_reader
+} // namespace esphome
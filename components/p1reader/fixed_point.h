@@ -0,0 +1,156 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Values are kept as raw * 10^scale so parsing and scaling need no floating point, which
+        // ESP8266 only has in software. They are converted to float once, when published.
+        const int8_t FIXED_MIN_SCALE = -9;
+        const int8_t FIXED_MAX_SCALE = 9;
+
+        inline float fixedToFloat(int64_t raw, int8_t scale)
+        {
+            static const float POW10[] = { 1e-9f, 1e-8f, 1e-7f, 1e-6f, 1e-5f, 1e-4f, 1e-3f, 1e-2f, 1e-1f,
+                                           1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f };
+            if (scale < FIXED_MIN_SCALE || scale > FIXED_MAX_SCALE)
+                return NAN;
+
+            return (float)raw * POW10[scale - FIXED_MIN_SCALE];
+        }
+
+        // 10^exponent for exponent 0..18
+        inline int64_t fixedPow10(uint8_t exponent)
+        {
+            int64_t factor = 1;
+            while (exponent-- > 0)
+                factor *= 10;
+            return factor;
+        }
+
+        // Parse a decimal number such as 00012345.678 up to the first other character (the unit).
+        // Digits beyond what fits in 18 significant digits or 9 decimals are dropped. Fails when
+        // there are no digits, or the integer part is too large for FIXED_MAX_SCALE.
+        inline bool parseFixed(const char* p, int64_t& raw, int8_t& scale)
+        {
+            bool negative = (*p == '-');
+            if (*p == '-' || *p == '+')
+                p++;
+
+            int64_t value = 0;
+            int8_t exponent = 0;
+            uint8_t significant = 0;
+            bool digits = false;
+            bool fraction = false;
+            for (;; p++)
+            {
+                if (*p >= '0' && *p <= '9')
+                {
+                    digits = true;
+                    if (significant >= 18 || (fraction && exponent == FIXED_MIN_SCALE))
+                    {
+                        if (!fraction)
+                        {
+                            if (exponent == FIXED_MAX_SCALE)
+                                return false;
+                            exponent++;
+                        }
+                        continue;
+                    }
+
+                    value = value * 10 + (*p - '0');
+                    if (value != 0)
+                        significant++;
+                    if (fraction)
+                        exponent--;
+                }
+                else if (*p == '.' && !fraction)
+                {
+                    fraction = true;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            if (!digits)
+                return false;
+
+            raw = negative ? -value : value;
+            scale = exponent;
+            return true;
+        }
+
+        // raw * 10^scale expressed at targetScale, truncated when the target is coarser
+        inline int64_t fixedToScale(int64_t raw, int8_t scale, int8_t targetScale)
+        {
+            if (scale > targetScale)
+                return raw * fixedPow10(scale - targetScale);
+            if (scale < targetScale)
+                return raw / fixedPow10(targetScale - scale);
+            return raw;
+        }
+
+        // Decimal text of raw * 10^scale with the decimals of the scale, as sent by the meter.
+        // buf must hold 32 characters, returns the length.
+        inline uint8_t formatFixed(char* buf, int64_t raw, int8_t scale)
+        {
+            char digits[20];
+            uint8_t count = 0;
+            uint64_t value = raw < 0 ? -(uint64_t)raw : (uint64_t)raw;
+            do
+            {
+                digits[count++] = '0' + value % 10;
+                value /= 10;
+            } while (value != 0);
+
+            uint8_t decimals = scale < 0 ? -scale : 0;
+            while (count <= decimals)
+                digits[count++] = '0';
+
+            uint8_t len = 0;
+            if (raw < 0)
+                buf[len++] = '-';
+            while (count > decimals)
+                buf[len++] = digits[--count];
+            for (int8_t i = 0; i < scale; i++)
+                buf[len++] = '0';
+            if (decimals > 0)
+            {
+                buf[len++] = '.';
+                while (count > 0)
+                    buf[len++] = digits[--count];
+            }
+            buf[len] = '\0';
+            return len;
+        }
+
+        // a + b, at the finer of the two scales
+        inline void addFixed(int64_t aRaw, int8_t aScale, int64_t bRaw, int8_t bScale, int64_t& raw, int8_t& scale)
+        {
+            if (aScale > bScale)
+            {
+                aRaw *= fixedPow10(aScale - bScale);
+                aScale = bScale;
+            }
+            else if (bScale > aScale)
+            {
+                bRaw *= fixedPow10(bScale - aScale);
+            }
+
+            raw = aRaw + bRaw;
+            scale = aScale;
+        }
+    } // namespace p1_reader
+} // namespace esphome
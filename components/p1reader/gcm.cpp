@@ -0,0 +1,101 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#include "gcm.h"
+#include "esphome/core/log.h"
+
+#ifdef USE_P1READER_DECRYPTION
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+#ifdef P1READER_GCM_MBEDTLS
+        Aes128Gcm::Aes128Gcm()
+        {
+            mbedtls_gcm_init(&_gcm);
+        }
+
+        Aes128Gcm::~Aes128Gcm()
+        {
+            mbedtls_gcm_free(&_gcm);
+        }
+
+        bool Aes128Gcm::setKey(const uint8_t* key)
+        {
+            _hasKey = mbedtls_gcm_setkey(&_gcm, MBEDTLS_CIPHER_ID_AES, key, 128) == 0;
+            return _hasKey;
+        }
+
+        bool Aes128Gcm::decrypt(const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadLen, 
+                                uint8_t* data, size_t len, const uint8_t* tag, size_t tagLen)
+        {
+            if (!_hasKey)
+                return false;
+
+            if (tag != nullptr)
+            {
+                return mbedtls_gcm_auth_decrypt(&_gcm, len, iv, ivLen, aad, aadLen, tag, tagLen, data, data) == 0;
+            }
+
+            // Nothing to check against, the calculated tag is thrown away
+            uint8_t calculatedTag[16];
+            return mbedtls_gcm_crypt_and_tag(&_gcm, MBEDTLS_GCM_DECRYPT, len, iv, ivLen, aad, aadLen, 
+                                             data, data, sizeof(calculatedTag), calculatedTag) == 0;
+        }
+#elif defined(USE_ESP8266)
+        Aes128Gcm::Aes128Gcm()
+        {
+        }
+
+        Aes128Gcm::~Aes128Gcm()
+        {
+        }
+
+        bool Aes128Gcm::setKey(const uint8_t* key)
+        {
+            br_aes_ct_ctr_init(&_aes, key, 16);
+            br_gcm_init(&_gcm, &_aes.vtable, br_ghash_ctmul32);
+            _hasKey = true;
+            return true;
+        }
+
+        bool Aes128Gcm::decrypt(const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadLen, 
+                                uint8_t* data, size_t len, const uint8_t* tag, size_t tagLen)
+        {
+            if (!_hasKey)
+                return false;
+
+            br_gcm_reset(&_gcm, iv, ivLen);
+            br_gcm_aad_inject(&_gcm, aad, aadLen);
+            br_gcm_flip(&_gcm);
+            br_gcm_run(&_gcm, 0, data, len);
+            return tag == nullptr || br_gcm_check_tag_trunc(&_gcm, tag, tagLen) == 1;
+        }
+#else
+        Aes128Gcm::Aes128Gcm()
+        {
+        }
+
+        Aes128Gcm::~Aes128Gcm()
+        {
+        }
+
+        bool Aes128Gcm::setKey(const uint8_t*)
+        {
+            ESP_LOGE("gcm", "No AES-GCM implementation on this platform");
+            return false;
+        }
+
+        bool Aes128Gcm::decrypt(const uint8_t*, size_t, const uint8_t*, size_t, uint8_t*, size_t, const uint8_t*, size_t)
+        {
+            return false;
+        }
+#endif
+    } // namespace p1_reader
+} // namespace esphome
+#endif
@@ -0,0 +1,56 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#include <cstdint>
+#include <cstddef>
+
+#ifdef USE_P1READER_DECRYPTION
+// mbedTLS on ESP32, and on the host platform when it is installed (also the host tests)
+#if defined(USE_ESP32) || (defined(USE_HOST) && __has_include("mbedtls/gcm.h"))
+#define P1READER_GCM_MBEDTLS
+#endif
+
+#ifdef P1READER_GCM_MBEDTLS
+#include "mbedtls/gcm.h"
+#elif defined(USE_ESP8266)
+#include <bearssl/bearssl.h>
+#endif
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // AES-128-GCM as used by DLMS/COSEM security suite 0. On ESP32 mbedTLS uses the 
+        // AES hardware, on ESP8266 the constant time BearSSL implementation is used. Without
+        // either, setKey() fails and the reader is marked failed.
+        class Aes128Gcm
+        {
+        public:
+            Aes128Gcm();
+            ~Aes128Gcm();
+
+            bool setKey(const uint8_t* key);
+
+            // Decrypt len bytes in place. The authentication tag is only checked when tag is not null.
+            bool decrypt(const uint8_t* iv, size_t ivLen, const uint8_t* aad, size_t aadLen, 
+                         uint8_t* data, size_t len, const uint8_t* tag, size_t tagLen);
+
+        private:
+            bool _hasKey{false};
+#ifdef P1READER_GCM_MBEDTLS
+            mbedtls_gcm_context _gcm;
+#elif defined(USE_ESP8266)
+            br_aes_ct_ctr_keys _aes;
+            br_gcm_context _gcm;
+#endif
+        };
+    } // namespace p1_reader
+} // namespace esphome
+#endif
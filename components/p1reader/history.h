@@ -0,0 +1,278 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Values kept in the history, as integers at a fixed scale
+        const uint8_t HISTORY_IMPORT = 0;       // Momentary active import, W
+        const uint8_t HISTORY_EXPORT = 1;       // Momentary active export, W
+        const uint8_t HISTORY_VOLTAGE_L1 = 2;   // 0.1 V
+        const uint8_t HISTORY_VOLTAGE_L2 = 3;
+        const uint8_t HISTORY_VOLTAGE_L3 = 4;
+        const uint8_t HISTORY_CURRENT_L1 = 5;   // 0.01 A
+        const uint8_t HISTORY_CURRENT_L2 = 6;
+        const uint8_t HISTORY_CURRENT_L3 = 7;
+        const uint8_t HISTORY_CHANNELS = 8;
+
+        struct HistorySample
+        {
+            uint32_t timeMs;
+            uint8_t mask;       // Channels present in this sample
+            int32_t values[HISTORY_CHANNELS];
+        };
+
+        // Position of a reader in a HistoryRing, see HistoryRing::next(). A default constructed
+        // cursor starts at the oldest sample.
+        struct HistoryCursor
+        {
+            uint32_t block{0};      // Sequence number of the block, counts all blocks ever started
+            uint16_t offset{0};     // Bytes of the block already decoded
+            HistorySample sample;   // Last sample decoded, the deltas that follow are added to it
+        };
+
+        // Ring of recent samples compressed as deltas. The memory is split in blocks that each
+        // start with a complete sample (time and values as is), the following samples in the
+        // block store the difference to the sample before as zigzag varints. Readings that
+        // change slowly take one byte per value. When the ring is full the oldest block is
+        // dropped, each block can be decoded on its own. A block also ends when the set of
+        // channels present changes.
+        class HistoryRing
+        {
+        public:
+            static const uint16_t BLOCK_SIZE = 256;
+            // Time (5) and all values (5 each) as varints
+            static const uint8_t MAX_RECORD = 5 + HISTORY_CHANNELS * 5;
+
+            // Size is rounded down to whole blocks, at least two. A size of 0 allocates nothing
+            // and fails.
+            bool allocate(uint32_t size)
+            {
+                if (size == 0)
+                    return false;
+
+                uint16_t blocks = size / BLOCK_SIZE;
+                if (blocks < 2)
+                    blocks = 2;
+
+                _data = new (std::nothrow) uint8_t[(uint32_t)blocks * BLOCK_SIZE];
+                _info = new (std::nothrow) BlockInfo[blocks];
+                if (_data == nullptr || _info == nullptr)
+                {
+                    delete[] _data;
+                    delete[] _info;
+                    _data = nullptr;
+                    _info = nullptr;
+                    return false;
+                }
+
+                _blocks = blocks;
+                return true;
+            }
+
+            bool enabled() const { return _blocks != 0; }
+            uint32_t size() const { return (uint32_t)_blocks * BLOCK_SIZE; }
+
+            // Samples and bytes currently in the ring
+            uint32_t samples() const { return sum(&BlockInfo::samples); }
+            uint32_t bytesUsed() const { return sum(&BlockInfo::used); }
+
+            void add(const HistorySample& sample)
+            {
+                uint8_t record[MAX_RECORD];
+                uint8_t len = 0;
+
+                bool continueBlock = _count > 0 && sample.mask == _last.mask;
+                if (continueBlock)
+                {
+                    len = putVarint(record, sample.timeMs - _last.timeMs);
+                    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+                    {
+                        if (sample.mask & (1 << c))
+                            len += putVarint(record + len, zigzag(sample.values[c] - _last.values[c]));
+                    }
+
+                    uint16_t last = (_first + _count - 1) % _blocks;
+                    if (_info[last].used + len > BLOCK_SIZE)
+                        continueBlock = false;
+                    else
+                        append(last, record, len);
+                }
+
+                if (!continueBlock)
+                {
+                    // Start of block: time, mask and values as is
+                    memcpy(record, &sample.timeMs, 4);
+                    len = 4;
+                    record[len++] = sample.mask;
+                    for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+                    {
+                        if (sample.mask & (1 << c))
+                            len += putVarint(record + len, zigzag(sample.values[c]));
+                    }
+
+                    uint16_t block = newBlock();
+                    append(block, record, len);
+                }
+
+                _last = sample;
+            }
+
+            // Decodes the sample at the cursor and moves past it, false when there are no more.
+            // Samples can be added between calls, a cursor that points into a block that has
+            // been dropped since continues with the oldest sample left.
+            bool next(HistoryCursor& cursor, HistorySample& sample) const
+            {
+                if (cursor.block < _firstBlock)
+                {
+                    cursor.block = _firstBlock;
+                    cursor.offset = 0;
+                }
+
+                while (cursor.block - _firstBlock < _count)
+                {
+                    uint16_t block = (_first + (cursor.block - _firstBlock)) % _blocks;
+                    const uint8_t* start = _data + (uint32_t)block * BLOCK_SIZE;
+                    const uint8_t* pos = start + cursor.offset;
+                    const uint8_t* end = start + _info[block].used;
+                    if (pos >= end)
+                    {
+                        // The newest block may still grow, stay at its end
+                        if (cursor.block - _firstBlock + 1 == _count)
+                            return false;
+                        cursor.block++;
+                        cursor.offset = 0;
+                        continue;
+                    }
+
+                    if (cursor.offset == 0)
+                    {
+                        memcpy(&cursor.sample.timeMs, pos, 4);
+                        pos += 4;
+                        cursor.sample.mask = *pos++;
+                        for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+                        {
+                            cursor.sample.values[c] = (cursor.sample.mask & (1 << c)) ? unzigzag(getVarint(pos, end)) : 0;
+                        }
+                    }
+                    else
+                    {
+                        cursor.sample.timeMs += getVarint(pos, end);
+                        for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+                        {
+                            if (cursor.sample.mask & (1 << c))
+                                cursor.sample.values[c] += unzigzag(getVarint(pos, end));
+                        }
+                    }
+
+                    cursor.offset = pos - start;
+                    sample = cursor.sample;
+                    return true;
+                }
+                return false;
+            }
+
+            // Call f(const HistorySample&) for every sample, oldest first
+            template<typename F> void forEach(F f) const
+            {
+                HistoryCursor cursor;
+                HistorySample sample;
+                while (next(cursor, sample))
+                    f(sample);
+            }
+
+        protected:
+            struct BlockInfo
+            {
+                uint16_t used;
+                uint16_t samples;
+            };
+
+            uint32_t sum(uint16_t BlockInfo::*member) const
+            {
+                uint32_t total = 0;
+                for (uint16_t i = 0; i < _count; i++)
+                    total += _info[(_first + i) % _blocks].*member;
+                return total;
+            }
+
+            uint16_t newBlock()
+            {
+                if (_count == _blocks)
+                {
+                    _first = (_first + 1) % _blocks;
+                    _firstBlock++;
+                    _count--;
+                }
+
+                uint16_t block = (_first + _count) % _blocks;
+                _info[block].used = 0;
+                _info[block].samples = 0;
+                _count++;
+                return block;
+            }
+
+            void append(uint16_t block, const uint8_t* record, uint8_t len)
+            {
+                memcpy(_data + (uint32_t)block * BLOCK_SIZE + _info[block].used, record, len);
+                _info[block].used += len;
+                _info[block].samples++;
+            }
+
+            static uint32_t zigzag(int32_t value)
+            {
+                return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+            }
+
+            static int32_t unzigzag(uint32_t value)
+            {
+                return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+            }
+
+            static uint8_t putVarint(uint8_t* pos, uint32_t value)
+            {
+                uint8_t len = 0;
+                while (value >= 0x80)
+                {
+                    pos[len++] = (uint8_t)value | 0x80;
+                    value >>= 7;
+                }
+                pos[len++] = (uint8_t)value;
+                return len;
+            }
+
+            static uint32_t getVarint(const uint8_t*& pos, const uint8_t* end)
+            {
+                uint32_t value = 0;
+                for (uint8_t shift = 0; pos < end && shift < 35; shift += 7)
+                {
+                    uint8_t b = *pos++;
+                    value |= (uint32_t)(b & 0x7f) << shift;
+                    if (!(b & 0x80))
+                        break;
+                }
+                return value;
+            }
+
+            uint8_t* _data{nullptr};
+            BlockInfo* _info{nullptr};
+            uint16_t _blocks{0};
+            uint16_t _first{0};
+            uint16_t _count{0};
+            // Sequence number of the block at _first
+            uint32_t _firstBlock{0};
+            HistorySample _last;
+        };
+    } // namespace p1_reader
+} // namespace esphome
@@ -0,0 +1,117 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#include "history_handler.h"
+
+#ifdef USE_P1READER_HISTORY
+#include "esphome/core/hal.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#ifdef USE_ESP_IDF
+#include <esp_http_server.h>
+#endif
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Number of decimals of each channel, see history.h
+        static const uint8_t HISTORY_DECIMALS[HISTORY_CHANNELS] = { 0, 0, 1, 1, 1, 2, 2, 2 };
+
+        bool HistoryHandler::canHandle(AsyncWebServerRequest *request)
+        {
+            return request->method() == HTTP_GET && request->url() == _path.c_str();
+        }
+
+        static const char HISTORY_HEADER[] = 
+            "age_ms,import_w,export_w,voltage_l1,voltage_l2,voltage_l3,current_l1,current_l2,current_l3\n";
+
+        size_t HistoryCsv::read(char *buffer, size_t maxLen)
+        {
+            size_t len = 0;
+            while (len < maxLen)
+            {
+                if (_linePos == _lineLen && !nextLine())
+                    break;
+
+                size_t part = _lineLen - _linePos;
+                if (part > maxLen - len)
+                    part = maxLen - len;
+                memcpy(buffer + len, _line + _linePos, part);
+                _linePos += part;
+                len += part;
+            }
+            return len;
+        }
+
+        bool HistoryCsv::nextLine()
+        {
+            _lineLen = 0;
+            _linePos = 0;
+            if (!_headerDone)
+            {
+                _headerDone = true;
+                _lineLen = sizeof(HISTORY_HEADER) - 1;
+                memcpy(_line, HISTORY_HEADER, _lineLen);
+                return true;
+            }
+
+            HistorySample sample;
+            if (!_history->next(_cursor, sample) || (int32_t)(sample.timeMs - _nowMs) > 0)
+                return false;
+
+            int len = snprintf(_line, sizeof(_line), "%u", (unsigned)(_nowMs - sample.timeMs));
+            for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+            {
+                _line[len++] = ',';
+                if (!(sample.mask & (1 << c)))
+                    continue;
+
+                int32_t value = sample.values[c];
+                uint32_t magnitude = value < 0 ? -(uint32_t)value : value;
+                uint32_t divisor = HISTORY_DECIMALS[c] == 0 ? 1 : (HISTORY_DECIMALS[c] == 1 ? 10 : 100);
+                if (divisor == 1)
+                    len += snprintf(_line + len, sizeof(_line) - len, "%d", (int)value);
+                else
+                    len += snprintf(_line + len, sizeof(_line) - len, "%s%u.%0*u", value < 0 ? "-" : "",
+                                    (unsigned)(magnitude / divisor), HISTORY_DECIMALS[c], (unsigned)(magnitude % divisor));
+            }
+            _line[len++] = '\n';
+            _lineLen = len;
+            return true;
+        }
+
+        void HistoryHandler::handleRequest(AsyncWebServerRequest *request)
+        {
+            // The ring holds up to tens of kB as CSV, so it is sent in chunks instead of 
+            // building the whole response in memory
+#ifdef USE_ESP_IDF
+            // web_server_idf runs the handler in the httpd task, send the chunks from here
+            httpd_req_t *req = *request;
+            httpd_resp_set_type(req, "text/csv");
+            HistoryCsv csv(_history, millis());
+            char chunk[512];
+            size_t len;
+            while ((len = csv.read(chunk, sizeof(chunk))) > 0)
+            {
+                if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK)
+                    return;
+            }
+            httpd_resp_send_chunk(req, nullptr, 0);
+#else
+            // ESPAsyncWebServer asks for each chunk when the connection can take it
+            auto csv = std::make_shared<HistoryCsv>(_history, millis());
+            request->send(request->beginChunkedResponse("text/csv", [csv](uint8_t *buffer, size_t maxLen, size_t) -> size_t
+            {
+                return csv->read((char *)buffer, maxLen);
+            }));
+#endif
+        }
+    } // namespace p1_reader
+} // namespace esphome
+#endif
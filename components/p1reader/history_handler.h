@@ -0,0 +1,63 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_P1READER_HISTORY
+#include "esphome/components/web_server_base/web_server_base.h"
+#include "history.h"
+#include <string>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Writes the history as CSV, oldest sample first, a piece at a time into the buffers
+        // of a chunked response. Only the line being written is held, samples are decoded
+        // from the ring as they are needed. The age column is the number of ms before
+        // nowMs, samples added after that are left out.
+        class HistoryCsv
+        {
+        public:
+            HistoryCsv(const HistoryRing *history, uint32_t nowMs) : _history(history), _nowMs(nowMs)
+            {}
+
+            // Fills up to maxLen bytes, returns 0 at the end
+            size_t read(char *buffer, size_t maxLen);
+
+        private:
+            const HistoryRing *_history;
+            uint32_t _nowMs;
+            HistoryCursor _cursor;
+            bool _headerDone{false};
+
+            char _line[16 + HISTORY_CHANNELS * 14];
+            uint16_t _lineLen{0};
+            uint16_t _linePos{0};
+
+            bool nextLine();
+        };
+
+        // Serves the history ring as CSV in a chunked response
+        class HistoryHandler : public AsyncWebHandler
+        {
+        public:
+            HistoryHandler(const HistoryRing *history, const std::string &path) : _history(history), _path(path)
+            {}
+
+            bool canHandle(AsyncWebServerRequest *request) override;
+            void handleRequest(AsyncWebServerRequest *request) override;
+
+        private:
+            const HistoryRing *_history;
+            std::string _path;
+        };
+    } // namespace p1_reader
+} // namespace esphome
+#endif
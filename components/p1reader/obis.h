@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#include <cstdint>
+#include <cstring>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        /*  OBIS codes A-B:C.D.E packed into a single integer key, used by both the ASCII
+            and the HDLC parser to look up values. A and B (medium and channel) get four
+            bits each, C, D and E a byte each. Codes that don't fit map to 0 which is
+            never a valid key.
+        */
+        constexpr uint32_t obisKey(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+        {
+            return (a > 15 || b > 15) ? 0 : ((uint32_t)a << 28) | ((uint32_t)b << 24) | ((uint32_t)c << 16) | ((uint32_t)d << 8) | e;
+        }
+
+        // Parse the "A-B:C.D.E" prefix of an ASCII row and leave p at the first character
+        // after it. Returns 0 if the row doesn't start with a complete OBIS code.
+        inline uint32_t parseObisKey(const char*& p)
+        {
+            static const char SEPARATORS[] = { '-', ':', '.', '.' };
+            uint16_t group[5];
+
+            for (int i = 0; i < 5; i++)
+            {
+                if (*p < '0' || *p > '9')
+                    return 0;
+
+                uint16_t value = 0;
+                while (*p >= '0' && *p <= '9')
+                {
+                    value = value * 10 + (*p++ - '0');
+                    if (value > 255)
+                        return 0;
+                }
+                group[i] = value;
+
+                if (i < 4 && *p++ != SEPARATORS[i])
+                    return 0;
+            }
+
+            return obisKey(group[0], group[1], group[2], group[3], group[4]);
+        }
+
+#ifdef USE_P1READER_OBIS_SENSORS
+        // The codes of the sensors declared with obis: in the yaml, kept sorted and merged into
+        // the reader's RowTable (parsed_message.h) in setup(). The sensors can come from several
+        // sensor blocks of the same reader, in any order, so the table has room for one bit per
+        // sensor in the masks of ParsedMessage.
+        static const uint8_t OBIS_SENSORS_MAX = 32;
+
+        class ObisSensorKeys
+        {
+        public:
+            // Inserts the code in order, returns its index or -1 if the table is full or
+            // the code is already there. The indexes of the codes after it move up by one.
+            int8_t add(uint32_t key)
+            {
+                if (_count == OBIS_SENSORS_MAX)
+                    return -1;
+                uint8_t index = lowerBound(key);
+                if (index < _count && _keys[index] == key)
+                    return -1;
+                memmove(&_keys[index + 1], &_keys[index], (_count - index) * sizeof(_keys[0]));
+                _keys[index] = key;
+                _count++;
+                return index;
+            }
+
+            uint8_t count() const { return _count; }
+            uint32_t key(uint8_t index) const { return _keys[index]; }
+
+            // Index of the sensor for the code, -1 if there is none
+            int8_t find(uint32_t key) const
+            {
+                uint8_t index = lowerBound(key);
+                return (index < _count && _keys[index] == key) ? index : -1;
+            }
+
+        protected:
+            uint32_t _keys[OBIS_SENSORS_MAX];
+            uint8_t _count{0};
+
+            uint8_t lowerBound(uint32_t key) const
+            {
+                uint8_t low = 0;
+                uint8_t high = _count;
+                while (low < high)
+                {
+                    uint8_t mid = (low + high) / 2;
+                    if (_keys[mid] < key)
+                        low = mid + 1;
+                    else
+                        high = mid;
+                }
+                return low;
+            }
+        };
+#endif
+    } // namespace p1_reader
+} // namespace esphome
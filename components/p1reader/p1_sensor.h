@@ -0,0 +1,55 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+// 
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/hal.h"
+#include "esphome/components/sensor/sensor.h"
+#include <cmath>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Sensor that only publishes a new value when it has moved more than deadband 
+        // since the last published value, or when max_interval has passed (heartbeat).
+        // Without a deadband every value is published.
+        class P1Sensor : public sensor::Sensor
+        {
+        public:
+            void set_deadband(float deadband) { _deadband = deadband; }
+            void set_max_interval(uint32_t maxIntervalMs) { _maxIntervalMs = maxIntervalMs; }
+
+            // Returns false if the value was suppressed
+            bool publishIfChanged(float value)
+            {
+                uint32_t now = millis();
+
+                if (_deadband >= 0.0f && _hasPublished &&
+                    fabsf(value - _lastValue) <= _deadband &&
+                    (_maxIntervalMs == 0 || (now - _lastPublishMs) < _maxIntervalMs))
+                {
+                    return false;
+                }
+
+                _lastValue = value;
+                _lastPublishMs = now;
+                _hasPublished = true;
+                publish_state(value);
+                return true;
+            }
+
+        protected:
+            float _deadband{-1.0f};
+            uint32_t _maxIntervalMs{0};
+
+            float _lastValue{0.0f};
+            uint32_t _lastPublishMs{0};
+            bool _hasPublished{false};
+        };
+    } // namespace p1_reader
+} // namespace esphome
@@ -24,6 +24,12 @@
 
 #include "p1reader.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sys/time.h>
+
 namespace esphome
 {
     namespace p1_reader
@@ -32,6 +38,7 @@ namespace esphome
         {
             // Calculate pollingInterval for Component given our uart buffer size and the rest
             size_t rxBufferSize = parent_->get_rx_buffer_size();
+            _rxBufferSize = rxBufferSize;
             uint8_t bits = parent_->get_data_bits() + parent_->get_stop_bits() + 
                             (parent_->get_parity() != uart::UART_CONFIG_PARITY_NONE ? 1 : 0) + 1;
             float secondsPerByte = (float)bits * (1.0f / (float) parent_->get_baud_rate());
@@ -39,257 +46,760 @@ namespace esphome
             ESP_LOGI("setup", "secondsPerByte calculated as: %f s", secondsPerByte);
             
             _uSecondsPerByte = (int) (secondsPerByte * 1000000.0f);
-            // Keep a margin of 20%
-            _pollingIntervalMs = (int)((float)rxBufferSize * secondsPerByte * 800.0f);
-            
-            if (_pollingIntervalMs < 20)
-            {
-                ESP_LOGE("setup", "Polling interval is too low: %d ms (rx_buffer_size %d, uSecondsPerByte %d)", 
-                    _pollingIntervalMs, parent_->get_rx_buffer_size(), _uSecondsPerByte);
-            } 
-            else if (_pollingIntervalMs < 100)
+            _sliceMaxBytes = rxBufferSize < 64 ? 64 : (rxBufferSize > 0xffff ? 0xffff : rxBufferSize);
+            _sliceMinBytes = std::min<uint32_t>(std::max<uint32_t>(SLICE_MIN_DATA_US / std::max(_uSecondsPerByte, 1), 32), _sliceMaxBytes);
+            _sliceBytes = _sliceMinBytes;
+
+            if (_eventDriven)
             {
-                ESP_LOGW("setup", "Polling interval is low: %d ms (rx_buffer_size %d, uSecondsPerByte %d)", 
-                        _pollingIntervalMs, parent_->get_rx_buffer_size(), _uSecondsPerByte);
+                // Data is read from loop() as soon as it arrives, no polling
+                ESP_LOGI("setup", "Reading uart from loop (rx_buffer_size %u, uSecondsPerByte %d)", 
+                        (unsigned)rxBufferSize, _uSecondsPerByte);
+                set_update_interval(SCHEDULER_DONT_RUN);
             }
             else
             {
-                ESP_LOGI("setup", "Polling interval calculated as: %d ms (rx_buffer_size %d, uSecondsPerByte %d)", 
-                        _pollingIntervalMs, parent_->get_rx_buffer_size(), _uSecondsPerByte);
-            }
+                // Keep a margin of 20%
+                _pollingIntervalMs = (int)((float)rxBufferSize * secondsPerByte * 800.0f);
                 
-            set_update_interval(_pollingIntervalMs);
+                if (_pollingIntervalMs < 20)
+                {
+                    ESP_LOGE("setup", "Polling interval is too low: %d ms (rx_buffer_size %u, uSecondsPerByte %d)", 
+                        _pollingIntervalMs, (unsigned)rxBufferSize, _uSecondsPerByte);
+                } 
+                else if (_pollingIntervalMs < 100)
+                {
+                    ESP_LOGW("setup", "Polling interval is low: %d ms (rx_buffer_size %u, uSecondsPerByte %d)", 
+                            _pollingIntervalMs, (unsigned)rxBufferSize, _uSecondsPerByte);
+                }
+                else
+                {
+                    ESP_LOGI("setup", "Polling interval calculated as: %d ms (rx_buffer_size %u, uSecondsPerByte %d)", 
+                            _pollingIntervalMs, (unsigned)rxBufferSize, _uSecondsPerByte);
+                }
+
+                if (_adaptivePolling)
+                {
+                    // Polls are scheduled one at a time by adaptivePoll() instead
+                    _pollGuardMs = _pollingIntervalMs;
+                    set_update_interval(SCHEDULER_DONT_RUN);
+                    set_timeout("poll", _pollingIntervalMs, [this]() { adaptivePoll(); });
+                }
+                else
+                {
+                    set_update_interval(_pollingIntervalMs);
+                }
+            }
 
-            // Start with a clean buffer
-            memset(_buffer, 0, P1_BUF_SIZE);
+            // All parser state is kept per instance so several readers can run on 
+            // different uarts, allocate the buffer once and start with it clean
+            _buffer = new (std::nothrow) char[_bufferSize];
+            if (_buffer == nullptr)
+            {
+                ESP_LOGE("setup", "Failed to allocate internal buffer of %d bytes", _bufferSize);
+                mark_failed();
+                return;
+            }
+            memset(_buffer, 0, _bufferSize);
             _bufferLen = 0;
-            ESP_LOGI("setup", "Internal buffer size is %d", P1_BUF_SIZE);
+            ESP_LOGI("setup", "Internal buffer size is %d", _bufferSize);
+
+            _messages[0].initNewTelegram();
+            _messages[1].initNewTelegram();
+
+            for (uint8_t field = 0; field < FIELD_COUNT; field++)
+            {
+                if (_fieldSensors[field] != nullptr)
+                    _configuredFields |= 1UL << field;
+            }
+
+            bool hasClock = false;
+#ifdef USE_TIME
+            hasClock = (_time != nullptr);
+#endif
+            if (telegram_latency != nullptr && !hasClock)
+                ESP_LOGW("setup", "telegram_latency needs time_id to compare with the meter's timestamps");
+
+#ifdef USE_P1READER_DECRYPTION
+            // The define is set for the whole build, only readers with decryption_key have a key
+            if (_hasDecryptionKey && !_gcm.setKey(_decryptionKey))
+            {
+                ESP_LOGE("setup", "Failed to set up decryption");
+                mark_failed();
+                return;
+            }
+#endif
+
+            if (!_trace.allocate(_traceSize))
+            {
+                ESP_LOGW("setup", "Failed to allocate trace buffer of %d entries, tracing disabled", _traceSize);
+            }
+            _messages[0].trace = _trace.capacity() > 0 ? &_trace : nullptr;
+            _messages[1].trace = _messages[0].trace;
+
+            if (peak_average != nullptr || peak_projected != nullptr || peak_max != nullptr || peak_top_average != nullptr)
+            {
+                _peaks.configure(_peakPeriodS, _peakTopN);
+            }
+
+#ifdef USE_P1READER_HISTORY
+            // The define is set for the whole build, only readers with history: have one
+            if (_historySize > 0 && _webServerBase != nullptr)
+            {
+                if (_history.allocate(_historySize))
+                {
+                    _webServerBase->init();
+                    _webServerBase->add_handler(new HistoryHandler(&_history, _historyPath));
+                }
+                else
+                {
+                    ESP_LOGW("setup", "Failed to allocate history of %u bytes, history disabled", _historySize);
+                }
+            }
+#endif
+
+            // After peaks and history, which read fields of their own
+            buildRowTable();
+            _messages[0].rows = &_rows;
+            _messages[1].rows = &_rows;
+
+#ifdef USE_P1READER_STREAM
+            // Like history, only readers with stream: have a port
+            if (_streamPort != 0)
+            {
+                // A whole read is written to the ring before loop() sends it, a smaller ring
+                // would drop every client on the first full read
+                if (_streamBufferSize < _sliceMaxBytes)
+                {
+                    ESP_LOGW("setup", "Stream buffer_size %u is less than a read of %u bytes, using %u", 
+                            _streamBufferSize, _sliceMaxBytes, _sliceMaxBytes);
+                    _streamBufferSize = _sliceMaxBytes;
+                }
+                if (!_stream.setup(_streamPort, _streamBufferSize))
+                {
+                    ESP_LOGW("setup", "Failed to start stream server on port %u", _streamPort);
+                }
+            }
+#endif
+
+            _diagnostics.periodStartMs = millis();
+            set_interval("diagnostics", DIAGNOSTICS_INTERVAL_MS, [this]() { publishDiagnostics(); });
+        }
+
+        void P1Reader::buildRowTable()
+        {
+            // Fields with a sensor or in the telegram sensor, and the tariffs that lambdas can 
+            // read with get_day_import_t1_value() and get_night_import_t2_value()
+            uint32_t usedFields = _configuredFields | fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1) | 
+                                  fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2);
+            for (uint8_t i = 0; i < _telegramFieldCount; i++)
+                usedFields |= fieldBit(_telegramFields[i]);
+
+            if (_peaks.enabled())
+                usedFields |= fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT) | fieldBit(FIELD_MOMENTARY_ACTIVE_IMPORT);
+#ifdef USE_P1READER_HISTORY
+            if (_history.enabled())
+                usedFields |= fieldBit(FIELD_MOMENTARY_ACTIVE_IMPORT) | fieldBit(FIELD_MOMENTARY_ACTIVE_EXPORT) |
+                              fieldBit(FIELD_VOLTAGE_L1) | fieldBit(FIELD_VOLTAGE_L2) | fieldBit(FIELD_VOLTAGE_L3) |
+                              fieldBit(FIELD_CURRENT_L1) | fieldBit(FIELD_CURRENT_L2) | fieldBit(FIELD_CURRENT_L3);
+#endif
+
+            // Totals are made from the tariffs when the meter doesn't send them
+            if (usedFields & fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT))
+                usedFields |= fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1) | fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2);
+            if (usedFields & fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT))
+                usedFields |= fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT_T1) | fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT_T2);
+
+            for (const ObisField& obisField : OBIS_FIELDS)
+            {
+                if (usedFields & fieldBit(obisField.field))
+                    _rows.add(obisField.key, obisField.field, -1);
+            }
+#ifdef USE_P1READER_OBIS_SENSORS
+            for (uint8_t sensor = 0; sensor < _obisSensorKeys.count(); sensor++)
+                _rows.add(_obisSensorKeys.key(sensor), -1, sensor);
+#endif
+        }
+
+        void P1Reader::dump_config()
+        {
+            ESP_LOGCONFIG("p1reader", "P1 Reader:");
+            ESP_LOGCONFIG("p1reader", "  Buffer size: %d", _bufferSize);
+            ESP_LOGCONFIG("p1reader", "  Read mode: %s", _eventDriven ? "loop" : (_adaptivePolling ? "adaptive" : "polling"));
+            if (!_eventDriven)
+                ESP_LOGCONFIG("p1reader", "  Polling interval: %d ms", _pollingIntervalMs);
+            ESP_LOGCONFIG("p1reader", "  Bytes per read: %u (%u to %u for %u us)", _sliceBytes, _sliceMinBytes, _sliceMaxBytes, (unsigned)SLICE_BUDGET_US);
+            if (_periodSamples > 0)
+                ESP_LOGCONFIG("p1reader", "  Telegram interval: %u ms", _telegramPeriodMs);
+            if (_peaks.enabled())
+                ESP_LOGCONFIG("p1reader", "  Peak period: %u s, top %u", _peakPeriodS, _peakTopN);
+#ifdef USE_P1READER_HISTORY
+            if (_history.enabled())
+                ESP_LOGCONFIG("p1reader", "  History: %u bytes at %s", _history.size(), _historyPath.c_str());
+#endif
+            if (_telegramSensor != nullptr)
+                ESP_LOGCONFIG("p1reader", "  Telegram text sensor: %u fields", _telegramFieldCount);
+#ifdef USE_P1READER_STREAM
+            if (_stream.enabled())
+                ESP_LOGCONFIG("p1reader", "  Stream: port %u, buffer %u bytes", _stream.port(), (unsigned)_stream.ringSize());
+#endif
+#ifdef USE_P1READER_OBIS_SENSORS
+            ESP_LOGCONFIG("p1reader", "  OBIS sensors: %u", _obisSensorKeys.count());
+#endif
+            ESP_LOGCONFIG("p1reader", "  OBIS codes read: %u", _rows.count());
+            if (_textSensors[TEXT_EQUIPMENT_ID] != nullptr)
+                ESP_LOGCONFIG("p1reader", "  Equipment id text sensor");
+            if (_textSensors[TEXT_TIMESTAMP] != nullptr)
+                ESP_LOGCONFIG("p1reader", "  Timestamp text sensor");
+            if (_textSensors[TEXT_TARIFF_INDICATOR] != nullptr)
+                ESP_LOGCONFIG("p1reader", "  Tariff indicator text sensor");
+            ESP_LOGCONFIG("p1reader", "  Trace size: %d", _trace.capacity());
+#ifdef USE_P1READER_DECRYPTION
+            if (_hasDecryptionKey)
+                ESP_LOGCONFIG("p1reader", "  Decryption: yes, authentication: %s, failures: %u", 
+                              _hasAuthenticationKey ? "yes" : "no", (unsigned)_diagnostics.gcmFailures);
+#endif
+            ESP_LOGCONFIG("p1reader", "  Telegrams: %u, CRC failures: %u, buffer overflows: %u", 
+                          _diagnostics.telegrams, _diagnostics.crcFailures, _diagnostics.bufferOverflows);
+        }
+
+        void P1Reader::publishDiagnostics()
+        {
+            uint32_t now = millis();
+            uint32_t elapsedMs = now - _diagnostics.periodStartMs;
+            if (elapsedMs == 0)
+                return;
+
+            float seconds = elapsedMs / 1000.0f;
+            float bytesPerSecond = (_diagnostics.bytesRead - _diagnostics.periodBytesRead) / seconds;
+            float telegramsPerSecond = (_diagnostics.telegrams - _diagnostics.periodTelegrams) / seconds;
+
+            ESP_LOGD("diagnostics", "%.1f bytes/s, %.3f telegrams/s, crc failures %u, buffer overflows %u, frames dropped (length/crc) %u/%u, incomplete messages %u",
+                     bytesPerSecond, telegramsPerSecond, (unsigned)_diagnostics.crcFailures, (unsigned)_diagnostics.bufferOverflows,
+                     (unsigned)_diagnostics.framesDroppedLength, (unsigned)_diagnostics.framesDroppedCrc,
+                     (unsigned)_diagnostics.messagesIncomplete);
+            ESP_LOGD("diagnostics", "Telegram interval %u ms, uart buffer peak fill %u of %u bytes, most bytes read in one call %u (limit %u), poll guard %u ms",
+                     _telegramPeriodMs, _diagnostics.peakFill, (unsigned)_rxBufferSize, _diagnostics.peakSliceBytes, _sliceBytes, _pollGuardMs);
+#ifdef USE_P1READER_HISTORY
+            uint32_t historySamples = _history.samples();
+            if (_history.enabled())
+                ESP_LOGD("diagnostics", "History %u samples in %u of %u bytes, %.1f bytes/sample", historySamples, 
+                         _history.bytesUsed(), _history.size(), historySamples > 0 ? (float)_history.bytesUsed() / historySamples : 0.0f);
+#endif
+            _diagnostics.read.log("read");
+            _diagnostics.parse.log("parse");
+            _diagnostics.publish.log("publish");
+            _diagnostics.sensors.log("sensors");
+            _diagnostics.batch.log("batch");
+#ifdef USE_P1READER_DECRYPTION
+            _diagnostics.decrypt.log("decrypt");
+            if (_hasDecryptionKey)
+                ESP_LOGD("diagnostics", "Decryption or authentication failures %u", (unsigned)_diagnostics.gcmFailures);
+#endif
+            if (_diagnostics.latencyFrame.count > 0)
+            {
+                _diagnostics.latencyFrame.log("telegram");
+                _diagnostics.latencyParse.log("parsed");
+                _diagnostics.latencyPublish.log("published");
+            }
+            ESP_LOGD("diagnostics", "Jitter against the meter's timestamps %.0f ms, largest %u ms", 
+                     _diagnostics.jitter.jitterMs, _diagnostics.jitter.maxMs);
+
+            publishSensor(bytes_per_second, bytesPerSecond);
+            publishSensor(telegrams_per_second, telegramsPerSecond);
+            publishSensor(crc_failures, _diagnostics.crcFailures);
+            publishSensor(buffer_overflows, _diagnostics.bufferOverflows);
+            publishSensor(frames_dropped, _diagnostics.framesDroppedLength + _diagnostics.framesDroppedCrc +
+                                          _diagnostics.messagesIncomplete);
+            publishSensor(read_time_max, _diagnostics.read.maxUs);
+            publishSensor(parse_time_max, _diagnostics.parse.maxUs);
+            publishSensor(publish_time_max, _diagnostics.publish.maxUs);
+            if (_periodSamples > 0)
+                publishSensor(telegram_interval, _telegramPeriodMs / 1000.0f);
+            if (_diagnostics.latencyPublish.count > 0)
+                publishSensor(telegram_latency, _diagnostics.latencyPublish.averageMs());
+            publishSensor(telegram_jitter, _diagnostics.jitter.jitterMs);
+
+            _diagnostics.periodStartMs = now;
+            _diagnostics.periodBytesRead = _diagnostics.bytesRead;
+            _diagnostics.periodTelegrams = _diagnostics.telegrams;
+            _diagnostics.read.reset();
+            _diagnostics.parse.reset();
+            _diagnostics.publish.reset();
+            _diagnostics.sensors.reset();
+            _diagnostics.batch.reset();
+            _diagnostics.decrypt.reset();
+            _diagnostics.peakFill = 0;
+            _diagnostics.peakSliceBytes = 0;
+            _diagnostics.latencyFrame.reset();
+            _diagnostics.latencyParse.reset();
+            _diagnostics.latencyPublish.reset();
+            _diagnostics.jitter.maxMs = 0;
+        }
 
-            _parsedMessage.initNewTelegram();
+        void P1Reader::loop()
+        {
+            // In event driven mode there is no polling interval, instead react as soon as
+            // anything is waiting in the uart buffer, be it the start of a telegram or the
+            // rest of one. The parsers skip anything outside of a telegram by themselves.
+            if (_eventDriven && (_publishMessage->telegramComplete || _parseHDLCState == FOUND_FRAME || available() > 0))
+            {
+                update();
+            }
+
+#ifdef USE_P1READER_STREAM
+            // Also in polling mode, clients get what has been read so far
+            _stream.loop();
+#endif
         }
 
         void P1Reader::update()
         {
-            // Deliver a parsed and crc ok message in the calls _after_ actually reading it so we 
-            // split the work over more scheduler slices since publish_state is slow (and logging is slow
-            // so set log level INFO to avoid all the debug logging slowing things down)
-            if (_parsedMessage.telegramComplete)
+            // Deliver a parsed message in the calls _after_ actually reading it so we split the work 
+            // over more scheduler slices since publish_state is slow (and logging is slow so set log 
+            // level INFO to avoid all the debug logging slowing things down). The uart is read on 
+            // every call, also while a message is still being published.
+            if (_publishMessage->telegramComplete)
             {
-                publishSensors(&_parsedMessage);
+                publishSensors(_publishMessage);
+            }
 
-                if (!_parsedMessage.telegramComplete)
-                {
-                    (this->*readP1Message)();
-                }
+            readMessage();
+        }
+
+        void P1Reader::adaptivePoll()
+        {
+            // A poll after sleeping should find the uart buffer (nearly) empty, if not the
+            // telegram arrived earlier than expected so wake up earlier from now on
+            bool slept = _pollGuardMs > 0 && _periodSamples >= ADAPTIVE_MIN_SAMPLES && 
+                         _lastPollIntervalMs > (uint32_t)_pollingIntervalMs;
+            uint32_t fill = available();
+            if (slept && fill > _rxBufferSize / 2)
+            {
+                _pollGuardMs = std::min(_pollGuardMs * 2, _telegramPeriodMs / 2);
+                ESP_LOGW("poll", "Uart buffer %u of %u bytes full after sleeping, polling %u ms before the expected telegram", 
+                         fill, (unsigned)_rxBufferSize, _pollGuardMs);
             }
-            else
+            else if (slept && fill == 0 && _pollGuardMs > (uint32_t)_pollingIntervalMs)
+            {
+                _pollGuardMs -= (_pollGuardMs - _pollingIntervalMs + 7) / 8;
+            }
+
+            update();
+
+            // Sleep until shortly before the next telegram is due when nothing is going on, 
+            // otherwise keep polling at the interval calculated from rx_buffer_size
+            uint32_t interval = _pollingIntervalMs;
+            if (_periodSamples >= ADAPTIVE_MIN_SAMPLES && !telegramInProgress() && available() == 0)
+            {
+                uint32_t sinceStart = millis() - _lastTelegramStartMs;
+                uint32_t untilNext = sinceStart < _telegramPeriodMs ? _telegramPeriodMs - sinceStart : 0;
+                if (untilNext > _pollGuardMs + _pollingIntervalMs)
+                    interval = untilNext - _pollGuardMs;
+            }
+
+            _lastPollIntervalMs = interval;
+            set_timeout("poll", interval, [this]() { adaptivePoll(); });
+        }
+
+        void P1Reader::noteTelegramStart()
+        {
+            uint32_t now = millis();
+            uint32_t period = now - _lastTelegramStartMs;
+            if (_lastTelegramStartMs != 0 && period >= TELEGRAM_PERIOD_MIN_MS && period <= TELEGRAM_PERIOD_MAX_MS)
+            {
+                // A telegram lost to noise shows up as a multiple of the period
+                if (_periodSamples >= ADAPTIVE_MIN_SAMPLES && period > _telegramPeriodMs * 3 / 2)
+                    period /= (period + _telegramPeriodMs / 2) / _telegramPeriodMs;
+
+                // The start is only seen when the uart is read, average over about four telegrams
+                _telegramPeriodMs = _periodSamples == 0 ? period : (3 * _telegramPeriodMs + period) / 4;
+                if (_periodSamples < 255)
+                    _periodSamples++;
+            }
+            _lastTelegramStartMs = now;
+        }
+
+        bool P1Reader::telegramInProgress() const
+        {
+            // HDLC waits for the next frame in READING_HEADER, between segments _bufferLen 
+            // holds the information fields read so far
+            return _publishMessage->telegramComplete || _asciiState != WAITING_FOR_START ||
+                   _parseHDLCState == READING_FRAME || _parseHDLCState == FOUND_FRAME ||
+                   (_parseHDLCState == READING_HEADER && (_frameHeaderLen > 1 || _bufferLen > 0));
+        }
+
+        void P1Reader::completeTelegram()
+        {
+            _parsedMessage->completeTelegram(_configuredFields);
+            recordLatency(_parsedMessage);
+
+            if (_peaks.enabled() && _parsedMessage->crcOk)
+            {
+                updatePeaks(_parsedMessage);
+            }
+
+#ifdef USE_P1READER_HISTORY
+            if (_history.enabled() && _parsedMessage->crcOk)
+            {
+                addHistory(_parsedMessage);
+            }
+#endif
+
+            if (_publishMessage->telegramComplete)
+            {
+                ESP_LOGW("publish", "Previous telegram not completely published when the next one arrived, skipping the rest of it");
+            }
+
+            // Publishing picks up the new message, parsing continues in the one that was published
+            ParsedMessage* published = _publishMessage;
+            _publishMessage = _parsedMessage;
+            _parsedMessage = published;
+            _parsedMessage->initNewTelegram();
+            _telegramPending = (_telegramSensor != nullptr);
+        }
+
+        void P1Reader::noteFrameComplete()
+        {
+            _frameCompleteUs = micros();
+            _frameCompleteMs = millis();
+#ifdef USE_TIME
+            _frameClockValid = clockLocalMs(_frameClockMs);
+#endif
+        }
+
+        void P1Reader::recordLatency(ParsedMessage* message)
+        {
+            if (!message->hasMeterTime)
+                return;
+
+            _diagnostics.jitter.record(_frameCompleteMs, message->meterTimeMs);
+
+#ifdef USE_TIME
+            // A meter clock that is more than an hour off is not comparable
+            int64_t latencyMs = _frameClockMs - message->meterTimeMs;
+            if (!_frameClockValid || latencyMs < -3600000 || latencyMs > 3600000)
+                return;
+
+            message->hasLatency = true;
+            message->frameLatencyMs = (int32_t)latencyMs;
+            message->frameCompleteUs = _frameCompleteUs;
+            _diagnostics.latencyFrame.record(message->frameLatencyMs);
+            _diagnostics.latencyParse.record(message->frameLatencyMs + (micros() - _frameCompleteUs) / 1000);
+#endif
+        }
+
+#ifdef USE_TIME
+        bool P1Reader::clockLocalMs(int64_t& ms)
+        {
+            if (_time == nullptr)
+                return false;
+
+            ESPTime now = _time->now();
+            if (!now.is_valid())
+                return false;
+
+            // Meters stamp telegrams in local time. The clock gives whole seconds, the system 
+            // time it is kept in gives the milliseconds.
+            struct timeval tv;
+            gettimeofday(&tv, nullptr);
+            int64_t utcOffset = civilSeconds(now.year, now.month, now.day_of_month, now.hour, now.minute, now.second) - now.timestamp;
+            ms = ((int64_t)tv.tv_sec + utcOffset) * 1000 + tv.tv_usec / 1000;
+            return true;
+        }
+#endif
+
+        void P1Reader::readMessage()
+        {
+            uint32_t startUs = micros();
+            uint32_t bytesRead = _diagnostics.bytesRead;
+            uint32_t bytesDecoded = _bytesDecoded;
+            uint32_t fill = available();
+            if (fill > _diagnostics.peakFill)
+                _diagnostics.peakFill = fill;
+
+            (this->*readP1Message)();
+
+            // Only time slices that actually read something
+            uint32_t elapsedUs = micros() - startUs;
+            if (_diagnostics.bytesRead != bytesRead)
+            {
+                uint32_t sliceBytes = _diagnostics.bytesRead - bytesRead;
+                _diagnostics.read.record(elapsedUs);
+                if (sliceBytes > _diagnostics.peakSliceBytes)
+                    _diagnostics.peakSliceBytes = sliceBytes;
+            }
+
+            // Decoding a HDLC message shares the byte limit with reading
+            uint32_t sliceBytes = (_diagnostics.bytesRead - bytesRead) + (_bytesDecoded - bytesDecoded);
+            if (sliceBytes > 0)
+                adaptSliceBytes(elapsedUs, sliceBytes);
+
+            // Continue with what is left from the main loop rather than at the next poll, 
+            // loop() already does so when event driven
+            if (!_eventDriven && !_readDeferred && (available() > 0 || _parseHDLCState == FOUND_FRAME))
             {
-                (this->*readP1Message)();
+                _readDeferred = true;
+                set_timeout("read", 0, [this]() 
+                { 
+                    _readDeferred = false;
+                    update();
+                });
             }
         }
 
+        void P1Reader::adaptSliceBytes(uint32_t elapsedUs, uint32_t bytes)
+        {
+            // A few bytes are mostly call overhead
+            if (bytes < 32)
+                return;
+
+            // Follow a slower slice at once, a faster one slowly
+            uint32_t cost = (elapsedUs << 8) / bytes;
+            if (cost >= _byteCostQ8)
+                _byteCostQ8 = cost;
+            else
+                _byteCostQ8 -= (_byteCostQ8 - cost + 15) / 16;
+
+            uint32_t slice = _byteCostQ8 > 0 ? (SLICE_BUDGET_US << 8) / _byteCostQ8 : _sliceMaxBytes;
+            _sliceBytes = std::min<uint32_t>(std::max<uint32_t>(slice, _sliceMinBytes), _sliceMaxBytes);
+        }
+
         void P1Reader::publishSensors(ParsedMessage* parsedMessage)
         {
-            if (parsedMessage->telegramComplete) // Temporarily bypassing CRC check to allow values to be published
+            if (!parsedMessage->telegramComplete) // Temporarily bypassing CRC check to allow values to be published
             {
-                // Log the T1 and T2 values with distinct tags for easy identification in the web interface
-                ESP_LOGI("DAY_IMPORT_T1", "%.3f kWh", parsedMessage->cumulativeActiveImportT1);
-                ESP_LOGI("NIGHT_IMPORT_T2", "%.3f kWh", parsedMessage->cumulativeActiveImportT2);
-                
-                // Log gas and water values with distinct tags
-                ESP_LOGI("GAS_CONSUMPTION", "%.3f m³", parsedMessage->gasConsumption);
-                ESP_LOGI("WATER_CONSUMPTION", "%.3f m³", parsedMessage->waterConsumption);
-                
-                uint32_t start = millis();
+                return;
+            }
+
+            ESP_LOGV("publish", "T1 %.3f kWh, T2 %.3f kWh, gas %.3f m³, water %.3f m³", 
+                     parsedMessage->getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1), parsedMessage->getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2), 
+                     parsedMessage->getValue(FIELD_GAS_CONSUMPTION), parsedMessage->getValue(FIELD_WATER_CONSUMPTION));
+
+            if (parsedMessage->textToPublish != 0)
+                publishTexts(parsedMessage);
+
+            if (_telegramPending)
+            {
+                _telegramPending = false;
+                uint32_t batchStartUs = micros();
+                publishTelegram(parsedMessage);
+                _diagnostics.batch.record(micros() - batchStartUs);
+            }
+
+            uint32_t start = millis();
+            uint32_t startUs = micros();
+
+            // Only fields that are both received in this telegram and have a sensor
+            while (parsedMessage->toPublish != 0)
+            {
+                uint8_t field = __builtin_ctz(parsedMessage->toPublish);
+                parsedMessage->toPublish &= parsedMessage->toPublish - 1;
+                publishSensor(_fieldSensors[field], parsedMessage->getValue(field));
+
+                if (parsedMessage->toPublish != 0 && (millis() - start) > 50)
+                {
+                    ESP_LOGW("publish", "Publishing sensors is taking too long (%u), will continue in next scheduler run (remain: %d)", 
+                             millis() - start, __builtin_popcount(parsedMessage->toPublish));
+                    _diagnostics.publish.record(micros() - startUs);
+                    _telegramPublishUs += micros() - startUs;
+                    return;
+                }
+            }
+
+#ifdef USE_P1READER_OBIS_SENSORS
+            while (parsedMessage->obisToPublish != 0)
+            {
+                uint8_t index = __builtin_ctz(parsedMessage->obisToPublish);
+                parsedMessage->obisToPublish &= parsedMessage->obisToPublish - 1;
+                publishSensor(_obisSensors[index], parsedMessage->getObisValue(index));
+
+                if (parsedMessage->obisToPublish != 0 && (millis() - start) > 50)
+                {
+                    ESP_LOGW("publish", "Publishing OBIS sensors is taking too long (%u), will continue in next scheduler run (remain: %d)", 
+                             millis() - start, __builtin_popcount(parsedMessage->obisToPublish));
+                    _diagnostics.publish.record(micros() - startUs);
+                    _telegramPublishUs += micros() - startUs;
+                    return;
+                }
+            }
+#endif
+
+            if (_peaks.enabled())
+                publishPeaks();
+
+            if (suppressed_publishes != nullptr)
+                suppressed_publishes->publishIfChanged(_suppressedPublishes);
+
+            _diagnostics.publish.record(micros() - startUs);
+            _diagnostics.sensors.record(_telegramPublishUs + micros() - startUs);
+            if (parsedMessage->hasLatency)
+                _diagnostics.latencyPublish.record(parsedMessage->frameLatencyMs + (micros() - parsedMessage->frameCompleteUs) / 1000);
+            _telegramPublishUs = 0;
+            _trace.record(TRACE_PUBLISH, 0, parsedMessage->crc);
+
+            ESP_LOGV("publish", "Sensors published (complete). CRC: %04X", parsedMessage->crc);
+            parsedMessage->initNewTelegram();
+        }
     
-                while (parsedMessage->sensorsToSend > 0)
+#ifdef USE_P1READER_HISTORY
+        void P1Reader::addHistory(const ParsedMessage* message)
+        {
+            // Field of each history channel and the scale it is kept at in the field's unit, 
+            // kW at -3 gives W (see history.h)
+            static const uint8_t CHANNEL_FIELDS[HISTORY_CHANNELS] = {
+                FIELD_MOMENTARY_ACTIVE_IMPORT, FIELD_MOMENTARY_ACTIVE_EXPORT, 
+                FIELD_VOLTAGE_L1, FIELD_VOLTAGE_L2, FIELD_VOLTAGE_L3,
+                FIELD_CURRENT_L1, FIELD_CURRENT_L2, FIELD_CURRENT_L3 };
+            static const int8_t CHANNEL_SCALES[HISTORY_CHANNELS] = { -3, -3, -1, -1, -1, -2, -2, -2 };
+
+            HistorySample sample;
+            sample.timeMs = millis();
+            sample.mask = 0;
+            for (uint8_t c = 0; c < HISTORY_CHANNELS; c++)
+            {
+                uint8_t field = CHANNEL_FIELDS[c];
+                sample.values[c] = 0;
+                if (message->received & fieldBit(field))
                 {
-                    switch (parsedMessage->sensorsToSend--)
-                    {
-                        case 1:
-                            if (cumulative_active_import != nullptr)
-                                cumulative_active_import->publish_state(parsedMessage->totalCumulativeActiveImport);
-                            break;
-                        case 2:
-                            if (cumulative_active_import_t1 != nullptr)
-                                cumulative_active_import_t1->publish_state(parsedMessage->cumulativeActiveImportT1);
-                            break;
-                        case 3:
-                            if (cumulative_active_import_t2 != nullptr)
-                                cumulative_active_import_t2->publish_state(parsedMessage->cumulativeActiveImportT2);
-                            break;
-                        case 4:
-                            if (cumulative_active_export != nullptr)
-                                cumulative_active_export->publish_state(parsedMessage->cumulativeActiveExport);
-                            break;
-                        case 5:
-                            if (momentary_active_import != nullptr)
-                                momentary_active_import->publish_state(parsedMessage->momentaryActiveImport);
-                            break;
-                        case 6:
-                            if (momentary_active_export != nullptr)
-                                momentary_active_export->publish_state(parsedMessage->momentaryActiveExport);
-                            break;
-                        case 7:
-                            if (momentary_active_import_l1 != nullptr)
-                                momentary_active_import_l1->publish_state(parsedMessage->momentaryActiveImportL1);
-                            break;
-                        case 8:
-                            if (momentary_active_export_l1 != nullptr)
-                                momentary_active_export_l1->publish_state(parsedMessage->momentaryActiveExportL1);
-                            break;
-                        case 9:
-                            if (momentary_active_import_l2 != nullptr)
-                                momentary_active_import_l2->publish_state(parsedMessage->momentaryActiveImportL2);
-                            break;
-                        case 10:
-                            if (momentary_active_export_l2 != nullptr)
-                                momentary_active_export_l2->publish_state(parsedMessage->momentaryActiveExportL2);
-                            break;
-                        case 11:
-                            if (momentary_active_import_l3 != nullptr)
-                                momentary_active_import_l3->publish_state(parsedMessage->momentaryActiveImportL3);
-                            break;
-                        case 12:
-                            if (momentary_active_export_l3 != nullptr)
-                                momentary_active_export_l3->publish_state(parsedMessage->momentaryActiveExportL3);
-                            break;
-                        case 13:
-                            if (cumulative_reactive_import != nullptr)
-                                cumulative_reactive_import->publish_state(parsedMessage->cumulativeReactiveImport);
-                            break;
-                        case 14:
-                            if (cumulative_reactive_export != nullptr)
-                                cumulative_reactive_export->publish_state(parsedMessage->cumulativeReactiveExport);
-                            break;
-                        case 15:
-                            if (momentary_reactive_import != nullptr)
-                                momentary_reactive_import->publish_state(parsedMessage->momentaryReactiveImport);
-                            break;
-                        case 16:
-                            if (momentary_reactive_export != nullptr)
-                                momentary_reactive_export->publish_state(parsedMessage->momentaryReactiveExport);
-                            break;
-                        case 17:
-                            if (momentary_reactive_import_l1 != nullptr)
-                                momentary_reactive_import_l1->publish_state(parsedMessage->momentaryReactiveImportL1);
-                            break;
-                        case 18:
-                            if (momentary_reactive_export_l1 != nullptr)
-                                momentary_reactive_export_l1->publish_state(parsedMessage->momentaryReactiveExportL1);
-                            break;
-                        case 19:
-                            if (momentary_reactive_import_l2 != nullptr)
-                                momentary_reactive_import_l2->publish_state(parsedMessage->momentaryReactiveImportL2);
-                            break;
-                        case 20:
-                            if (momentary_reactive_export_l2 != nullptr)
-                                momentary_reactive_export_l2->publish_state(parsedMessage->momentaryReactiveExportL2);
-                            break;
-                        case 25:
-                            if (momentary_reactive_import_l3 != nullptr)
-                                momentary_reactive_import_l3->publish_state(parsedMessage->momentaryReactiveImportL3);
-                            break;
-                        case 26:
-                            if (momentary_reactive_export_l3 != nullptr)
-                                momentary_reactive_export_l3->publish_state(parsedMessage->momentaryReactiveExportL3);
-                            break;
-                        case 27:
-                            if (gas_consumption != nullptr)
-                                gas_consumption->publish_state(parsedMessage->gasConsumption);
-                            break;
-                        case 28:
-                            if (water_consumption != nullptr)
-                                water_consumption->publish_state(parsedMessage->waterConsumption);
-                            break;
-                        case 29:
-                            if (cumulative_active_export_t1 != nullptr)
-                                cumulative_active_export_t1->publish_state(parsedMessage->cumulativeActiveExportT1);
-                            break;
-                        case 30:
-                            if (cumulative_active_export_t2 != nullptr)
-                                cumulative_active_export_t2->publish_state(parsedMessage->cumulativeActiveExportT2);
-                            break;
-                        // Cases 31 and 32 removed - T1 and T2 import values now published earlier as cases 2 and 3
-                        default:
-                            ESP_LOGW("publish", "Unknown sensor to publish %d", parsedMessage->sensorsToSend + 1);
-                            break;
-                    }
+                    sample.values[c] = (int32_t)fixedToScale(message->values[field], message->scales[field], CHANNEL_SCALES[c]);
+                    sample.mask |= 1 << c;
+                }
+            }
 
-                    if ((millis() - start) > 50)
-                    {
-                        ESP_LOGW("publish", "Publishing sensors is taking too long (%u), will continue in next scheduler run (remain: %d)", 
-                          millis() - start, parsedMessage->sensorsToSend);
-                        break;
-                    }
+            if (sample.mask != 0)
+                _history.add(sample);
+        }
+#endif
+
+        void P1Reader::updatePeaks(const ParsedMessage* message)
+        {
+            uint32_t epoch = 0;
+            int32_t utcOffset = 0;
+            uint8_t month = 0;
+#ifdef USE_TIME
+            if (_time != nullptr)
+            {
+                ESPTime now = _time->now();
+                if (now.is_valid())
+                {
+                    epoch = now.timestamp;
+                    utcOffset = (int32_t)(civilSeconds(now.year, now.month, now.day_of_month, now.hour, now.minute, now.second) -
+                                          now.timestamp);
+                    month = now.month;
+                }
+            }
+#endif
+
+            // kWh and kW as mWh and mW
+            bool hasEnergy = message->received & fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT);
+            bool hasPower = message->received & fieldBit(FIELD_MOMENTARY_ACTIVE_IMPORT);
+            int64_t energy = hasEnergy ? fixedToScale(message->values[FIELD_CUMULATIVE_ACTIVE_IMPORT], 
+                                                      message->scales[FIELD_CUMULATIVE_ACTIVE_IMPORT], -6) : 0;
+            int64_t power = hasPower ? fixedToScale(message->values[FIELD_MOMENTARY_ACTIVE_IMPORT], 
+                                                    message->scales[FIELD_MOMENTARY_ACTIVE_IMPORT], -6) : 0;
+
+            _peaks.update(millis(), epoch, utcOffset, month, hasEnergy, energy, hasPower, power);
+        }
+
+        void P1Reader::publishPeaks()
+        {
+            publishSensor(peak_average, _peaks.averageKw());
+            publishSensor(peak_projected, _peaks.projectedKw());
+
+            if (_peaks.takePeaksChanged())
+            {
+                for (uint8_t i = 0; i < _peaks.peakCount(); i++)
+                {
+                    ESP_LOGD("peak", "Peak %u: %.3f kW (period starting at %u)", i + 1, _peaks.peak(i).averageKw, _peaks.peak(i).start);
                 }
 
-                ESP_LOGI("publish", "Sensors published (complete). CRC: %04X", parsedMessage->crc);
-                parsedMessage->initNewTelegram();
+                publishSensor(peak_max, _peaks.maxKw());
+                publishSensor(peak_top_average, _peaks.topAverageKw());
             }
-            else if (!parsedMessage->crcOk && parsedMessage->telegramComplete)
+        }
+
+        void P1Reader::publishTelegram(const ParsedMessage* parsedMessage)
+        {
+            // Values in the order of the fields option, null for fields not in this telegram.
+            // Formatted from the fixed point values so they keep the meter's decimals. The array
+            // ends before the first value that would make it longer than a state may be, so the
+            // values that are there keep their positions.
+            std::string payload;
+            payload.reserve(TELEGRAM_STATE_MAX);
+            payload += '[';
+            uint8_t i = 0;
+            for (; i < _telegramFieldCount; i++)
             {
-                parsedMessage->initNewTelegram();
+                char value[32];
+                uint8_t len = 4;
+                uint8_t field = _telegramFields[i];
+                if (parsedMessage->received & fieldBit(field))
+                    len = formatFixed(value, parsedMessage->values[field], parsedMessage->scales[field]);
+                else
+                    memcpy(value, "null", 5);
+
+                // The separator before the value and the closing bracket
+                if (payload.size() + (i > 0 ? 1 : 0) + len + 1 > TELEGRAM_STATE_MAX)
+                    break;
+                if (i > 0)
+                    payload += ',';
+                payload.append(value, len);
             }
-            if (parsedMessage->crcOk && parsedMessage->telegramComplete)
+            payload += ']';
+
+            if (i < _telegramFieldCount && !_telegramTruncated)
             {
-                ESP_LOGI("publish", "Publishing sensors (crc ok)...");
+                ESP_LOGW("publish", "Telegram text sensor is limited to %u characters, only the first %u of %u fields are published",
+                         (unsigned)TELEGRAM_STATE_MAX, i, _telegramFieldCount);
+                _telegramTruncated = true;
             }
+
+            _telegramSensor->publish_state(payload);
         }
-    
+
+        void P1Reader::publishTexts(ParsedMessage* parsedMessage)
+        {
+            // Text sensors copy the state into a std::string, only do so when the text changed
+            while (parsedMessage->textToPublish != 0)
+            {
+                uint8_t field = __builtin_ctz(parsedMessage->textToPublish);
+                parsedMessage->textToPublish &= parsedMessage->textToPublish - 1;
+
+                text_sensor::TextSensor *sensor = _textSensors[field];
+                const char* text = parsedMessage->texts[field];
+                if (sensor != nullptr && (!sensor->has_state() || sensor->state != text))
+                    sensor->publish_state(text);
+            }
+        }
+
+        void P1Reader::publishSensor(P1Sensor *sensor, float value)
+        {
+            if (sensor != nullptr && !sensor->publishIfChanged(value))
+            {
+                _suppressedPublishes++;
+            }
+        }
+
         void P1Reader::readP1MessageAscii()
         {
-            // Use a static buffer to collect the complete telegram
-            static char telegramBuffer[4096] = {0}; // Large enough for P1 telegrams
-            static size_t telegramLen = 0;
             uint32_t start = millis();
-            
-            // Process available data for up to 20ms before yielding
-            while (available())
+            uint8_t data;
+
+            // Feed the parser one byte at a time straight from the uart, the telegram is
+            // never stored as a whole. Process available data for up to 20ms or _sliceBytes 
+            // bytes before yielding
+            for (uint16_t count = 0; count < _sliceBytes && available(); count++)
             {
-                // Use the buffer to read a line
-                memset(_buffer, 0, P1_BUF_SIZE);
-                int len = readBytesUntilAndIncluding('\n', _buffer, P1_BUF_SIZE-1);
-                
-                if (len > 0) {
-                    // Ensure null termination
-                    _buffer[len] = '\0';
-                    
-                    ESP_LOGV("data", "Line received: %s", _buffer);
-                    
-                    // Check if we have space in the telegram buffer
-                    if (telegramLen + len < sizeof(telegramBuffer)) {
-                        // Add the line to our telegram buffer
-                        memcpy(telegramBuffer + telegramLen, _buffer, len);
-                        telegramLen += len;
-                        
-                        // Check if this is the end of telegram (line starts with !)
-                        if (_buffer[0] == '!') {
-                            ESP_LOGI("telegram", "Complete telegram received, length: %d", telegramLen);
-                            
-                            // Add null termination
-                            telegramBuffer[telegramLen] = '\0';
-                            
-                            // Process the complete telegram
-                            processTelegram(telegramBuffer);
-                            
-                            // Update cumulative totals before publishing
-                            _parsedMessage.updateCumulativeTotals();
-                
-                            // Notify that the telegram is now complete
-                            _parsedMessage.telegramComplete = true;
-                            
-                            // Clear buffer for the next telegram
-                            memset(telegramBuffer, 0, sizeof(telegramBuffer));
-                            telegramLen = 0;
-                        }
-                    } else {
-                        ESP_LOGW("telegram", "Telegram buffer overflow, discarding data");
-                        memset(telegramBuffer, 0, sizeof(telegramBuffer));
-                        telegramLen = 0;
-                    }
+                if (!read_byte(&data))
+                {
+                    break;
                 }
-                
+
+                _diagnostics.bytesRead++;
+                forwardBytes(&data, 1);
+                processByte((char)data);
+
                 // Yield control if we've been processing for more than 20ms
                 if ((millis() - start) > 20) {
                     ESP_LOGV("ascii", "Yielding time slice after reading data");
@@ -297,172 +807,139 @@ namespace esphome
                 }
             }
         }
-        
-        void P1Reader::processTelegram(const char* telegram)
+
+        /*  Telegram state machine, fed with every byte read from the uart:
+
+            WAITING_FOR_START   Skip everything until a line starting with '/'.
+            READING_TELEGRAM    Update the CRC and collect the current line in _buffer,
+                                each complete line is handed to processLine().
+            READING_CRC         A line starting with '!' has been found, collect the hex
+                                digits of the CRC until end of line and verify.
+        */
+        void P1Reader::processByte(char b)
         {
-            // Log the full telegram for troubleshooting
-            ESP_LOGI("telegram", "=== Full P1 Telegram ===\n%s", telegram);
-            ESP_LOGI("telegram", "=== End Telegram ===");
-            
-            // Reset CRC and message parsing state
-            _parsedMessage.initNewTelegram();
-            
-            // Process the telegram line by line
-            const char* pos = telegram;
-            const char* eol;
-            
-            // First pass: Calculate CRC over the entire telegram except the CRC line
-            const char* endPos = nullptr;
-            while ((eol = strchr(pos, '\n')) != nullptr) {
-                // Calculate length of this line (excluding newline)
-                size_t lineLen = eol - pos;
-                
-                // Check if this is the CRC line (starts with !)
-                if (*pos == '!') {
-                    endPos = pos;  // Mark the position of the CRC line
-                    break;
-                }
-                
-                // Update CRC for this line
-                for (size_t i = 0; i < lineLen; i++) {
-                    _parsedMessage.updateCrc16(pos[i]);
+            bool atLineStart = (_bufferLen == 0 && !_lineOverflow);
+
+            if (_asciiState == WAITING_FOR_START)
+            {
+                if (b != '/')
+                {
+                    return;
                 }
-                
-                // Include the newline character in CRC calculation
-                _parsedMessage.updateCrc16('\n');
-                
-                // Move to next line
-                pos = eol + 1;
+
+                startTelegram();
             }
-            
-            // Process the CRC line
-            if (endPos && *endPos == '!') {
-                // Add the ! to the CRC
-                _parsedMessage.updateCrc16('!');
-                
-                // Extract the CRC value from the message (after the !)
-                char crcBuffer[8] = {0};
-                size_t crcLen = 0;
-                endPos++; // Skip the !
-                
-                // Copy the CRC hex digits
-                while (isxdigit(*endPos) && crcLen < 6) {
-                    crcBuffer[crcLen++] = *endPos++;
-                }
-                
-                // Convert hex string to integer
-                int crcFromMsg = (int)strtol(crcBuffer, NULL, 16);
-                _parsedMessage.checkCrc(crcFromMsg);
-                
-                ESP_LOGI("crc", "Telegram read. CRC: %04X = %04X. PASS = %s", 
-                         _parsedMessage.crc, crcFromMsg, _parsedMessage.crcOk ? "YES": "NO");
+            else if (_asciiState == READING_TELEGRAM && atLineStart && b == '/')
+            {
+                ESP_LOGW("telegram", "Start of telegram found before end of previous, restarting");
+                startTelegram();
             }
-            
-            // Second pass: Parse the data lines
-            pos = telegram;
-            static char lineCopy[256];  // Static buffer for line processing, large enough for 115+ byte lines
-            
-            while ((eol = strchr(pos, '\n')) != nullptr) {
-                // Calculate length of this line (excluding newline)
-                size_t lineLen = eol - pos;
-                
-                if (lineLen < sizeof(lineCopy) - 1) {
-                    // Copy line to buffer for processing
-                    memcpy(lineCopy, pos, lineLen);
-                    lineCopy[lineLen] = '\0';  // Null-terminate the string
-                    
-                    // Process the line if it's not the CRC line
-                    if (lineCopy[0] != '!') {
-                        // Check if this is a data line with OBIS code
-                        if (strchr(lineCopy, '(') != NULL) {
-                            char* dataId = strtok(lineCopy, DELIMITERS);
-                            char* obisCode = strtok(NULL, DELIMITERS);
-                            
-                            // Check if this is a data row with value
-                            if (dataId && obisCode) {
-                                // Log all OBIS codes for diagnostic purposes
-                                ESP_LOGD("obis_raw", "Found OBIS code: %s with ID: %s", obisCode, dataId);
-                                
-                                // Handle electricity data (1-0:x.x.x)
-                                if (strncmp(DATA_ID, dataId, strlen(DATA_ID)) == 0) {
-                                    char* value = strtok(NULL, DELIMITERS);
-                                    char* unit = strtok(NULL, DELIMITERS);
-                                    
-                                    // Log the complete value and unit if available
-                                    if (value) {
-                                        if (unit) {
-                                            ESP_LOGD("obis_data", "%s = %s %s", obisCode, value, unit);
-                                        } else {
-                                            ESP_LOGD("obis_data", "%s = %s", obisCode, value);
-                                        }
-                                        
-                                        _parsedMessage.parseRow(obisCode, value);
-                                    }
-                                }
-                                // Handle gas/water meter data (0-1:24.2.x, 0-2:24.2.x, etc.)
-                                // Format: 0-1:24.2.1(timestamp)(value*unit)
-                                // After strtok: dataId="0-1", obisCode="24.2.1"
-                                // Next tokens: timestamp, then value, then unit
-                                else if (strncmp("0-", dataId, 2) == 0 && strstr(obisCode, "24.2") != nullptr) {
-                                    char* timestamp = strtok(NULL, DELIMITERS);  // Skip timestamp
-                                    char* value = strtok(NULL, DELIMITERS);      // Actual gas value
-                                    char* unit = strtok(NULL, DELIMITERS);       // Unit (m3)
-                                    
-                                    if (value) {
-                                        // Reconstruct the full OBIS code for parseRow
-                                        char fullObisCode[32];
-                                        snprintf(fullObisCode, sizeof(fullObisCode), "%s:%s", dataId, obisCode);
-                                        
-                                        ESP_LOGI("obis_gas", "Gas meter %s = %s %s (timestamp: %s)", 
-                                                 fullObisCode, value, unit ? unit : "", timestamp ? timestamp : "");
-                                        _parsedMessage.parseRow(fullObisCode, value);
-                                    }
-                                }
-                            }
-                        }
+            else if (_asciiState == READING_TELEGRAM && atLineStart && b == '!')
+            {
+                // The ! is the last character included in the CRC
+                _parsedMessage->updateCrc16(b);
+                _asciiState = READING_CRC;
+                noteFrameComplete();
+                return;
+            }
+            else if (_asciiState == READING_CRC)
+            {
+                if (isxdigit((unsigned char)b) && _bufferLen < 4)
+                {
+                    _buffer[_bufferLen++] = b;
+                }
+                else if (b == '\n')
+                {
+                    _buffer[_bufferLen] = '\0';
+                    int crcFromMsg = (int)strtol(_buffer, NULL, 16);
+                    if (_parsedMessage->checkCrc(crcFromMsg))
+                    {
+                        _trace.record(TRACE_CRC_OK, 0, crcFromMsg);
                     }
-                } else {
-                    ESP_LOGW("telegram", "Line too long to process: %d bytes", lineLen);
+                    else
+                    {
+                        _diagnostics.crcFailures++;
+                        _trace.record(TRACE_CRC_FAIL, 0, crcFromMsg);
+                    }
+
+                    ESP_LOGV("crc", "Telegram read. CRC: %04X = %04X. PASS = %s", 
+                             _parsedMessage->crc, crcFromMsg, _parsedMessage->crcOk ? "YES": "NO");
+
+                    // Notify that the telegram is now complete
+                    completeTelegram();
+                    _diagnostics.telegrams++;
+                    _diagnostics.parse.record(_telegramParseUs);
+
+                    _bufferLen = 0;
+                    _asciiState = WAITING_FOR_START;
                 }
-                
-                // Move to the start of the next line (skip the newline)
-                pos = eol + 1;
+                return;
             }
-        }
 
-        size_t P1Reader::readBytesUntilAndIncluding(char terminator, char *buffer, size_t length)
-        {
-            size_t index = 0;
-            uint32_t start = millis();
-            while (index < length)
+            _parsedMessage->updateCrc16(b);
+
+            if (b == '\n')
             {
-                uint8_t c;
-                bool hasData = read_byte(&c);
-                if (!hasData)
+                if (_lineOverflow)
                 {
-                    break;
+                    _diagnostics.bufferOverflows++;
+                    _trace.record(TRACE_OVERFLOW);
+                    ESP_LOGW("telegram", "Line too long to process, discarding (buffer size %d)", _bufferSize);
                 }
-                *buffer++ = (char)c;
-                index++;
-                if (c == terminator)
+                else
                 {
-                    break;
+                    _buffer[_bufferLen] = '\0';
+                    ESP_LOGVV("data", "Line received: %s", _buffer);
+
+                    uint32_t startUs = micros();
+                    processLine(_buffer);
+                    _telegramParseUs += micros() - startUs;
                 }
+
+                _bufferLen = 0;
+                _lineOverflow = false;
             }
+            else if (_bufferLen < _bufferSize - 1)
+            {
+                _buffer[_bufferLen++] = b;
+            }
+            else
+            {
+                _lineOverflow = true;
+            }
+        }
 
-            return index; // return number of characters, not including terminator
+        void P1Reader::startTelegram()
+        {
+            // Reset CRC and message parsing state
+            _parsedMessage->initNewTelegram();
+            _bufferLen = 0;
+            _lineOverflow = false;
+            _telegramParseUs = 0;
+            _asciiState = READING_TELEGRAM;
+            _trace.record(TRACE_TELEGRAM_START);
+            noteTelegramStart();
         }
 
-        uint16_t crc16_x25(byte* data, int len)
+        void P1Reader::processLine(char* line)
         {
-            uint16_t crc = 0xffff;
-            for (int i = 0; i < len; i++)
+            // Data rows start with the OBIS code, A-B:C.D.E(value*unit)
+            const char* pos = line;
+            uint32_t obisKey = parseObisKey(pos);
+            if (obisKey == 0 || *pos != '(')
             {
-                crc ^= data[i];
-                for (unsigned k = 0; k < 8; k++)
-                    crc = (crc & 1) != 0 ? (crc >> 1) ^ 0x8408 : crc >> 1;
+                return;
             }
-            return ~crc;
+
+            int8_t textField = findTextField(obisKey);
+            if (textField >= 0)
+                _parsedMessage->parseText(textField, pos + 1);
+
+            // The value is always in the last group, M-Bus rows have a timestamp group 
+            // before it: 0-1:24.2.1(timestamp)(value*unit)
+            const char* value = strrchr(pos, '(') + 1;
+
+            _parsedMessage->parseRow(obisKey, value);
         }
 
         /*  Reads messages formatted according to "Branschrekommendation v1.2", which
@@ -474,283 +951,584 @@ namespace esphome
         */
         void P1Reader::readP1MessageHDLC() 
         {
-            if (available())
+            // A complete message is decoded in separate time slices from reading it
+            if (_parseHDLCState == FOUND_FRAME)
             {
-                uint8_t data = 0;
-                uint32_t start = millis();
+                uint32_t startUs = micros();
 
-                while (_parseHDLCState == OUTSIDE_FRAME)
+                bool valid = true;
+                if (!_decoding)
                 {
-                    bool hasData = read_byte(&data);
-                    if (hasData && data == 0x7e)
-                    {
-                        uint8_t wait = 10;
-                        while (!hasData && wait > 0)
-                        {
-                            hasData = read_byte(&data);
-                            if (!hasData)
-                            {
-                                delayMicroseconds(_uSecondsPerByte);
-                                wait--;
-                            }
-                        }
-
-                        if (!hasData)
-                        {
-                            ESP_LOGD("hdlc", "Possibly found end of frame while looking for start of frame, bailing out and trying again later...");
-                        }
-
-                        // clean buffer for next packet
-                        memset(_buffer, 0, P1_BUF_SIZE);
-                        _bufferLen = 0;
-
-                        if (data == 0x7e)
-                        {
-                            _buffer[_bufferLen++] = data;
-                        }
-                        else
-                        {
-                            _buffer[_bufferLen++] = 0x7e;
-                            _buffer[_bufferLen++] = data;
-                        }
-
-                        _parseHDLCState = READING_FRAME;
-                        break;
-                        ESP_LOGD("hdlc", "Found start of frame...");
-                    }
+                    _trace.record(TRACE_TELEGRAM_START);
+                    _parsedMessage->initNewTelegram();
+                    _telegramParseUs = 0;
+                    _decoding = true;
+                    valid = decodeHDLCMessage();
                 }
+                if (valid)
+                    valid = decodeHDLCData(_sliceBytes);
+
+                _telegramParseUs += micros() - startUs;
+                if (valid && _decodePos < _decodeEnd)
+                    return;
 
-                while (_parseHDLCState == READING_FRAME)
+                _decoding = false;
+                if (valid)
                 {
-                    bool hasData = read_byte(&data);
-                    if (hasData)
-                    {
-                        _buffer[_bufferLen++] = data;
-
-                        if (data == 0x7e)
-                        {
-                            _parseHDLCState = FOUND_FRAME;
-                            return; // Always parse in a separate timeslot
-                            ESP_LOGD("hdlc", "Found end of frame...");
-                        }
-
-                        if (_bufferLen >= P1_BUF_SIZE)
-                        {
-                            _parseHDLCState = OUTSIDE_FRAME;
-                            ESP_LOGE("hdlc", "Failed to read frame, buffer overflow, bailing out...");
-                            return;
-                        }
-                    }
-                    else
-                    {
-                        // No byte available, busywait for a single byte over uart
-                        delayMicroseconds(_uSecondsPerByte);
-                        if ((millis() - start) > 10)
-                        {
-                            ESP_LOGD("hdlc", "Failed to fetch expected data within 10ms, bailing out and trying later.");
-                            return;
-                        }
-                    }
+                    completeTelegram();
+                    _diagnostics.telegrams++;
+                    _trace.record(TRACE_CRC_OK);
                 }
+                else
+                {
+                    _trace.record(TRACE_FRAME_DROPPED);
+                }
+
+                _diagnostics.parse.record(_telegramParseUs);
+
+                // The closing flag may also be the opening flag of the next frame
+                _bufferLen = 0;
+                startHDLCFrame();
+                return;
             }
-            
-            if (_parseHDLCState == FOUND_FRAME)
+
+            // Only consume what is already in the uart buffer, a partial frame is 
+            // continued from the same position on the next call
+            int bytesAvailable = available();
+            if (bytesAvailable > _sliceBytes)
+                bytesAvailable = _sliceBytes;
+            while (bytesAvailable > 0 && _parseHDLCState != FOUND_FRAME)
             {
-                if (_bufferLen < 17)
+                if (_parseHDLCState == READING_FRAME)
                 {
-                    _parseHDLCState = OUTSIDE_FRAME;
-                    ESP_LOGE("hdlc", "Frame to small, skipping to next frame. (%d)", _bufferLen);
-                    return;
+                    // The frame length is known, append as much of the rest of it as is available
+                    // directly after the information fields of the previous segments
+                    uint16_t bytesToRead = _frameBodyLen - _frameBodyRead;
+                    if (bytesToRead > bytesAvailable)
+                        bytesToRead = bytesAvailable;
+
+                    if (!read_array((uint8_t*)_buffer + _bufferLen + _frameBodyRead, bytesToRead))
+                        return;
+                    forwardBytes((uint8_t*)_buffer + _bufferLen + _frameBodyRead, bytesToRead);
+
+                    _frameBodyRead += bytesToRead;
+                    bytesAvailable -= bytesToRead;
+                    _diagnostics.bytesRead += bytesToRead;
+
+                    if (_frameBodyRead == _frameBodyLen)
+                        endHDLCFrame();
+                    continue;
                 }
 
-                uint16_t messageLength = ((_buffer[1] & 0x0f) << 8) + (uint8_t)_buffer[2];
-                if (messageLength != (_bufferLen - 2))
-                {
-                    _parseHDLCState = OUTSIDE_FRAME;
-                    ESP_LOGE("hdlc", "Message length (%d) not matching frame length (%d), skipping to next frame.", 
-                            messageLength, _bufferLen-2);
+                uint8_t data = 0;
+                if (!read_byte(&data))
                     return;
-                }
+                bytesAvailable--;
+                _diagnostics.bytesRead++;
+                forwardBytes(&data, 1);
 
-                uint16_t crc = ((uint8_t)_buffer[_bufferLen-2] << 8) | (uint8_t)_buffer[_bufferLen-3];
-                uint16_t crcCalculated = crc16_x25((byte*)_buffer + 1, _bufferLen - 4); // FCS
-                if (crc != crcCalculated)
+                if (_parseHDLCState == OUTSIDE_FRAME)
                 {
-                    _parseHDLCState = OUTSIDE_FRAME;
-                    ESP_LOGE("hdlc", "Message crc (%04x) not matching frame crc (%04x), skipping to next frame.", 
-                            crc, crcCalculated);
-                    return;
+                    if (data == 0x7e)
+                        startHDLCFrame();
+                }
+                else
+                {
+                    readHDLCHeader(data);
                 }
+            }
+        }
 
-                _parsedMessage.crcOk = true;
+        void P1Reader::startHDLCFrame()
+        {
+            _frameHeader[0] = 0x7e;
+            _frameHeaderLen = 1;
+            _frameHeaderSize = 0;
+            _frameAddresses = 0;
+            _parseHDLCState = READING_HEADER;
+        }
 
-                _messagePos = 17;
+        void P1Reader::dropHDLCMessage()
+        {
+            // Segments of a message are only useful together
+            _bufferLen = 0;
+            _parseHDLCState = OUTSIDE_FRAME;
+        }
 
-                // Skip date field (normally 0)
-                _messagePos += _buffer[_messagePos++];
+        void P1Reader::dropIncompleteMessage()
+        {
+            _diagnostics.messagesIncomplete++;
+            _trace.record(TRACE_FRAME_DROPPED);
+            ESP_LOGW("hdlc", "Last segment of a message of %d bytes missing, dropping it.", _bufferLen);
+            _bufferLen = 0;
+        }
 
-                // Check for start of struct array
-                if (_buffer[_messagePos++] != 0x01)
+        void P1Reader::readHDLCHeader(uint8_t data)
+        {
+            if (_frameHeaderLen == 1 && data == 0x7e)
+            {
+                // Repeated flag between frames
+                return;
+            }
+
+            if (_frameHeaderLen == 1 && (data & 0xf0) != 0xa0)
+            {
+                // Not a frame format field (frame type 3), this was not the start of a frame
+                _parseHDLCState = OUTSIDE_FRAME;
+                return;
+            }
+
+            if (_frameHeaderLen == 1 && _bufferLen > 0 && _periodSamples >= ADAPTIVE_MIN_SAMPLES &&
+                millis() - _lastSegmentMs > _telegramPeriodMs / 2)
+            {
+                // The segments of a message come back to back, a gap of half the telegram interval
+                // means the last segment of the stored ones was lost and this is the next message
+                dropIncompleteMessage();
+            }
+
+            if (_frameHeaderLen == 1 && _bufferLen == 0)
+            {
+                // First segment of a message
+                noteTelegramStart();
+            }
+
+            if (_frameHeaderLen == HDLC_MAX_HEADER)
+            {
+                _diagnostics.framesDroppedLength++;
+                ESP_LOGE("hdlc", "Frame header too long, skipping to next frame.");
+                dropHDLCMessage();
+                return;
+            }
+
+            _frameHeader[_frameHeaderLen++] = data;
+
+            if (_frameHeaderLen == 3)
+            {
+                // The length is the 11 low bits of the frame format field and excludes the flags,
+                // 0x08 is the segmentation bit
+                _frameLength = ((_frameHeader[1] & 0x07) << 8) | _frameHeader[2];
+                return;
+            }
+
+            if (_frameHeaderLen < 3)
+                return;
+
+            if (_frameAddresses < 2)
+            {
+                // Destination and source address, each ends with a byte that has bit 0 set
+                if (data & 0x01)
+                    _frameAddresses++;
+                return;
+            }
+
+            if (_frameHeaderSize == 0)
+            {
+                // Control field, followed by the HCS when there is an information field
+                if (_frameLength < _frameHeaderLen + 1)
                 {
-                    _parseHDLCState = OUTSIDE_FRAME;
-                    ESP_LOGE("hdlc", "Message array start tag (0x01) missing, got (%x), skipping to next frame.", 
-                            _buffer[_messagePos-1]);
+                    _diagnostics.framesDroppedLength++;
+                    ESP_LOGE("hdlc", "Frame length (%d) shorter than its header, skipping to next frame.", _frameLength);
+                    dropHDLCMessage();
                     return;
                 }
+                uint16_t remaining = _frameLength - (_frameHeaderLen - 1);
+                _frameHeaderSize = _frameHeaderLen + (remaining > 2 ? 2 : 0);
+            }
 
-                uint8_t structCount = _buffer[_messagePos++];
-                ESP_LOGD("hdlc", "Number of structs are %d", structCount);
+            if (_frameHeaderLen < _frameHeaderSize)
+                return;
+
+            // Information field, FCS and closing flag
+            _frameBodyLen = _frameLength + 2 - _frameHeaderLen;
+            _frameBodyRead = 0;
+            if (_frameBodyLen < 3)
+            {
+                _diagnostics.framesDroppedLength++;
+                ESP_LOGE("hdlc", "Frame length (%d) leaves no room for the FCS, skipping to next frame.", _frameLength);
+                dropHDLCMessage();
+                return;
+            }
+            if (_bufferLen + _frameBodyLen > _bufferSize)
+            {
+                _diagnostics.bufferOverflows++;
+                _trace.record(TRACE_OVERFLOW);
+                ESP_LOGE("hdlc", "Message of %d bytes does not fit the buffer (%d), skipping to next frame.", 
+                         _bufferLen + _frameBodyLen, _bufferSize);
+                dropHDLCMessage();
+                return;
+            }
 
-                for (int i=0; i<structCount; i++) 
+            ESP_LOGV("hdlc", "Found start of frame, %d bytes...", _frameLength + 2);
+            _parseHDLCState = READING_FRAME;
+        }
+
+        void P1Reader::endHDLCFrame()
+        {
+            const uint8_t* body = (const uint8_t*)_buffer + _bufferLen;
+            uint16_t infoLen = _frameBodyLen - 3;
+
+            if (body[_frameBodyLen - 1] != 0x7e)
+            {
+                _diagnostics.framesDroppedLength++;
+                _trace.record(TRACE_FRAME_DROPPED);
+                ESP_LOGE("hdlc", "End of frame flag missing after %d bytes, skipping to next frame.", _frameLength + 2);
+                dropHDLCMessage();
+                return;
+            }
+
+            // FCS over the header and the information field, which are not stored together
+            uint16_t crc = body[infoLen] | (body[infoLen + 1] << 8);
+            uint16_t crcCalculated = crc16X25(body, infoLen, crc16X25(_frameHeader + 1, _frameHeaderLen - 1));
+            if (crc != crcCalculated)
+            {
+                _diagnostics.crcFailures++;
+                _diagnostics.framesDroppedCrc++;
+                _trace.record(TRACE_FRAME_DROPPED);
+                ESP_LOGE("hdlc", "Message crc (%04x) not matching frame crc (%04x), skipping to next frame.", 
+                        crc, crcCalculated);
+                _bufferLen = 0;
+                startHDLCFrame();
+                return;
+            }
+
+            // Only the first segment starts with the LLC header and an APDU, when one comes
+            // after stored segments the final segment of those was lost
+            bool firstSegment = infoLen >= 4 && body[0] == 0xe6 && (body[1] == 0xe6 || body[1] == 0xe7) && body[2] == 0x00 &&
+                                (body[3] == 0x0f || body[3] == 0xdb);
+            if (_bufferLen > 0 && firstSegment)
+            {
+                dropIncompleteMessage();
+                memmove(_buffer, body, infoLen);
+                body = (const uint8_t*)_buffer;
+            }
+            _lastSegmentMs = millis();
+
+            if (_bufferLen == 0)
+            {
+                _apduStart = (infoLen >= 3 && body[0] == 0xe6 && (body[1] == 0xe6 || body[1] == 0xe7)) ? 3 : 0;
+            }
+            _bufferLen += infoLen;
+
+            if (_frameHeader[1] & 0x08)
+            {
+                ESP_LOGV("hdlc", "Segment of %d bytes, waiting for the next one...", infoLen);
+                startHDLCFrame();
+            }
+            else if (_bufferLen > _apduStart)
+            {
+                ESP_LOGV("hdlc", "Found end of message, %d bytes...", _bufferLen - _apduStart);
+                _parseHDLCState = FOUND_FRAME;
+                noteFrameComplete();
+            }
+            else
+            {
+                // Frame without information field
+                _bufferLen = 0;
+                startHDLCFrame();
+            }
+        }
+
+        bool P1Reader::decodeHDLCMessage()
+        {
+            const uint8_t* pos = (const uint8_t*)_buffer + _apduStart;
+            const uint8_t* end = (const uint8_t*)_buffer + _bufferLen;
+
+            if (*pos == 0xdb)
+            {
+#ifdef USE_P1READER_DECRYPTION
+                if (!_hasDecryptionKey)
                 {
-                    if (!parseHDLCStruct())
-                    {
-                        _parseHDLCState = OUTSIDE_FRAME;
-                        ESP_LOGE("hdlc", "Failed to parse structs");
-                        return;
-                    }
+                    ESP_LOGE("hdlc", "Message is encrypted, set decryption_key to read it.");
+                    return false;
                 }
 
-                _parsedMessage.telegramComplete = true;
+                // Decrypted in one go, the bytes count towards the time per byte of this call
+                uint32_t startUs = micros();
+                bool decrypted = decryptHDLCMessage(pos, end);
+                _diagnostics.decrypt.record(micros() - startUs);
+                if (!decrypted)
+                    return false;
+                _bytesDecoded += end - pos;
+#else
+                ESP_LOGE("hdlc", "Message is encrypted, set decryption_key to read it.");
+                return false;
+#endif
             }
+
+            // data-notification, long-invoke-id-and-priority and the date-time of the notification 
+            // (normally empty)
+            if (*pos != 0x0f)
+            {
+                ESP_LOGE("hdlc", "Unsupported APDU (%x), skipping to next frame.", *pos);
+                return false;
+            }
+            pos += 5;
+
+            if (pos < end)
+            {
+                // Meters that send the date-time here may leave 0-0:1.0.0 out of the data
+                if (*pos == 12 && end - pos > 12)
+                    storeHDLCText(obisKey(0, 0, 1, 0, 0), AxdrItem{AXDR_DATE_TIME, pos + 1, 12});
+                pos += 1 + *pos;
+            }
+
+            if (pos >= end)
+            {
+                ESP_LOGE("hdlc", "Notification has no data, skipping to next frame.");
+                return false;
+            }
+
+            _parsedMessage->crcOk = true;
+
+            _decodePos = pos - (const uint8_t*)_buffer;
+            _decodeEnd = end - (const uint8_t*)_buffer;
+            memset(&_row, 0, sizeof(_row));
+            return true;
         }
 
-        bool P1Reader::parseHDLCStruct()
+#ifdef USE_P1READER_DECRYPTION
+        /*  general-glo-ciphering: tag, system title, length, security control byte, frame counter,
+            the APDU (encrypted when SC has 0x20) and, when SC has 0x10, a 12 byte tag. The message
+            is decrypted in place and pos/end are moved to the plaintext APDU.
+        */
+        bool P1Reader::decryptHDLCMessage(const uint8_t*& pos, const uint8_t*& end)
         {
-            char obis[7];
-            memset(obis, 0, 7);
-            bool is_signed = false;
-            double scaleFactors[10] = { 0.0001, 0.001, 0.01, 0.1, 1.0,
-                                        10.0, 100.0, 1000.0,
-                                        10000.0, 100000.0 };
-            int8_t scale = 0;
-            int32_t value = 0;
-            uint32_t uvalue = 0xffffffff;
+            const uint8_t* p = pos + 1;
+            if (p >= end || *p != 8 || end - p < 10)
+            {
+                ESP_LOGE("hdlc", "Unexpected system title in encrypted message, skipping to next frame.");
+                return false;
+            }
+            const uint8_t* systemTitle = p + 1;
+            p += 9;
 
-            // Check for start of struct
-            if (_buffer[_messagePos++] != 0x02)
+            uint16_t length = 0;
+            if (!axdrLength(p, end, length) || length < 5 || end - p < length)
             {
-                _parseHDLCState = OUTSIDE_FRAME;
-                ESP_LOGE("hdlc", "Message struct start tag (0x02) missing, got (%x), skipping to next frame.", 
-                        _buffer[_messagePos-1]);
+                ESP_LOGE("hdlc", "Encrypted message length (%d) not matching frame, skipping to next frame.", length);
                 return false;
             }
 
-            uint8_t structElements = _buffer[_messagePos++];
-            ESP_LOGV("hdlc", "Number of struct elements are %d", structElements);
+            uint8_t securityControl = p[0];
+            const uint8_t* frameCounter = p + 1;
+            uint8_t* data = (uint8_t*)p + 5;
+            size_t dataLen = length - 5;
+
+            // Only security suite 0 (AES-GCM-128) without compression
+            if ((securityControl & 0x8f) != 0)
+            {
+                ESP_LOGE("hdlc", "Unsupported security control (%02x), skipping to next frame.", securityControl);
+                return false;
+            }
 
-            for (int i=0; i<structElements; i++) 
+            const uint8_t* tag = nullptr;
+            if (securityControl & 0x10)
             {
-                if (_messagePos >= _bufferLen)
+                if (dataLen < GCM_TAG_LENGTH)
                 {
-                    _parseHDLCState = OUTSIDE_FRAME;
-                    ESP_LOGE("hdlc", "Reading (%d) past end of message (%d).", 
-                            _messagePos, _bufferLen);
+                    ESP_LOGE("hdlc", "Encrypted message too short for its tag, skipping to next frame.");
                     return false;
                 }
+                dataLen -= GCM_TAG_LENGTH;
+                tag = data + dataLen;
+            }
 
-                uint8_t tag = _buffer[_messagePos++];
-                switch (tag)
-                {
-                    case 0x02: 
-                        {
-                            // another inner struct
-                            uint8_t innerStructElements = _buffer[_messagePos++];
-                            ESP_LOGV("hdlc", "Number of inner struct elements are %d", innerStructElements);
-
-                            for (int j=0; j<innerStructElements; j++) 
-                            {
-                                uint8_t innerTag = _buffer[_messagePos++];
-                                switch (innerTag)
-                                {
-                                    case 0x0f:
-                                        scale = _buffer[_messagePos++]; // 10E(scale)
-                                        break;
-                                    case 0x16: 
-                                    {
-                                        // Unit
-                                        // 0x1b: (k)W
-                                        // 0x1d: (k)VAr
-                                        // 0x1e: (k)Wh
-                                        // 0x20: (k)VArh
-                                        // 0x21: A
-                                        // 0x23: V
-                                        uint8_t unit = _buffer[_messagePos++];
-                                        if (scale == 0 && unit != 0x21 && unit != 0x23)
-                                            scale = -3; // ref KILO in sensor.py
-                                        break;
-                                    }
-                                    default:
-                                        ESP_LOGE("hdlc", "Unknown tag encountered (%x)", innerTag);
-                                        break;
-                                }
-                            }
-                            break;
-                        }
-                    case 0x06:
-                        uvalue = (uint8_t)_buffer[_messagePos + 3] | 
-                                ((uint8_t)_buffer[_messagePos + 2] << 8) | 
-                                ((uint8_t)_buffer[_messagePos + 1] << 16) | 
-                                ((uint8_t)_buffer[_messagePos] << 24);
-                        _messagePos += 4;
-                        break;
-                    case 0x09:
-                        {
-                            uint8_t rowLen = _buffer[_messagePos++];
-                            if (rowLen == 6)
-                            {
-                                // Map to string for ascii parser
-                                if (_buffer[_messagePos + 2] > 9)
-                                {
-                                    obis[0] = (_buffer[_messagePos + 2] / 10) + 48;
-                                    obis[1] = (_buffer[_messagePos + 2] % 10) + 48;
-                                    obis[3] = _buffer[_messagePos + 3] + 48;
-                                    obis[5] = _buffer[_messagePos + 4] + 48;
-                                    obis[2] = obis[4] = '.';
-                                }
-                                else
-                                {
-                                    obis[0] = _buffer[_messagePos + 2] + 48;
-                                    obis[2] = _buffer[_messagePos + 3] + 48;
-                                    obis[4] = _buffer[_messagePos + 4] + 48;
-                                    obis[1] = obis[3] = '.';
-                                }
-                            }
-                            _messagePos += rowLen;
-                            break;
-                        }
-                    case 0x10:
-                        value = _buffer[_messagePos + 1] | (uint8_t)_buffer[_messagePos + 0] << 8;
-                        _messagePos += 2;
-                        break;
-                    case 0x12:
-                        value = (int16_t)(_buffer[_messagePos + 1] | (uint8_t)_buffer[_messagePos + 0] << 8);
-                        _messagePos += 2;
-                        break;
-                    default:
-                        ESP_LOGE("hdlc", "Unknown tag encountered (%x)", tag);
-                        break;
-                }
-            }
-
-            if (obis[0] == '\0')
-            {
-                ESP_LOGV("hdlc", "No data found in struct.");
-                return true;
-            }
-
-            double scaledValue;
-            
-            if (uvalue == 0xffffffff)
-                scaledValue = scaleFactors[scale + 4] * value;
-            else
-                scaledValue = scaleFactors[scale + 4] * uvalue;
+            // Neither encrypted nor authenticated is never accepted, and with an authentication
+            // key the message must carry a tag
+            if (securityControl == 0 || (_hasAuthenticationKey && tag == nullptr))
+            {
+                _diagnostics.gcmFailures++;
+                ESP_LOGE("hdlc", "Message is not authenticated (security control %02x), skipping to next frame.", securityControl);
+                return false;
+            }
 
-            ESP_LOGD("hdlc", "VAL %s, %f, %d\n", obis, scaledValue, scale);
+            uint8_t iv[12];
+            memcpy(iv, systemTitle, 8);
+            memcpy(iv + 8, frameCounter, 4);
 
-            _parsedMessage.parseRow(obis, scaledValue);
+            // The tag can only be checked with the authentication key
+            bool valid = true;
+            if (securityControl & 0x20)
+            {
+                uint8_t aad[17];
+                size_t aadLen = 0;
+                if (tag != nullptr && _hasAuthenticationKey)
+                {
+                    aad[0] = securityControl;
+                    memcpy(aad + 1, _authenticationKey, 16);
+                    aadLen = sizeof(aad);
+                }
+                else
+                {
+                    tag = nullptr;
+                }
 
+                valid = _gcm.decrypt(iv, sizeof(iv), aad, aadLen, data, dataLen, tag, GCM_TAG_LENGTH);
+            }
+            else if (_hasAuthenticationKey)
+            {
+                // Authentication only: a GMAC over the security control, the authentication key and
+                // the plaintext APDU, which have to be in one buffer for mbedTLS
+                std::unique_ptr<uint8_t[]> aad(new (std::nothrow) uint8_t[17 + dataLen]);
+                valid = aad != nullptr;
+                if (valid)
+                {
+                    aad[0] = securityControl;
+                    memcpy(aad.get() + 1, _authenticationKey, 16);
+                    memcpy(aad.get() + 17, data, dataLen);
+                    valid = _gcm.decrypt(iv, sizeof(iv), aad.get(), 17 + dataLen, data, 0, tag, GCM_TAG_LENGTH);
+                }
+            }
+
+            if (!valid)
+            {
+                _diagnostics.gcmFailures++;
+                ESP_LOGE("hdlc", "Failed to decrypt or authenticate message, check the keys. Skipping to next frame.");
+                return false;
+            }
+
+            if (dataLen == 0)
+            {
+                ESP_LOGE("hdlc", "Encrypted message is empty, skipping to next frame.");
+                return false;
+            }
+
+            pos = data;
+            end = data + dataLen;
+            return true;
+        }
+#endif
+
+        /*  Meters send their values either as an array of structures holding an OBIS code, a value
+            and optionally a scaler/unit structure (Aidon, Kaifa), or as one flat structure of OBIS 
+            code and value pairs (Kamstrup). Both are handled in one pass by walking all items in 
+            order: an OBIS code starts a row, the first number after it is the value and a 
+            {integer, enum} structure directly after the value is its scaler and unit.
+        */
+        bool P1Reader::decodeHDLCData(uint16_t maxBytes)
+        {
+            const uint8_t* start = (const uint8_t*)_buffer + _decodePos;
+            const uint8_t* pos = start;
+            const uint8_t* end = (const uint8_t*)_buffer + _decodeEnd;
+
+            // Items are small or skipped over, stopping at the first item boundary after 
+            // maxBytes keeps a call within the slice
+            AxdrItem item;
+            while (pos < end && pos - start < maxBytes)
+            {
+                if (!axdrNext(pos, end, item))
+                {
+                    // Items after a bad one can't be located, drop the frame rather than publish part of it
+                    ESP_LOGE("hdlc", "Failed to decode item with tag (%x), skipping frame.", item.tag);
+                    return false;
+                }
+
+                // A 6 byte string is an OBIS code as the first element of a structure, or in a flat
+                // structure where no code waits for its value. Where one does it is the value.
+                bool firstElement = _row.structureStart;
+                _row.structureStart = item.tag == AXDR_STRUCTURE;
+
+                if (item.tag == AXDR_OCTET_STRING && item.length == 6 && (firstElement || _row.obis == 0 || _row.hasValue))
+                {
+                    if (_row.hasValue)
+                        storeHDLCRow(_row);
+                    _row.obis = obisKey(item.data[0], item.data[1], item.data[2], item.data[3], item.data[4]);
+                    _row.hasValue = false;
+                    _row.hasScaler = false;
+                }
+                else if (_row.obis != 0 && !_row.hasValue && (item.tag == AXDR_OCTET_STRING || item.tag == AXDR_VISIBLE_STRING || 
+                                                              item.tag == AXDR_UTF8_STRING || item.tag == AXDR_DATE_TIME))
+                {
+                    // Text values, a string is the value of the code before it
+                    storeHDLCText(_row.obis, item);
+                    _row.obis = 0;
+                }
+                else if (_row.obis != 0 && !_row.hasValue && axdrIsNumber(item))
+                {
+                    // Integers are used as is, the rare float types are kept with three decimals
+                    if (axdrIsFloat(item))
+                    {
+                        _row.raw = (int64_t)llround(axdrValue(item) * 1000);
+                        _row.rawScale = -3;
+                    }
+                    else
+                    {
+                        _row.raw = axdrInteger(item);
+                        _row.rawScale = 0;
+                    }
+                    _row.hasValue = true;
+                }
+                else if (_row.hasValue && !_row.hasScaler && item.tag == AXDR_STRUCTURE && item.length == 2)
+                {
+                    // Possibly scaler and unit, only consume them if that is what follows
+                    const uint8_t* next = pos;
+                    AxdrItem scalerItem;
+                    AxdrItem unitItem;
+                    if (axdrNext(next, end, scalerItem) && scalerItem.tag == AXDR_INTEGER &&
+                        axdrNext(next, end, unitItem) && unitItem.tag == AXDR_ENUM)
+                    {
+                        _row.scaler = (int8_t)scalerItem.data[0];
+                        _row.unit = unitItem.data[0];
+                        _row.hasScaler = true;
+                        _row.structureStart = false;
+                        pos = next;
+                    }
+                }
+            }
+
+            _bytesDecoded += pos - start;
+            _decodePos = pos - (const uint8_t*)_buffer;
+            if (pos == end && _row.hasValue)
+                storeHDLCRow(_row);
             return true;
         }
+
+        void P1Reader::storeHDLCText(uint32_t obis, const AxdrItem& item)
+        {
+            int8_t field = findTextField(obis);
+            if (field < 0)
+                return;
+
+            // COSEM date-time: year (2 bytes), month, day, weekday, hour, minute, second, hundredths, 
+            // deviation (2 bytes) and clock status
+            if (field == TEXT_TIMESTAMP && item.length == 12)
+                _parsedMessage->setTimestamp((item.data[0] << 8) | item.data[1], item.data[2], item.data[3], 
+                                             item.data[5], item.data[6], item.data[7], item.data[8] == 0xff ? 0 : item.data[8]);
+            else
+                _parsedMessage->setText(field, (const char*)item.data, item.length);
+        }
+
+        void P1Reader::storeHDLCRow(const HdlcRow& row)
+        {
+            // Some meters send the tariff indicator as a number
+            int8_t textField = findTextField(row.obis);
+            if (textField >= 0)
+            {
+                char text[32];
+                uint8_t len = formatFixed(text, row.raw, row.rawScale);
+                _parsedMessage->setText(textField, text, len);
+            }
+
+            // Sensors report power and energy in kilo. Without a scaler/unit structure the active and
+            // reactive power and energy registers of electricity (A = 1) are assumed to be in W and Wh,
+            // quantities of other media such as gas (0-1:24.2.1) are kept as sent.
+            int scale = row.rawScale + (row.hasScaler ? row.scaler : 0);
+            uint8_t medium = (row.obis >> 28) & 0x0f;
+            uint8_t quantity = (row.obis >> 16) & 0xff;
+            if (row.hasScaler ? axdrUnitIsKilo(row.unit) : (medium == 1 && quantity % 20 >= 1 && quantity % 20 <= 4))
+            {
+                scale -= 3;
+            }
+
+            if (scale < FIXED_MIN_SCALE || scale > FIXED_MAX_SCALE)
+            {
+                ESP_LOGW("hdlc", "Scale %d out of range for %08X, skipping value.", scale, (unsigned)row.obis);
+                return;
+            }
+
+            ESP_LOGVV("hdlc", "VAL %08X, %lld, %d, %d", (unsigned)row.obis, (long long)row.raw, scale, row.unit);
+
+            _parsedMessage->parseRow(row.obis, row.raw, (int8_t)scale);
+        }
     }
 }
@@ -26,9 +26,25 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/sensor/sensor.h"
+#include "esphome/components/text_sensor/text_sensor.h"
+#include "p1_sensor.h"
 #include "parsed_message.h"
+#include "diagnostics.h"
+#include "trace.h"
+#include "axdr.h"
+#include "gcm.h"
+#include "peak_tracker.h"
+#include "history.h"
+#include "history_handler.h"
+#include "stream_server.h"
+
+#ifdef USE_TIME
+#include "esphome/components/time/real_time_clock.h"
+#endif
 
 namespace esphome
 {
@@ -41,89 +57,259 @@ namespace esphome
             {}
 
             void setup() override;
+            void loop() override;
             void update() override;
+            void dump_config() override;
         protected:
             float get_setup_priority() const override { return esphome::setup_priority::LATE; }
 
             // Shared
             int _pollingIntervalMs;
-
-            ParsedMessage _parsedMessage = ParsedMessage();
-            char _buffer[P1_BUF_SIZE];
+            bool _eventDriven = false;
+            bool _adaptivePolling = false;
+            size_t _rxBufferSize;
+
+            // Adaptive polling learns when telegrams arrive and sleeps in between them, it
+            // polls at _pollingIntervalMs from _pollGuardMs before the expected start until
+            // the telegram is read and published. The guard grows when a poll finds the uart
+            // buffer close to full.
+            static const uint8_t ADAPTIVE_MIN_SAMPLES = 3;
+            static const uint32_t TELEGRAM_PERIOD_MIN_MS = 500;
+            static const uint32_t TELEGRAM_PERIOD_MAX_MS = 60000;
+            uint32_t _lastTelegramStartMs{0};
+            uint32_t _telegramPeriodMs{0};
+            uint8_t _periodSamples{0};
+            uint32_t _pollGuardMs{0};
+            uint32_t _lastPollIntervalMs{0};
+
+            void noteTelegramStart();
+            bool telegramInProgress() const;
+            void adaptivePoll();
+
+            // A telegram is parsed into one message while the previous one is published from 
+            // the other, they are swapped when a telegram is complete
+            ParsedMessage _messages[2];
+            ParsedMessage* _parsedMessage{&_messages[0]};
+            ParsedMessage* _publishMessage{&_messages[1]};
+
+            void completeTelegram();
+            // Line buffer (ASCII) or frame buffer (HDLC), allocated in setup
+            char* _buffer{nullptr};
+            uint16_t _bufferSize{256};
             uint16_t _bufferLen;
             int _uSecondsPerByte;
 
-            // Standard power readings
-            sensor::Sensor *cumulative_active_import{nullptr};
-            sensor::Sensor *cumulative_active_export{nullptr};
-
-            sensor::Sensor *cumulative_reactive_import{nullptr};
-            sensor::Sensor *cumulative_reactive_export{nullptr};
-
-            sensor::Sensor *momentary_active_import{nullptr};
-            sensor::Sensor *momentary_active_export{nullptr};
-
-            sensor::Sensor *momentary_reactive_import{nullptr};
-            sensor::Sensor *momentary_reactive_export{nullptr};
-
-            // Phase specific readings
-            sensor::Sensor *momentary_active_import_l1{nullptr};
-            sensor::Sensor *momentary_active_export_l1{nullptr};
-
-            sensor::Sensor *momentary_active_import_l2{nullptr};
-            sensor::Sensor *momentary_active_export_l2{nullptr};
-
-            sensor::Sensor *momentary_active_import_l3{nullptr};
-            sensor::Sensor *momentary_active_export_l3{nullptr};
-
-            sensor::Sensor *momentary_reactive_import_l1{nullptr};
-            sensor::Sensor *momentary_reactive_export_l1{nullptr};
-
-            sensor::Sensor *momentary_reactive_import_l2{nullptr};
-            sensor::Sensor *momentary_reactive_export_l2{nullptr};
-
-            sensor::Sensor *momentary_reactive_import_l3{nullptr};
-            sensor::Sensor *momentary_reactive_export_l3{nullptr};
-
-            sensor::Sensor *voltage_l1{nullptr};
-            sensor::Sensor *voltage_l2{nullptr};
-            sensor::Sensor *voltage_l3{nullptr};
+            // Most bytes read from the uart by one call. Work per byte is bounded (lines by 
+            // _bufferSize, frames are decoded in a call of their own), so the limit follows the
+            // measured time per byte to keep a call within SLICE_BUDGET_US. It is never below
+            // what arrives in SLICE_MIN_DATA_US, so the uart is not read slower than the meter
+            // sends, nor above rx_buffer_size. What is left is read in a deferred call.
+            static const uint32_t SLICE_BUDGET_US = 1000;
+            static const uint32_t SLICE_MIN_DATA_US = 24000;
+            uint16_t _sliceBytes{256};
+            uint16_t _sliceMinBytes{64};
+            uint16_t _sliceMaxBytes{256};
+            uint32_t _byteCostQ8{0};    // Slowest recent us per byte, 8 fractional bits
+            bool _readDeferred{false};
+
+            void adaptSliceBytes(uint32_t elapsedUs, uint32_t bytes);
+
+            // Sensor for each field, set by the set_sensor_ setters. Fields with a sensor are
+            // marked in _configuredFields, only those that are also received are published.
+            P1Sensor *_fieldSensors[FIELD_COUNT]{};
+            uint32_t _configuredFields{0};
+
+            // Every row the parsers store, built from the configuration in setup()
+            RowTable _rows;
+            void buildRowTable();
+
+#ifdef USE_P1READER_OBIS_SENSORS
+            // Sensors declared with an OBIS code in the yaml, in the order of their codes
+            ObisSensorKeys _obisSensorKeys;
+            P1Sensor *_obisSensors[OBIS_SENSORS_MAX]{};
+#endif
+
+            // Optional text sensor that gets all of _telegramFields as one JSON array per telegram.
+            // Home Assistant rejects longer states, fields that don't fit are left out.
+            static const size_t TELEGRAM_STATE_MAX = 255;
+            text_sensor::TextSensor *_telegramSensor{nullptr};
+            uint8_t _telegramFields[FIELD_COUNT];
+            uint8_t _telegramFieldCount{0};
+            bool _telegramPending{false};
+            bool _telegramTruncated{false};
+
+            void publishTelegram(const ParsedMessage* parsedMessage);
+
+            // Text sensors by P1TextField, published when the text changes
+            text_sensor::TextSensor *_textSensors[TEXT_FIELD_COUNT]{};
+
+            void publishTexts(ParsedMessage* parsedMessage);
+
+            // Number of values not published since they didn't change enough
+            P1Sensor *suppressed_publishes{nullptr};
+            uint32_t _suppressedPublishes{0};
+
+            // Diagnostics for the reader itself, published every DIAGNOSTICS_INTERVAL_MS
+            static const uint32_t DIAGNOSTICS_INTERVAL_MS = 60000;
+            ReaderDiagnostics _diagnostics;
+            uint32_t _telegramParseUs{0};
+            uint32_t _telegramPublishUs{0};
+
+            // End of the last telegram read, by micros(), millis() and the device clock in ms of
+            // local time. Compared with the meter's timestamp when the telegram is parsed.
+            uint32_t _frameCompleteUs{0};
+            uint32_t _frameCompleteMs{0};
+#ifdef USE_TIME
+            bool _frameClockValid{false};
+            int64_t _frameClockMs{0};
+
+            bool clockLocalMs(int64_t& ms);
+#endif
+
+            void noteFrameComplete();
+            void recordLatency(ParsedMessage* message);
+
+            // Binary trace of the last parsed rows and telegram events, see dump_trace()
+            TraceBuffer _trace;
+            uint16_t _traceSize{0};
+
+            P1Sensor *bytes_per_second{nullptr};
+            P1Sensor *telegrams_per_second{nullptr};
+            P1Sensor *crc_failures{nullptr};
+            P1Sensor *buffer_overflows{nullptr};
+            P1Sensor *frames_dropped{nullptr};
+            P1Sensor *read_time_max{nullptr};
+            P1Sensor *parse_time_max{nullptr};
+            P1Sensor *publish_time_max{nullptr};
+            P1Sensor *telegram_interval{nullptr};
+            P1Sensor *telegram_latency{nullptr};
+            P1Sensor *telegram_jitter{nullptr};
+
+            // Period averages of import power for effect tariffs, only tracked when one of
+            // the peak sensors is configured
+            PeakTracker _peaks;
+            uint32_t _peakPeriodS{3600};
+            uint8_t _peakTopN{3};
+#ifdef USE_TIME
+            time::RealTimeClock *_time{nullptr};
+#endif
+
+            P1Sensor *peak_average{nullptr};
+            P1Sensor *peak_projected{nullptr};
+            P1Sensor *peak_max{nullptr};
+            P1Sensor *peak_top_average{nullptr};
+
+#ifdef USE_P1READER_HISTORY
+            // Compressed momentary values, served by HistoryHandler at _historyPath
+            HistoryRing _history;
+            uint32_t _historySize{0};
+            std::string _historyPath;
+            web_server_base::WebServerBase *_webServerBase{nullptr};
+
+            void addHistory(const ParsedMessage* message);
+#endif
+
+#ifdef USE_P1READER_STREAM
+            // Raw uart data forwarded to TCP clients, decoding is not affected
+            StreamServer _stream;
+            uint16_t _streamPort{0};
+            uint16_t _streamBufferSize{0};
+#endif
+
+            void forwardBytes(const uint8_t* data, size_t len)
+            {
+#ifdef USE_P1READER_STREAM
+                _stream.write(data, len);
+#else
+                (void)data;
+                (void)len;
+#endif
+            }
 
-            sensor::Sensor *current_l1{nullptr};
-            sensor::Sensor *current_l2{nullptr};
-            sensor::Sensor *current_l3{nullptr};
-            
-            // DSMR specific tariff sensors
-            sensor::Sensor *cumulative_active_import_t1{nullptr};
-            sensor::Sensor *cumulative_active_import_t2{nullptr};
-            sensor::Sensor *cumulative_active_export_t1{nullptr};
-            sensor::Sensor *cumulative_active_export_t2{nullptr};
-            
-            // Gas and water consumption sensors
-            sensor::Sensor *gas_consumption{nullptr};
-            sensor::Sensor *water_consumption{nullptr};
+            void updatePeaks(const ParsedMessage* message);
+            void publishPeaks();
 
             void publishSensors(ParsedMessage* parsedMessage);
+            void publishSensor(P1Sensor *sensor, float value);
+            void publishDiagnostics();
 
             // ASCII
-            const char* DELIMITERS = "()*:";
-            const char* DATA_ID = "1-0";
-            void processTelegram(const char* telegram);
-            size_t readBytesUntilAndIncluding(char terminator, char *buffer, size_t length);
+            const int8_t WAITING_FOR_START = 0;
+            const int8_t READING_TELEGRAM = 1;
+            const int8_t READING_CRC = 2;
+
+            int8_t _asciiState = WAITING_FOR_START;
+            bool _lineOverflow = false;
+
+            void startTelegram();
 
             // HLDC
             const int8_t OUTSIDE_FRAME = 0;
+            const int8_t READING_HEADER = 1;
             const int8_t READING_FRAME = 2;
-            const int8_t FOUND_FRAME = 2;
+            const int8_t FOUND_FRAME = 3;
             
             int8_t _parseHDLCState = OUTSIDE_FRAME;
-            uint16_t _messagePos;
+
+            // Flag, frame format, addresses (up to 4 bytes each), control and HCS
+            static const uint8_t HDLC_MAX_HEADER = 14;
+            uint8_t _frameHeader[HDLC_MAX_HEADER];
+            uint8_t _frameHeaderLen;
+            uint8_t _frameHeaderSize;
+            uint8_t _frameAddresses;
+            uint16_t _frameLength;
+
+            // The information fields of all segments of a message are appended in _buffer, 
+            // the rest of the frame being read follows directly after them
+            uint16_t _frameBodyLen;
+            uint16_t _frameBodyRead;
+            uint16_t _apduStart;
+            uint32_t _lastSegmentMs{0};
+
+            // A message is decoded over several calls, up to _sliceBytes of it at a time. The 
+            // row being decoded is kept between the calls.
+            struct HdlcRow
+            {
+                uint32_t obis;
+                int64_t raw;
+                int8_t rawScale;
+                int8_t scaler;
+                uint8_t unit;
+                bool hasValue;
+                bool hasScaler;
+                bool structureStart;    // The previous item opened a structure
+            };
+            bool _decoding{false};
+            uint16_t _decodePos;
+            uint16_t _decodeEnd;
+            HdlcRow _row;
+            uint32_t _bytesDecoded{0};
             
-            bool parseHDLCStruct();
+            void startHDLCFrame();
+            void readHDLCHeader(uint8_t data);
+            void endHDLCFrame();
+            void dropHDLCMessage();
+            void dropIncompleteMessage();
+            bool decodeHDLCMessage();
+
+#ifdef USE_P1READER_DECRYPTION
+            static const size_t GCM_TAG_LENGTH = 12;
+            Aes128Gcm _gcm;
+            uint8_t _decryptionKey[16];
+            uint8_t _authenticationKey[16];
+            bool _hasDecryptionKey{false};
+            bool _hasAuthenticationKey{false};
+
+            bool decryptHDLCMessage(const uint8_t*& pos, const uint8_t*& end);
+#endif
+            bool decodeHDLCData(uint16_t maxBytes);
+            void storeHDLCText(uint32_t obis, const AxdrItem& item);
+            void storeHDLCRow(const HdlcRow& row);
 
             // Message read abstraction
             void (P1Reader::*readP1Message)(){nullptr};
             void initiate_scan();
+            void readMessage();
             void readP1MessageAscii();
             void readP1MessageHDLC();
             
@@ -131,8 +317,8 @@ namespace esphome
             void processLine(char* buffer);
 
             // Accessor methods for template sensors
-            float get_day_import_t1_value() const { return _parsedMessage.cumulativeActiveImportT1; }
-            float get_night_import_t2_value() const { return _parsedMessage.cumulativeActiveImportT2; }
+            float get_day_import_t1_value() const { return _publishMessage->getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1); }
+            float get_night_import_t2_value() const { return _publishMessage->getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2); }
 
         public:
             // Component attribute support
@@ -146,152 +332,349 @@ namespace esphome
                 ESP_LOGI("setup", "Protocol is %s", protocol.c_str());
             }
 
-            void set_sensor_cumulative_active_import(sensor::Sensor *sensor)
+            void set_buffer_size(uint16_t bufferSize)
             {
-                cumulative_active_import = sensor;
-            }
-            void set_sensor_cumulative_active_export(sensor::Sensor *sensor)
-            { 
-                cumulative_active_export = sensor; 
+                _bufferSize = bufferSize;
             }
 
-            void set_sensor_cumulative_reactive_import(sensor::Sensor *sensor)
+            void set_peak_period(uint32_t periodS)
             {
-                cumulative_reactive_import = sensor;
+                _peakPeriodS = periodS;
             }
-            void set_sensor_cumulative_reactive_export(sensor::Sensor *sensor)
+
+            void set_peak_top_n(uint8_t topN)
             {
-                cumulative_reactive_export = sensor;
+                _peakTopN = topN;
             }
 
-            void set_sensor_momentary_active_import(sensor::Sensor *sensor)
+#ifdef USE_TIME
+            void set_time(time::RealTimeClock *time)
             {
-                momentary_active_import = sensor;
+                _time = time;
             }
-            void set_sensor_momentary_active_export(sensor::Sensor *sensor)
+#endif
+
+#ifdef USE_P1READER_HISTORY
+            void set_history(web_server_base::WebServerBase *webServerBase, uint32_t size, const std::string &path)
             {
-                momentary_active_export = sensor;
+                _webServerBase = webServerBase;
+                _historySize = size;
+                _historyPath = path;
             }
+#endif
 
-            void set_sensor_momentary_reactive_import(sensor::Sensor *sensor)
+#ifdef USE_P1READER_STREAM
+            void set_stream(uint16_t port, uint16_t bufferSize)
             {
-                momentary_reactive_import = sensor;
+                _streamPort = port;
+                _streamBufferSize = bufferSize;
             }
-            void set_sensor_momentary_reactive_export(sensor::Sensor *sensor)
+#endif
+
+#ifdef USE_P1READER_OBIS_SENSORS
+            // Called by sensor.py in increasing order of the codes of each sensor block
+            void add_obis_sensor(uint32_t obisKey, P1Sensor *sensor)
             {
-                momentary_reactive_export = sensor;
+                int8_t index = _obisSensorKeys.add(obisKey);
+                if (index < 0)
+                {
+                    ESP_LOGE("setup", "OBIS sensor %08X is declared twice or there are more than %u, ignored", 
+                             (unsigned)obisKey, OBIS_SENSORS_MAX);
+                    return;
+                }
+                // Sensors are kept in the order of their codes
+                memmove(&_obisSensors[index + 1], &_obisSensors[index], (_obisSensorKeys.count() - 1 - index) * sizeof(_obisSensors[0]));
+                _obisSensors[index] = sensor;
+            }
+#endif
+
+            void set_trace_size(uint16_t traceSize)
+            {
+                _traceSize = traceSize;
             }
 
-            void set_sensor_momentary_active_import_l1(sensor::Sensor *sensor)
+            // Log the contents of the trace buffer, oldest entry first
+            void dump_trace()
             {
-                momentary_active_import_l1 = sensor;
+                _trace.dump();
             }
-            void set_sensor_momentary_active_export_l1(sensor::Sensor *sensor)
+
+#ifdef USE_P1READER_DECRYPTION
+            // Keys are validated as 32 hex characters in __init__.py
+            void set_decryption_key(const std::string &key)
             {
-                momentary_active_export_l1 = sensor;
+                _hasDecryptionKey = parse_hex(key, _decryptionKey, sizeof(_decryptionKey));
             }
 
-            void set_sensor_momentary_active_import_l2(sensor::Sensor *sensor)
+            void set_authentication_key(const std::string &key)
             {
-                momentary_active_import_l2 = sensor;
+                _hasAuthenticationKey = parse_hex(key, _authenticationKey, sizeof(_authenticationKey));
             }
-            void set_sensor_momentary_active_export_l2(sensor::Sensor *sensor)
+#endif
+
+            void set_read_mode(std::string readMode)
             {
-                momentary_active_export_l2 = sensor;
+                // polling:  read the uart from update() at an interval calculated from rx_buffer_size
+                // loop:     read the uart from loop() as soon as data is available
+                // adaptive: poll like polling, but only around the learned telegram arrival time
+                _eventDriven = (readMode == "loop");
+                _adaptivePolling = (readMode == "adaptive");
             }
 
-            void set_sensor_momentary_active_import_l3(sensor::Sensor *sensor)
-            {
-                momentary_active_import_l3 = sensor;
+            void set_sensor_cumulative_active_import(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_IMPORT] = sensor;
             }
-            void set_sensor_momentary_active_export_l3(sensor::Sensor *sensor)
-            {
-                momentary_active_export_l3 = sensor;
+            void set_sensor_cumulative_active_export(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_EXPORT] = sensor;
             }
 
-            void set_sensor_momentary_reactive_import_l1(sensor::Sensor *sensor)
-            {
-                momentary_reactive_import_l1 = sensor;
+            void set_sensor_cumulative_reactive_import(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CUMULATIVE_REACTIVE_IMPORT] = sensor;
             }
-            void set_sensor_momentary_reactive_export_l1(sensor::Sensor *sensor)
-            {
-                momentary_reactive_export_l1 = sensor;
+            void set_sensor_cumulative_reactive_export(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CUMULATIVE_REACTIVE_EXPORT] = sensor;
             }
 
-            void set_sensor_momentary_reactive_import_l2(sensor::Sensor *sensor)
-            {
-                momentary_reactive_import_l2 = sensor;
+            void set_sensor_momentary_active_import(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_IMPORT] = sensor;
             }
-            void set_sensor_momentary_reactive_export_l2(sensor::Sensor *sensor)
-            {
-                momentary_reactive_export_l2 = sensor;
+            void set_sensor_momentary_active_export(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_EXPORT] = sensor;
             }
 
-            void set_sensor_momentary_reactive_import_l3(sensor::Sensor *sensor)
-            {
-                momentary_reactive_import_l3 = sensor;
+            void set_sensor_momentary_reactive_import(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_IMPORT] = sensor;
             }
-            void set_sensor_momentary_reactive_export_l3(sensor::Sensor *sensor)
-            {
-                momentary_reactive_export_l3 = sensor;
+            void set_sensor_momentary_reactive_export(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_EXPORT] = sensor;
             }
 
-            void set_sensor_voltage_l1(sensor::Sensor* sensor)
-            {
-                voltage_l1 = sensor;
+            void set_sensor_momentary_active_import_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_IMPORT_L1] = sensor;
             }
-            void set_sensor_voltage_l2(sensor::Sensor* sensor)
-            {
-                voltage_l2 = sensor;
+            void set_sensor_momentary_active_export_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_EXPORT_L1] = sensor;
             }
-            void set_sensor_voltage_l3(sensor::Sensor* sensor)
-            {
-                voltage_l3 = sensor;
+
+            void set_sensor_momentary_active_import_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_IMPORT_L2] = sensor;
+            }
+            void set_sensor_momentary_active_export_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_EXPORT_L2] = sensor;
             }
 
-            void set_sensor_current_l1(sensor::Sensor* sensor)
-            {
-                current_l1 = sensor;
+            void set_sensor_momentary_active_import_l3(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_IMPORT_L3] = sensor;
             }
-            void set_sensor_current_l2(sensor::Sensor* sensor)
-            {
-                current_l2 = sensor;
+            void set_sensor_momentary_active_export_l3(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_ACTIVE_EXPORT_L3] = sensor;
+            }
+
+            void set_sensor_momentary_reactive_import_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_IMPORT_L1] = sensor;
+            }
+            void set_sensor_momentary_reactive_export_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_EXPORT_L1] = sensor;
+            }
+
+            void set_sensor_momentary_reactive_import_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_IMPORT_L2] = sensor;
+            }
+            void set_sensor_momentary_reactive_export_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_EXPORT_L2] = sensor;
+            }
+
+            void set_sensor_momentary_reactive_import_l3(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_IMPORT_L3] = sensor;
+            }
+            void set_sensor_momentary_reactive_export_l3(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_MOMENTARY_REACTIVE_EXPORT_L3] = sensor;
+            }
+
+            void set_sensor_voltage_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_VOLTAGE_L1] = sensor;
+            }
+            void set_sensor_voltage_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_VOLTAGE_L2] = sensor;
+            }
+            void set_sensor_voltage_l3(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_VOLTAGE_L3] = sensor;
+            }
+
+            void set_sensor_current_l1(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CURRENT_L1] = sensor;
+            }
+            void set_sensor_current_l2(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_CURRENT_L2] = sensor;
             }
-            void set_sensor_current_l3(sensor::Sensor* sensor)
+            void set_sensor_current_l3(P1Sensor *sensor)
             { 
-                current_l3 = sensor;
+                _fieldSensors[FIELD_CURRENT_L3] = sensor;
             }
             
             // DSMR tariff sensors setters
-            void set_sensor_cumulative_active_import_t1(sensor::Sensor* sensor)
+            void set_sensor_cumulative_active_import_t1(P1Sensor *sensor)
             { 
-                cumulative_active_import_t1 = sensor;
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_IMPORT_T1] = sensor;
             }
             
-            void set_sensor_cumulative_active_import_t2(sensor::Sensor* sensor)
+            void set_sensor_cumulative_active_import_t2(P1Sensor *sensor)
             { 
-                cumulative_active_import_t2 = sensor;
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_IMPORT_T2] = sensor;
             }
             
-            void set_sensor_cumulative_active_export_t1(sensor::Sensor* sensor)
+            void set_sensor_cumulative_active_export_t1(P1Sensor *sensor)
             { 
-                cumulative_active_export_t1 = sensor;
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_EXPORT_T1] = sensor;
             }
             
-            void set_sensor_cumulative_active_export_t2(sensor::Sensor* sensor)
+            void set_sensor_cumulative_active_export_t2(P1Sensor *sensor)
             { 
-                cumulative_active_export_t2 = sensor;
+                _fieldSensors[FIELD_CUMULATIVE_ACTIVE_EXPORT_T2] = sensor;
             }
             
             // Gas and water sensors setters
-            void set_sensor_gas_consumption(sensor::Sensor* sensor)
+            void set_sensor_gas_consumption(P1Sensor *sensor)
             { 
-                gas_consumption = sensor;
+                _fieldSensors[FIELD_GAS_CONSUMPTION] = sensor;
             }
             
-            void set_sensor_water_consumption(sensor::Sensor* sensor)
+            void set_sensor_water_consumption(P1Sensor *sensor)
+            { 
+                _fieldSensors[FIELD_WATER_CONSUMPTION] = sensor;
+            }
+
+            void set_telegram(text_sensor::TextSensor *sensor)
+            {
+                _telegramSensor = sensor;
+            }
+
+            void set_equipment_id(text_sensor::TextSensor *sensor)
+            {
+                _textSensors[TEXT_EQUIPMENT_ID] = sensor;
+            }
+
+            void set_timestamp(text_sensor::TextSensor *sensor)
+            {
+                _textSensors[TEXT_TIMESTAMP] = sensor;
+            }
+
+            void set_tariff_indicator(text_sensor::TextSensor *sensor)
+            {
+                _textSensors[TEXT_TARIFF_INDICATOR] = sensor;
+            }
+
+            void add_telegram_field(uint8_t field)
+            {
+                if (_telegramFieldCount < FIELD_COUNT)
+                    _telegramFields[_telegramFieldCount++] = field;
+            }
+
+            // Peak power sensors setters
+            void set_sensor_peak_average(P1Sensor *sensor)
+            { 
+                peak_average = sensor;
+            }
+
+            void set_sensor_peak_projected(P1Sensor *sensor)
+            { 
+                peak_projected = sensor;
+            }
+
+            void set_sensor_peak_max(P1Sensor *sensor)
+            { 
+                peak_max = sensor;
+            }
+
+            void set_sensor_peak_top_average(P1Sensor *sensor)
+            { 
+                peak_top_average = sensor;
+            }
+
+            void set_sensor_suppressed_publishes(P1Sensor *sensor)
+            { 
+                suppressed_publishes = sensor;
+            }
+
+            // Diagnostic sensors setters
+            void set_sensor_bytes_per_second(P1Sensor *sensor)
+            { 
+                bytes_per_second = sensor;
+            }
+
+            void set_sensor_telegrams_per_second(P1Sensor *sensor)
+            { 
+                telegrams_per_second = sensor;
+            }
+
+            void set_sensor_crc_failures(P1Sensor *sensor)
+            { 
+                crc_failures = sensor;
+            }
+
+            void set_sensor_buffer_overflows(P1Sensor *sensor)
+            { 
+                buffer_overflows = sensor;
+            }
+
+            void set_sensor_frames_dropped(P1Sensor *sensor)
+            { 
+                frames_dropped = sensor;
+            }
+
+            void set_sensor_read_time_max(P1Sensor *sensor)
+            { 
+                read_time_max = sensor;
+            }
+
+            void set_sensor_parse_time_max(P1Sensor *sensor)
+            { 
+                parse_time_max = sensor;
+            }
+
+            void set_sensor_publish_time_max(P1Sensor *sensor)
+            { 
+                publish_time_max = sensor;
+            }
+
+            void set_sensor_telegram_interval(P1Sensor *sensor)
+            { 
+                telegram_interval = sensor;
+            }
+
+            void set_sensor_telegram_latency(P1Sensor *sensor)
+            { 
+                telegram_latency = sensor;
+            }
+
+            void set_sensor_telegram_jitter(P1Sensor *sensor)
             { 
-                water_consumption = sensor;
+                telegram_jitter = sensor;
             }
         };
     }
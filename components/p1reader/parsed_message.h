@@ -8,293 +8,267 @@
 #pragma once
 
 #include "esphome/core/log.h"
-#include <cmath>
-
-// Use a different name to avoid conflicting with ESPHome's BUF_SIZE
-#define P1_BUF_SIZE 256
+#include "crc16.h"
+#include "obis.h"
+#include "trace.h"
+#include "fixed_point.h"
+#include <cstdio>
+#include <cstring>
 
 namespace esphome
 {
     namespace p1_reader
     {
+        // Values read from a telegram, in the order they are published
+        enum P1Field : uint8_t
+        {
+            FIELD_CUMULATIVE_ACTIVE_IMPORT,     // Total of T1+T2 imports
+            FIELD_CUMULATIVE_ACTIVE_IMPORT_T1,
+            FIELD_CUMULATIVE_ACTIVE_IMPORT_T2,
+            FIELD_CUMULATIVE_ACTIVE_EXPORT,     // Total of T1+T2 exports
+            FIELD_CUMULATIVE_ACTIVE_EXPORT_T1,
+            FIELD_CUMULATIVE_ACTIVE_EXPORT_T2,
+            FIELD_CUMULATIVE_REACTIVE_IMPORT,
+            FIELD_CUMULATIVE_REACTIVE_EXPORT,
+
+            FIELD_MOMENTARY_ACTIVE_IMPORT,
+            FIELD_MOMENTARY_ACTIVE_EXPORT,
+            FIELD_MOMENTARY_REACTIVE_IMPORT,
+            FIELD_MOMENTARY_REACTIVE_EXPORT,
+
+            // Phase specific readings
+            FIELD_MOMENTARY_ACTIVE_IMPORT_L1,
+            FIELD_MOMENTARY_ACTIVE_EXPORT_L1,
+            FIELD_MOMENTARY_ACTIVE_IMPORT_L2,
+            FIELD_MOMENTARY_ACTIVE_EXPORT_L2,
+            FIELD_MOMENTARY_ACTIVE_IMPORT_L3,
+            FIELD_MOMENTARY_ACTIVE_EXPORT_L3,
+            FIELD_MOMENTARY_REACTIVE_IMPORT_L1,
+            FIELD_MOMENTARY_REACTIVE_EXPORT_L1,
+            FIELD_MOMENTARY_REACTIVE_IMPORT_L2,
+            FIELD_MOMENTARY_REACTIVE_EXPORT_L2,
+            FIELD_MOMENTARY_REACTIVE_IMPORT_L3,
+            FIELD_MOMENTARY_REACTIVE_EXPORT_L3,
+            FIELD_VOLTAGE_L1,
+            FIELD_VOLTAGE_L2,
+            FIELD_VOLTAGE_L3,
+            FIELD_CURRENT_L1,
+            FIELD_CURRENT_L2,
+            FIELD_CURRENT_L3,
+
+            // Gas and water consumption
+            FIELD_GAS_CONSUMPTION,
+            FIELD_WATER_CONSUMPTION,
+
+            FIELD_COUNT
+        };
+
+        // Fields are tracked in 32 bit masks
+        static_assert(FIELD_COUNT <= 32, "Too many fields for the field masks");
+
+        inline uint32_t fieldBit(uint8_t field)
+        {
+            return 1UL << field;
+        }
+
+        // Text values read from a telegram, kept in fixed buffers of TEXT_FIELD_SIZE
+        enum P1TextField : uint8_t
+        {
+            TEXT_EQUIPMENT_ID,
+            TEXT_TIMESTAMP,             // As YYYY-MM-DD hh:mm:ss
+            TEXT_TARIFF_INDICATOR,
+
+            TEXT_FIELD_COUNT
+        };
+
+        // Longer values are cut, with room for the terminating zero
+        static const uint8_t TEXT_FIELD_SIZE = 48;
+
+        // Seconds since 1970 of a date and time, without any time zone
+        inline int64_t civilSeconds(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+        {
+            // Days from civil, with the year starting in March so the leap day is last
+            int32_t y = (int32_t)year - (month <= 2);
+            int32_t era = (y >= 0 ? y : y - 399) / 400;
+            uint32_t yearOfEra = (uint32_t)(y - era * 400);
+            uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+            uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+            int64_t days = (int64_t)era * 146097 + dayOfEra - 719468;
+            return days * 86400 + hour * 3600 + minute * 60 + second;
+        }
+
+        inline int8_t findTextField(uint32_t key)
+        {
+            switch (key)
+            {
+            case obisKey(0, 0, 96, 1, 0):
+            case obisKey(0, 0, 96, 1, 1):       // DSMR, hex encoded
+                return TEXT_EQUIPMENT_ID;
+            case obisKey(0, 0, 1, 0, 0):
+                return TEXT_TIMESTAMP;
+            case obisKey(0, 0, 96, 14, 0):
+                return TEXT_TARIFF_INDICATOR;
+            default:
+                return -1;
+            }
+        }
+
+        class RowTable;
+
         class ParsedMessage {
         public:
             bool telegramComplete;
             bool crcOk;
-            int sensorsToSend;
 
-            // Standard power readings - totals calculated from T1+T2
-            double totalCumulativeActiveImport;  // Total of T1+T2 imports
-            double cumulativeActiveExport;       // Total of T1+T2 exports
+            // Fields read from the current telegram, and those of them still to be published
+            uint32_t received;
+            uint32_t toPublish;
 
-            double cumulativeReactiveImport;
-            double cumulativeReactiveExport;
+            // Each value is values[field] * 10^scales[field], see fixed_point.h
+            int64_t values[FIELD_COUNT];
+            int8_t scales[FIELD_COUNT];
 
-            double momentaryActiveImport;
-            double momentaryActiveExport;
+            uint16_t crc;
 
-            double momentaryReactiveImport;
-            double momentaryReactiveExport;
+            // The meter's timestamp of the telegram in ms of its local time, see civilSeconds()
+            bool hasMeterTime;
+            int64_t meterTimeMs;
 
-            // Phase specific readings
-            double momentaryActiveImportL1;
-            double momentaryActiveExportL1;
+            // Set when the telegram is parsed if the device clock is synced: meter timestamp to
+            // end of telegram by the device clock, and micros() at the end of the telegram
+            bool hasLatency;
+            int32_t frameLatencyMs;
+            uint32_t frameCompleteUs;
 
-            double momentaryActiveImportL2;
-            double momentaryActiveExportL2;
+            // Text values by P1TextField, and those of them still to be published
+            char texts[TEXT_FIELD_COUNT][TEXT_FIELD_SIZE];
+            uint8_t textReceived;
+            uint8_t textToPublish;
 
-            double momentaryActiveImportL3;
-            double momentaryActiveExportL3;
+            // Rows that are stored are recorded here when tracing is enabled
+            TraceBuffer* trace{nullptr};
 
-            double momentaryReactiveImportL1;
-            double momentaryReactiveExportL1;
+            // The rows the reader uses, other rows are skipped
+            const RowTable* rows{nullptr};
 
-            double momentaryReactiveImportL2;
-            double momentaryReactiveExportL2;
+#ifdef USE_P1READER_OBIS_SENSORS
+            // Rows with the codes of the obis sensors, by sensor index. All of them have a
+            // sensor so everything received is published.
+            uint32_t obisReceived;
+            uint32_t obisToPublish;
+            int64_t obisValues[OBIS_SENSORS_MAX];
+            int8_t obisScales[OBIS_SENSORS_MAX];
 
-            double momentaryReactiveImportL3;
-            double momentaryReactiveExportL3;
+            float getObisValue(uint8_t index) const
+            {
+                return fixedToFloat(obisValues[index], obisScales[index]);
+            }
+#endif
 
-            double voltageL1;
-            double voltageL2;
-            double voltageL3;
+            // Store the value of a row if its OBIS code is one the reader uses
+            void parseRow(uint32_t obisKey, const char* value);
+            void parseRow(uint32_t obisKey, int64_t raw, int8_t scale);
 
-            double currentL1;
-            double currentL2;
-            double currentL3;
-            
-            // DSMR specific tariff readings
-            double cumulativeActiveImportT1;
-            double cumulativeActiveImportT2;
-            double cumulativeActiveExportT1;
-            double cumulativeActiveExportT2;
-            
-            // Gas and water consumption
-            double gasConsumption;
-            double waterConsumption;
-
-            uint16_t crc;
+            // Store a text value, characters that can't be shown are replaced by '?'
+            void setText(uint8_t field, const char* text, size_t len)
+            {
+                if (len > TEXT_FIELD_SIZE - 1)
+                    len = TEXT_FIELD_SIZE - 1;
+                for (size_t i = 0; i < len; i++)
+                    texts[field][i] = (text[i] >= 0x20 && text[i] < 0x7f) ? text[i] : '?';
+                texts[field][len] = '\0';
+                textReceived |= 1 << field;
+            }
 
-            void parseRow(const char* obisCode, const char* value)
+            void setTimestamp(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second, 
+                              uint8_t hundredths = 0)
             {
-                // Convert string value to double
-                double obisValue = atof(value);
-                parseRow(obisCode, obisValue);
+                snprintf(texts[TEXT_TIMESTAMP], TEXT_FIELD_SIZE, "%04u-%02u-%02u %02u:%02u:%02u",
+                         year, month, day, hour, minute, second);
+                textReceived |= 1 << TEXT_TIMESTAMP;
+
+                hasMeterTime = month >= 1 && month <= 12 && day >= 1 && day <= 31 && hour < 24 && minute < 60 && 
+                               second < 60 && hundredths < 100;
+                if (hasMeterTime)
+                    meterTimeMs = civilSeconds(year, month, day, hour, minute, second) * 1000 + hundredths * 10;
             }
 
-            void parseRow(const char* obisCode, double obisValue)
+            // Text of an ASCII row, value points after the opening parenthesis
+            void parseText(uint8_t field, const char* value)
             {
-                // For debugging purposes, log the OBIS code and value
-                ESP_LOGD("obis", "Processing OBIS code: %s = %f", obisCode, obisValue);
-                
-                size_t obisCodeLen = strlen(obisCode);
-                
-                // KAIFA meter specific OBIS codes for current values
-                if (strstr(obisCode, "31.7.0") != nullptr) {
-                    // Current L1 (A) - KAIFA/DSMR format - Following Python implementation
-                    int currentValue = static_cast<int>(obisValue);
-                    currentL1 = currentValue;
-                    ESP_LOGI("obis", "Current L1: %d A (OBIS: %s)", currentValue, obisCode);
-                    return;
-                }
-                
-                if (strstr(obisCode, "51.7.0") != nullptr) {
-                    // Current L2 (A) - KAIFA/DSMR format - Following Python implementation
-                    int currentValue = static_cast<int>(obisValue);
-                    currentL2 = currentValue;
-                    ESP_LOGI("obis", "Current L2: %d A (OBIS: %s)", currentValue, obisCode);
-                    return;
-                }
-                
-                if (strstr(obisCode, "71.7.0") != nullptr) {
-                    // Current L3 (A) - KAIFA/DSMR format - Following Python implementation
-                    int currentValue = static_cast<int>(obisValue);
-                    currentL3 = currentValue;
-                    ESP_LOGI("obis", "Current L3: %d A (OBIS: %s)", currentValue, obisCode);
-                    return;
-                }
-                
-                // DSMR / KAIFA specific tariff readings (T1/T2)
-                if (strstr(obisCode, "1.8.2") != nullptr || strstr(obisCode, "1-0:1.8.2") != nullptr) {
-                    cumulativeActiveImportT1 = obisValue; // Now T1 = 1.8.2 (Day tariff)
-                    ESP_LOGI("obis", "T1 Day Import: %f kWh", cumulativeActiveImportT1);
-                    
-                    totalCumulativeActiveImport = cumulativeActiveImportT1 + cumulativeActiveImportT2;
-                    ESP_LOGI("obis", "Total Import updated: %f kWh", totalCumulativeActiveImport);
-                    return;
-                }
-                
-                if (strstr(obisCode, "1.8.1") != nullptr || strstr(obisCode, "1-0:1.8.1") != nullptr) {
-                    cumulativeActiveImportT2 = obisValue; // Now T2 = 1.8.1 (Night tariff)
-                    ESP_LOGI("obis", "T2 Night Import: %f kWh", cumulativeActiveImportT2);
-                    
-                    totalCumulativeActiveImport = cumulativeActiveImportT1 + cumulativeActiveImportT2;
-                    ESP_LOGI("obis", "Total Import updated: %f kWh", totalCumulativeActiveImport);
-                    return;
-                }
-                
-                if (strstr(obisCode, "2.8.1") != nullptr || strstr(obisCode, "1-0:2.8.1") != nullptr) {
-                    cumulativeActiveExportT1 = obisValue;
-                    ESP_LOGI("obis", "T1 Export: %f kWh", cumulativeActiveExportT1);
-                    // Set the generic cumulative export value to sum of tariffs
-                    cumulativeActiveExport = cumulativeActiveExportT1 + cumulativeActiveExportT2;
-                    ESP_LOGI("obis", "Total Export updated: %f kWh", cumulativeActiveExport);
-                    return;
-                }
-                
-                if (strstr(obisCode, "2.8.2") != nullptr || strstr(obisCode, "1-0:2.8.2") != nullptr) {
-                    cumulativeActiveExportT2 = obisValue;
-                    ESP_LOGI("obis", "T2 Export: %f kWh", cumulativeActiveExportT2);
-                    // Set the generic cumulative export value to sum of tariffs
-                    cumulativeActiveExport = cumulativeActiveExportT1 + cumulativeActiveExportT2;
-                    ESP_LOGI("obis", "Total Export updated: %f kWh", cumulativeActiveExport);
-                    return;
-                }
-                
-                // Gas measurement patterns - Support all common DSMR formats
-                // Standard DSMR 4/5 gas meter reading format: 0-1:24.2.1 (channel 0, OBIS 24.2.1 = Gas meter)
-                if (strstr(obisCode, "24.2.1") != nullptr || strstr(obisCode, "24.3.0") != nullptr ||
-                    strstr(obisCode, "0-1:24.2.1") != nullptr || strstr(obisCode, "0-1:24.3.0") != nullptr ||
-                    strstr(obisCode, "0-2:24.2.1") != nullptr || strstr(obisCode, "0-2:24.3.0") != nullptr) {
-                    gasConsumption = obisValue;
-                    ESP_LOGI("obis", "Gas consumption: %f m³ (Code: %s)", gasConsumption, obisCode);
-                    return;
-                }
-                
-                // Water measurement patterns (if available)
-                // Standard DSMR water meter: 0-n:24.2.1 where n=3,4,etc for water channels
-                if (strstr(obisCode, "1-0:8.0") != nullptr || strstr(obisCode, "8.0") != nullptr ||
-                    strstr(obisCode, "0-1:24.2.1.8") != nullptr || strstr(obisCode, "0-3:24.2.1") != nullptr ||
-                    strstr(obisCode, "0-4:24.2.1") != nullptr) {
-                    waterConsumption = obisValue;
-                    ESP_LOGI("obis", "Water consumption: %f m³ (Code: %s)", waterConsumption, obisCode);
+                size_t len = 0;
+                while (value[len] != ')' && value[len] != '\0')
+                    len++;
+
+                if (field == TEXT_TIMESTAMP && len == 13 && parseTimestamp(value))
                     return;
-                }
-                
-                // Generic OBIS code parsing for standard values
-                if (obisCodeLen < 5) return;
 
-                switch (obisCode[0])
+                setText(field, value, len);
+            }
+
+            // YYMMDDhhmmss followed by W or S for winter and summer time
+            bool parseTimestamp(const char* value)
+            {
+                uint8_t groups[6];
+                for (uint8_t i = 0; i < 6; i++)
                 {
-                    case '1':
-                        switch (obisCode[2])
-                        {
-                            case '7':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        momentaryActiveImport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            case '8':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        totalCumulativeActiveImport = obisValue;
-                                        break;
-                                    // Specific tariff readings are handled above
-                                    default: break;
-                                }
-                                break;
-                            default: break;
-                        }
-                        break;
-                    case '2':
-                        switch (obisCode[2])
-                        {
-                            case '7':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        momentaryActiveExport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            case '8':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        cumulativeActiveExport = obisValue;
-                                        break;
-                                    // Specific tariff readings are handled above
-                                    default: break;
-                                }
-                                break;
-                            default: break;
-                        }
-                        break;
-                    case '3':
-                        switch (obisCode[2])
-                        {
-                            case '7':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        momentaryReactiveImport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            case '8':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        cumulativeReactiveImport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            default: break;
-                        }
-                        break;
-                    case '4':
-                        switch (obisCode[2])
-                        {
-                            case '7':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        momentaryReactiveExport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            case '8':
-                                switch (obisCode[4])
-                                {
-                                    case '0': 
-                                        cumulativeReactiveExport = obisValue;
-                                        break;
-                                    default: break;
-                                }
-                                break;
-                            default: break;
-                        }
-                        break;
-                    default: break;
+                    char high = value[i * 2];
+                    char low = value[i * 2 + 1];
+                    if (high < '0' || high > '9' || low < '0' || low > '9')
+                        return false;
+                    groups[i] = (high - '0') * 10 + (low - '0');
                 }
+
+                setTimestamp(2000 + groups[0], groups[1], groups[2], groups[3], groups[4], groups[5]);
+                return true;
             }
-            
+
+            void setValue(uint8_t field, int64_t raw, int8_t scale)
+            {
+                values[field] = raw;
+                scales[field] = scale;
+                received |= fieldBit(field);
+            }
+
+            float getValue(uint8_t field) const
+            {
+                return fixedToFloat(values[field], scales[field]);
+            }
+
             // Initialize CRC and telegram variables
             void initNewTelegram()
             {
                 telegramComplete = false;
                 crcOk = false;
                 crc = 0;
-                sensorsToSend = 33; // Include all important sensors including T1/T2 and other data
+                received = 0;
+                toPublish = 0;
+                textReceived = 0;
+                textToPublish = 0;
+                hasMeterTime = false;
+                hasLatency = false;
+#ifdef USE_P1READER_OBIS_SENSORS
+                obisReceived = 0;
+                obisToPublish = 0;
+#endif
+            }
+
+            // Called by the parser at the end of a telegram, with the fields that have a sensor
+            void completeTelegram(uint32_t configuredFields)
+            {
+                updateCumulativeTotals();
+                toPublish = received & configuredFields;
+                textToPublish = textReceived;
+#ifdef USE_P1READER_OBIS_SENSORS
+                obisToPublish = obisReceived;
+#endif
+                telegramComplete = true;
             }
             
             // Update CRC16 with a new byte
             void updateCrc16(char b)
             {
-                crc = (uint16_t)((crc >> 8) | (crc << 8));
-                crc ^= (uint16_t) b & 0xFF;
-                crc ^= (uint16_t) ((crc & 0xFF) >> 4);
-                crc ^= (uint16_t) ((crc << 8) << 4);
-                crc ^= (uint16_t) (((crc & 0xFF) << 4) << 1);
+                crc = crc16XmodemUpdate(crc, (uint8_t)b);
             }
             
             // Check if the CRC matches
@@ -303,17 +277,35 @@ namespace esphome
                 crcOk = (messageCrc == crc);
                 return crcOk;
             }
-            
-            // Update cumulative totals from tariffs
+
+            // Meters that only send the tariff registers get the total as T1 + T2
+            // Only when both tariffs are in this telegram, values[] keeps the ones of earlier
+            // telegrams so a tariff that is missing would add a stale reading
             void updateCumulativeTotals() {
-                // Calculate total cumulative import from T1 + T2
-                totalCumulativeActiveImport = cumulativeActiveImportT1 + cumulativeActiveImportT2;
-                
-                // Calculate total cumulative export from T1 + T2
-                cumulativeActiveExport = cumulativeActiveExportT1 + cumulativeActiveExportT2;
+                const uint32_t importTariffs = fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1) | fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2);
+                const uint32_t exportTariffs = fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT_T1) | fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT_T2);
+
+                if (!(received & fieldBit(FIELD_CUMULATIVE_ACTIVE_IMPORT)) && (received & importTariffs) == importTariffs)
+                {
+                    int64_t raw;
+                    int8_t scale;
+                    addFixed(values[FIELD_CUMULATIVE_ACTIVE_IMPORT_T1], scales[FIELD_CUMULATIVE_ACTIVE_IMPORT_T1],
+                             values[FIELD_CUMULATIVE_ACTIVE_IMPORT_T2], scales[FIELD_CUMULATIVE_ACTIVE_IMPORT_T2], raw, scale);
+                    setValue(FIELD_CUMULATIVE_ACTIVE_IMPORT, raw, scale);
+                }
+
+                if (!(received & fieldBit(FIELD_CUMULATIVE_ACTIVE_EXPORT)) && (received & exportTariffs) == exportTariffs)
+                {
+                    int64_t raw;
+                    int8_t scale;
+                    addFixed(values[FIELD_CUMULATIVE_ACTIVE_EXPORT_T1], scales[FIELD_CUMULATIVE_ACTIVE_EXPORT_T1],
+                             values[FIELD_CUMULATIVE_ACTIVE_EXPORT_T2], scales[FIELD_CUMULATIVE_ACTIVE_EXPORT_T2], raw, scale);
+                    setValue(FIELD_CUMULATIVE_ACTIVE_EXPORT, raw, scale);
+                }
                 
-                ESP_LOGI("totals", "Updated cumulative totals - Import: %f kWh (T1: %f, T2: %f), Export: %f kWh", 
-                         totalCumulativeActiveImport, cumulativeActiveImportT1, cumulativeActiveImportT2, cumulativeActiveExport);
+                ESP_LOGV("totals", "Cumulative totals - Import: %f kWh (T1: %f, T2: %f), Export: %f kWh", 
+                         getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT), getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T1), 
+                         getValue(FIELD_CUMULATIVE_ACTIVE_IMPORT_T2), getValue(FIELD_CUMULATIVE_ACTIVE_EXPORT));
             }
             
             // Constructor
@@ -321,49 +313,207 @@ namespace esphome
             {
                 telegramComplete = false;
                 crcOk = false;
-                sensorsToSend = 32;
+                received = 0;
+                toPublish = 0;
+                textReceived = 0;
+                textToPublish = 0;
+                hasMeterTime = false;
+                hasLatency = false;
+#ifdef USE_P1READER_OBIS_SENSORS
+                obisReceived = 0;
+                obisToPublish = 0;
+#endif
                 
                 // Initialize all values to 0
-                totalCumulativeActiveImport = 0;
-                cumulativeActiveExport = 0;
-                cumulativeReactiveImport = 0;
-                cumulativeReactiveExport = 0;
-                momentaryActiveImport = 0;
-                momentaryActiveExport = 0;
-                momentaryReactiveImport = 0;
-                momentaryReactiveExport = 0;
-                momentaryActiveImportL1 = 0;
-                momentaryActiveExportL1 = 0;
-                momentaryActiveImportL2 = 0;
-                momentaryActiveExportL2 = 0;
-                momentaryActiveImportL3 = 0;
-                momentaryActiveExportL3 = 0;
-                momentaryReactiveImportL1 = 0;
-                momentaryReactiveExportL1 = 0;
-                momentaryReactiveImportL2 = 0;
-                momentaryReactiveExportL2 = 0;
-                momentaryReactiveImportL3 = 0;
-                momentaryReactiveExportL3 = 0;
-                voltageL1 = 0;
-                voltageL2 = 0;
-                voltageL3 = 0;
-                currentL1 = 0;
-                currentL2 = 0;
-                currentL3 = 0;
-                
-                // DSMR specific tariff readings
-                cumulativeActiveImportT1 = 0;
-                cumulativeActiveImportT2 = 0;
-                cumulativeActiveExportT1 = 0;
-                cumulativeActiveExportT2 = 0;
-                
-                // Gas and water consumption
-                gasConsumption = 0;
-                waterConsumption = 0;
+                memset(values, 0, sizeof(values));
+                memset(scales, 0, sizeof(scales));
+                memset(texts, 0, sizeof(texts));
                 
                 crc = 0;
-                sensorsToSend = 33; // Initialize to include all important sensors including T1/T2 and other data
             }
         };
+
+        struct ObisField
+        {
+            uint32_t key;
+            uint8_t field;
+        };
+
+        // Sorted by key so a row can be resolved with a binary search
+        static constexpr ObisField OBIS_FIELDS[] = {
+            // Gas (DSMR channel 1 and 2) and water (channel 3 and 4) meters
+            { obisKey(0, 1, 24, 2, 1), FIELD_GAS_CONSUMPTION },
+            { obisKey(0, 1, 24, 3, 0), FIELD_GAS_CONSUMPTION },
+            { obisKey(0, 2, 24, 2, 1), FIELD_GAS_CONSUMPTION },
+            { obisKey(0, 2, 24, 3, 0), FIELD_GAS_CONSUMPTION },
+            { obisKey(0, 3, 24, 2, 1), FIELD_WATER_CONSUMPTION },
+            { obisKey(0, 4, 24, 2, 1), FIELD_WATER_CONSUMPTION },
+
+            { obisKey(1, 0, 1, 7, 0), FIELD_MOMENTARY_ACTIVE_IMPORT },
+            { obisKey(1, 0, 1, 8, 0), FIELD_CUMULATIVE_ACTIVE_IMPORT },
+            { obisKey(1, 0, 1, 8, 1), FIELD_CUMULATIVE_ACTIVE_IMPORT_T2 }, // T2 = 1.8.1 (Night tariff)
+            { obisKey(1, 0, 1, 8, 2), FIELD_CUMULATIVE_ACTIVE_IMPORT_T1 }, // T1 = 1.8.2 (Day tariff)
+            { obisKey(1, 0, 2, 7, 0), FIELD_MOMENTARY_ACTIVE_EXPORT },
+            { obisKey(1, 0, 2, 8, 0), FIELD_CUMULATIVE_ACTIVE_EXPORT },
+            { obisKey(1, 0, 2, 8, 1), FIELD_CUMULATIVE_ACTIVE_EXPORT_T1 },
+            { obisKey(1, 0, 2, 8, 2), FIELD_CUMULATIVE_ACTIVE_EXPORT_T2 },
+            { obisKey(1, 0, 3, 7, 0), FIELD_MOMENTARY_REACTIVE_IMPORT },
+            { obisKey(1, 0, 3, 8, 0), FIELD_CUMULATIVE_REACTIVE_IMPORT },
+            { obisKey(1, 0, 4, 7, 0), FIELD_MOMENTARY_REACTIVE_EXPORT },
+            { obisKey(1, 0, 4, 8, 0), FIELD_CUMULATIVE_REACTIVE_EXPORT },
+
+            // Phase specific readings
+            { obisKey(1, 0, 21, 7, 0), FIELD_MOMENTARY_ACTIVE_IMPORT_L1 },
+            { obisKey(1, 0, 22, 7, 0), FIELD_MOMENTARY_ACTIVE_EXPORT_L1 },
+            { obisKey(1, 0, 23, 7, 0), FIELD_MOMENTARY_REACTIVE_IMPORT_L1 },
+            { obisKey(1, 0, 24, 7, 0), FIELD_MOMENTARY_REACTIVE_EXPORT_L1 },
+            { obisKey(1, 0, 31, 7, 0), FIELD_CURRENT_L1 },
+            { obisKey(1, 0, 32, 7, 0), FIELD_VOLTAGE_L1 },
+            { obisKey(1, 0, 41, 7, 0), FIELD_MOMENTARY_ACTIVE_IMPORT_L2 },
+            { obisKey(1, 0, 42, 7, 0), FIELD_MOMENTARY_ACTIVE_EXPORT_L2 },
+            { obisKey(1, 0, 43, 7, 0), FIELD_MOMENTARY_REACTIVE_IMPORT_L2 },
+            { obisKey(1, 0, 44, 7, 0), FIELD_MOMENTARY_REACTIVE_EXPORT_L2 },
+            { obisKey(1, 0, 51, 7, 0), FIELD_CURRENT_L2 },
+            { obisKey(1, 0, 52, 7, 0), FIELD_VOLTAGE_L2 },
+            { obisKey(1, 0, 61, 7, 0), FIELD_MOMENTARY_ACTIVE_IMPORT_L3 },
+            { obisKey(1, 0, 62, 7, 0), FIELD_MOMENTARY_ACTIVE_EXPORT_L3 },
+            { obisKey(1, 0, 63, 7, 0), FIELD_MOMENTARY_REACTIVE_IMPORT_L3 },
+            { obisKey(1, 0, 64, 7, 0), FIELD_MOMENTARY_REACTIVE_EXPORT_L3 },
+            { obisKey(1, 0, 71, 7, 0), FIELD_CURRENT_L3 },
+            { obisKey(1, 0, 72, 7, 0), FIELD_VOLTAGE_L3 },
+        };
+
+        static constexpr size_t OBIS_FIELD_COUNT = sizeof(OBIS_FIELDS) / sizeof(OBIS_FIELDS[0]);
+
+        constexpr bool obisFieldsSorted(size_t i = 1)
+        {
+            return i >= OBIS_FIELD_COUNT || (OBIS_FIELDS[i - 1].key < OBIS_FIELDS[i].key && obisFieldsSorted(i + 1));
+        }
+        static_assert(obisFieldsSorted(), "OBIS_FIELDS must be sorted by key");
+
+        inline const ObisField* findObisField(uint32_t obisKey)
+        {
+            size_t low = 0;
+            size_t high = OBIS_FIELD_COUNT;
+            while (low < high)
+            {
+                size_t mid = (low + high) / 2;
+                if (OBIS_FIELDS[mid].key < obisKey)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            return (low < OBIS_FIELD_COUNT && OBIS_FIELDS[low].key == obisKey) ? &OBIS_FIELDS[low] : nullptr;
+        }
+
+        // Where the value of a row goes: a built-in field, an obis sensor or both
+        struct RowTarget
+        {
+            uint32_t key;
+            int8_t field;
+            int8_t sensor;
+        };
+
+        /*  The rows a reader uses, sorted by code: the built-in fields something reads and the
+            obis sensors. It is built once in setup() from the configuration rather than generated
+            by sensor.py, as the sensors of a reader can come from several sensor blocks and
+            history, peaks and the telegram sensor also read fields. A row then takes one binary
+            search and rows that nothing reads are skipped before their value is converted.
+        */
+        class RowTable
+        {
+        public:
+#ifdef USE_P1READER_OBIS_SENSORS
+            static const uint8_t MAX_ROWS = OBIS_FIELD_COUNT + OBIS_SENSORS_MAX;
+#else
+            static const uint8_t MAX_ROWS = OBIS_FIELD_COUNT;
+#endif
+
+            // Adds a target for the code, or to the code's entry if it is already there
+            void add(uint32_t key, int8_t field, int8_t sensor)
+            {
+                uint8_t index = lowerBound(key);
+                if (index < _count && _rows[index].key == key)
+                {
+                    if (field >= 0)
+                        _rows[index].field = field;
+                    if (sensor >= 0)
+                        _rows[index].sensor = sensor;
+                    return;
+                }
+                if (_count == MAX_ROWS)
+                    return;
+                memmove(&_rows[index + 1], &_rows[index], (_count - index) * sizeof(_rows[0]));
+                _rows[index] = RowTarget{key, field, sensor};
+                _count++;
+            }
+
+            uint8_t count() const { return _count; }
+
+            const RowTarget* find(uint32_t key) const
+            {
+                uint8_t index = lowerBound(key);
+                return (index < _count && _rows[index].key == key) ? &_rows[index] : nullptr;
+            }
+
+        protected:
+            RowTarget _rows[MAX_ROWS];
+            uint8_t _count{0};
+
+            uint8_t lowerBound(uint32_t key) const
+            {
+                uint8_t low = 0;
+                uint8_t high = _count;
+                while (low < high)
+                {
+                    uint8_t mid = (low + high) / 2;
+                    if (_rows[mid].key < key)
+                        low = mid + 1;
+                    else
+                        high = mid;
+                }
+                return low;
+            }
+        };
+
+        inline void ParsedMessage::parseRow(uint32_t obisKey, const char* value)
+        {
+            // Only convert the value for rows that are actually used
+            int64_t raw;
+            int8_t scale;
+            if (rows != nullptr && rows->find(obisKey) != nullptr && parseFixed(value, raw, scale))
+            {
+                parseRow(obisKey, raw, scale);
+            }
+        }
+
+        inline void ParsedMessage::parseRow(uint32_t obisKey, int64_t raw, int8_t scale)
+        {
+            const RowTarget* row = rows != nullptr ? rows->find(obisKey) : nullptr;
+            if (row == nullptr)
+            {
+                return;
+            }
+
+            ESP_LOGVV("obis", "%u-%u:%u.%u.%u = %lld * 10^%d", (unsigned)(obisKey >> 28), (unsigned)((obisKey >> 24) & 0x0f), 
+                     (unsigned)((obisKey >> 16) & 0xff), (unsigned)((obisKey >> 8) & 0xff), (unsigned)(obisKey & 0xff), 
+                     (long long)raw, scale);
+
+#ifdef USE_P1READER_OBIS_SENSORS
+            if (row->sensor >= 0)
+            {
+                obisValues[row->sensor] = raw;
+                obisScales[row->sensor] = scale;
+                obisReceived |= 1UL << row->sensor;
+            }
+#endif
+            if (row->field >= 0)
+            {
+                setValue(row->field, raw, scale);
+            }
+
+            if (trace != nullptr)
+                trace->record(TRACE_ROW, obisKey, raw, scale);
+        }
     } // namespace p1_reader
 } // namespace esphome
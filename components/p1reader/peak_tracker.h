@@ -0,0 +1,221 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        struct PowerPeak
+        {
+            uint32_t start;     // Epoch of the start of the period, 0 without a clock
+            float averageKw;
+        };
+
+        // Average import power per period (15 or 60 minutes) as used by effect tariffs, and the
+        // highest period averages of the month. Energy is taken from the cumulative import
+        // register when it is in two consecutive telegrams, otherwise momentary import power is
+        // integrated. Energy and power are kept in mWh and mW.
+        //
+        // Periods are aligned to the local clock when there is one, otherwise to the time since
+        // boot. Only the offset within a period matters, so daylight saving does not move them.
+        // Only periods that were followed from their start are ranked, the top list is cleared
+        // when the month changes (which requires a clock).
+        class PeakTracker
+        {
+        public:
+            static const uint8_t MAX_TOP_N = 10;
+
+            void configure(uint32_t periodS, uint8_t topN)
+            {
+                _periodMs = periodS * 1000;
+                _topN = topN > MAX_TOP_N ? MAX_TOP_N : topN;
+            }
+
+            bool enabled() const { return _periodMs != 0; }
+
+            // One telegram, epoch and month (1-12) are 0 when there is no valid clock. The month
+            // and utcOffsetS are those of the local time.
+            void update(uint32_t nowMs, uint32_t epoch, int32_t utcOffsetS, uint8_t month, bool hasEnergy,
+                        int64_t energyMWh, bool hasPower, int64_t powerMW)
+            {
+                uint32_t dtMs = _haveLast ? nowMs - _lastMs : 0;
+                _uptimeMs += dtMs;
+
+                bool clockBased = (epoch != 0);
+                uint64_t t = clockBased ? (uint64_t)epoch * 1000 : _uptimeMs;
+                int64_t offsetMs = clockBased ? (int64_t)utcOffsetS * 1000 % _periodMs : 0;
+                _alignMs = offsetMs < 0 ? offsetMs + _periodMs : offsetMs;
+                uint64_t index = (t + _alignMs) / _periodMs;
+
+                int64_t increment = 0;
+                if (_haveLast && hasEnergy && _lastHasEnergy)
+                {
+                    // A register going backwards is a replaced meter or a bad row, skip it
+                    increment = energyMWh - _lastEnergyMWh;
+                    if (increment < 0)
+                        increment = 0;
+                }
+                else if (_haveLast && hasPower && _lastHasPower)
+                {
+                    increment = (_lastPowerMW + powerMW) / 2 * (int64_t)dtMs / 3600000;
+                }
+
+                if (!_havePeriod || clockBased != _clockBased || index < _index)
+                {
+                    startPeriod(index, t, month, false);
+                    _clockBased = clockBased;
+                }
+                else if (index == _index + 1 && _haveLast && t > _lastT)
+                {
+                    // Split the energy since the previous telegram at the period boundary
+                    uint64_t boundary = index * _periodMs - _alignMs;
+                    int64_t before = increment * (int64_t)(boundary - _lastT) / (int64_t)(t - _lastT);
+                    _energyMWh += before;
+                    endPeriod();
+                    startPeriod(index, boundary, month, true);
+                    increment -= before;
+                }
+                else if (index > _index)
+                {
+                    // Telegrams missing across the boundary
+                    endPeriod();
+                    startPeriod(index, t, month, false);
+                    increment = 0;
+                }
+
+                _energyMWh += increment;
+
+                _haveLast = true;
+                _lastMs = nowMs;
+                _lastT = t;
+                _lastHasEnergy = hasEnergy;
+                _lastEnergyMWh = energyMWh;
+                _lastHasPower = hasPower;
+                _lastPowerMW = powerMW;
+            }
+
+            // Average since the start of the current period
+            float averageKw() const
+            {
+                uint64_t elapsedMs = _lastT - _periodStartT;
+                if (!_haveLast || elapsedMs == 0)
+                    return 0.0f;
+                return (float)_energyMWh * 3.6f / (float)elapsedMs;
+            }
+
+            // Average of the whole current period, if the power stays as it is now
+            float projectedKw() const
+            {
+                if (!_haveLast)
+                    return 0.0f;
+
+                uint64_t periodEnd = (_index + 1) * _periodMs - _alignMs;
+                uint64_t remainingMs = periodEnd > _lastT ? periodEnd - _lastT : 0;
+                float powerKw = _lastHasPower ? _lastPowerMW / 1000000.0f : averageKw();
+                return ((float)_energyMWh * 3.6f + powerKw * (float)remainingMs) / (float)_periodMs;
+            }
+
+            uint8_t peakCount() const { return _peakCount; }
+            const PowerPeak& peak(uint8_t i) const { return _peaks[i]; }
+
+            float maxKw() const { return _peakCount > 0 ? _peaks[0].averageKw : 0.0f; }
+
+            float topAverageKw() const
+            {
+                if (_peakCount == 0)
+                    return 0.0f;
+
+                float sum = 0.0f;
+                for (uint8_t i = 0; i < _peakCount; i++)
+                    sum += _peaks[i].averageKw;
+                return sum / _peakCount;
+            }
+
+            // True once after the top list has changed
+            bool takePeaksChanged()
+            {
+                bool changed = _peaksChanged;
+                _peaksChanged = false;
+                return changed;
+            }
+
+        protected:
+            void startPeriod(uint64_t index, uint64_t startT, uint8_t month, bool fromStart)
+            {
+                _havePeriod = true;
+                _index = index;
+                _periodStartT = startT;
+                _periodMonth = month;
+                _fromStart = fromStart;
+                _energyMWh = 0;
+            }
+
+            void endPeriod()
+            {
+                if (!_fromStart)
+                    return;
+
+                if (_periodMonth != _peaksMonth)
+                {
+                    _peakCount = 0;
+                    _peaksMonth = _periodMonth;
+                    _peaksChanged = true;
+                }
+
+                PowerPeak peak;
+                peak.start = _clockBased ? (uint32_t)(_periodStartT / 1000) : 0;
+                peak.averageKw = (float)_energyMWh * 3.6f / (float)_periodMs;
+
+                // Sorted highest first, insert in place
+                uint8_t pos = _peakCount;
+                while (pos > 0 && _peaks[pos - 1].averageKw < peak.averageKw)
+                    pos--;
+                if (pos >= _topN)
+                    return;
+
+                uint8_t last = _peakCount < _topN ? _peakCount : _topN - 1;
+                for (uint8_t i = last; i > pos; i--)
+                    _peaks[i] = _peaks[i - 1];
+                _peaks[pos] = peak;
+                if (_peakCount < _topN)
+                    _peakCount++;
+                _peaksChanged = true;
+            }
+
+            uint32_t _periodMs{0};
+            uint8_t _topN{3};
+            uint32_t _alignMs{0};       // Local time ahead of the clock, modulo the period
+
+            uint64_t _uptimeMs{0};
+            bool _haveLast{false};
+            uint32_t _lastMs{0};
+            uint64_t _lastT{0};
+            bool _lastHasEnergy{false};
+            int64_t _lastEnergyMWh{0};
+            bool _lastHasPower{false};
+            int64_t _lastPowerMW{0};
+
+            // Current period, times in ms of the clock or of the time since boot
+            bool _havePeriod{false};
+            bool _clockBased{false};
+            bool _fromStart{false};
+            uint64_t _index{0};
+            uint64_t _periodStartT{0};
+            uint8_t _periodMonth{0};
+            int64_t _energyMWh{0};
+
+            PowerPeak _peaks[MAX_TOP_N];
+            uint8_t _peakCount{0};
+            uint8_t _peaksMonth{0};
+            bool _peaksChanged{false};
+        };
+    } // namespace p1_reader
+} // namespace esphome
@@ -1,14 +1,18 @@
+import re
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import sensor
 from esphome.const import (
     CONF_ID,
     DEVICE_CLASS_CURRENT,
+    DEVICE_CLASS_DURATION,
     DEVICE_CLASS_ENERGY,
     DEVICE_CLASS_GAS,
     DEVICE_CLASS_POWER,
     DEVICE_CLASS_REACTIVE_POWER,
     DEVICE_CLASS_VOLTAGE,
+    ENTITY_CATEGORY_DIAGNOSTIC,
     STATE_CLASS_MEASUREMENT,
     STATE_CLASS_TOTAL_INCREASING,
     UNIT_AMPERE,
@@ -16,206 +20,371 @@ from esphome.const import (
     UNIT_KILOWATT_HOURS,
     UNIT_KILOVOLT_AMPS_REACTIVE_HOURS,
     UNIT_KILOVOLT_AMPS_REACTIVE,
+    UNIT_MICROSECOND,
+    UNIT_MILLISECOND,
+    UNIT_SECOND,
     UNIT_VOLT,
 )
-from . import P1Reader, CONF_P1READER_ID
+from . import P1Reader, CONF_P1READER_ID, p1reader_ns
 
 AUTO_LOAD = ["p1reader"]
 
+CONF_DEADBAND = "deadband"
+CONF_MAX_INTERVAL = "max_interval"
+CONF_OBIS = "obis"
+CONF_OBIS_SENSORS = "obis_sensors"
+
+# One bit per obis sensor in the masks of ParsedMessage
+MAX_OBIS_SENSORS = 32
+
+P1Sensor = p1reader_ns.class_("P1Sensor", sensor.Sensor)
+
+
+def p1_sensor_schema(**kwargs):
+    # Publish only when the value moved more than deadband, or max_interval passed
+    return sensor.sensor_schema(P1Sensor, **kwargs).extend(
+        {
+            cv.Optional(CONF_DEADBAND): cv.positive_float,
+            cv.Optional(CONF_MAX_INTERVAL): cv.positive_time_period_milliseconds,
+        }
+    )
+
+
+def obis_code(value):
+    # "A-B:C.D.E" as sent in the ASCII telegrams, returned as the groups
+    value = cv.string_strict(value)
+    match = re.fullmatch(r"(\d+)-(\d+):(\d+)\.(\d+)\.(\d+)", value.strip())
+    if match is None:
+        raise cv.Invalid(f"OBIS code must look like 1-0:32.7.0, got '{value}'")
+    groups = [int(g) for g in match.groups()]
+    if groups[0] > 15 or groups[1] > 15 or any(g > 255 for g in groups[2:]):
+        raise cv.Invalid(f"OBIS code '{value}' out of range, A and B must be at most 15, C, D and E at most 255")
+    return groups
+
+
+def obis_key(groups):
+    # Same packing as obisKey() in obis.h
+    a, b, c, d, e = groups
+    return (a << 28) | (b << 24) | (c << 16) | (d << 8) | e
+
+
+def unique_obis_codes(value):
+    keys = [obis_key(conf[CONF_OBIS]) for conf in value]
+    for i, key in enumerate(keys):
+        if key in keys[:i]:
+            raise cv.Invalid(f"OBIS code {value[i][CONF_OBIS]} is used by more than one sensor")
+    return value
+
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(CONF_P1READER_ID): cv.use_id(P1Reader),
-        cv.Optional("cumulative_active_export"): sensor.sensor_schema(
+        # Any other row of the telegram, published in the unit the meter sends it in
+        # (power and energy in kW and kWh for HDLC meters)
+        cv.Optional(CONF_OBIS_SENSORS): cv.All(
+            cv.ensure_list(
+                p1_sensor_schema(state_class=STATE_CLASS_MEASUREMENT).extend(
+                    {cv.Required(CONF_OBIS): obis_code}
+                )
+            ),
+            cv.Length(min=1, max=MAX_OBIS_SENSORS),
+            unique_obis_codes,
+        ),
+        cv.Optional("cumulative_active_export"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("cumulative_active_import"): sensor.sensor_schema(
+        cv.Optional("cumulative_active_import"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("cumulative_reactive_export"): sensor.sensor_schema(
+        cv.Optional("cumulative_reactive_export"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE_HOURS,
             state_class=STATE_CLASS_TOTAL_INCREASING,
             accuracy_decimals=3,
         ),
-        cv.Optional("cumulative_reactive_import"): sensor.sensor_schema(
+        cv.Optional("cumulative_reactive_import"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE_HOURS,
             state_class=STATE_CLASS_TOTAL_INCREASING,
             accuracy_decimals=3,
         ),
-        cv.Optional("momentary_active_export"): sensor.sensor_schema(
+        cv.Optional("momentary_active_export"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_import"): sensor.sensor_schema(
+        cv.Optional("momentary_active_import"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_export"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_export"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_import"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_import"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,            
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_export_l1"): sensor.sensor_schema(
+        cv.Optional("momentary_active_export_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_export_l2"): sensor.sensor_schema(
+        cv.Optional("momentary_active_export_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_export_l3"): sensor.sensor_schema(
+        cv.Optional("momentary_active_export_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_import_l1"): sensor.sensor_schema(
+        cv.Optional("momentary_active_import_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_import_l2"): sensor.sensor_schema(
+        cv.Optional("momentary_active_import_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_active_import_l3"): sensor.sensor_schema(
+        cv.Optional("momentary_active_import_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_export_l1"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_export_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_export_l2"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_export_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_export_l3"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_export_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_import_l1"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_import_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_import_l2"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_import_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("momentary_reactive_import_l3"): sensor.sensor_schema(
+        cv.Optional("momentary_reactive_import_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOVOLT_AMPS_REACTIVE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_REACTIVE_POWER,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("voltage_l1"): sensor.sensor_schema(
+        cv.Optional("voltage_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("voltage_l2"): sensor.sensor_schema(
+        cv.Optional("voltage_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("voltage_l3"): sensor.sensor_schema(
+        cv.Optional("voltage_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_VOLT,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_VOLTAGE,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("current_l1"): sensor.sensor_schema(
+        cv.Optional("current_l1"): p1_sensor_schema(
             unit_of_measurement=UNIT_AMPERE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_CURRENT,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("current_l2"): sensor.sensor_schema(
+        cv.Optional("current_l2"): p1_sensor_schema(
             unit_of_measurement=UNIT_AMPERE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_CURRENT,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
-        cv.Optional("current_l3"): sensor.sensor_schema(
+        cv.Optional("current_l3"): p1_sensor_schema(
             unit_of_measurement=UNIT_AMPERE,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_CURRENT,
             state_class=STATE_CLASS_MEASUREMENT,
         ),
         # DSMR specific tariff readings
-        cv.Optional("cumulative_active_import_t1"): sensor.sensor_schema(
+        cv.Optional("cumulative_active_import_t1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("cumulative_active_import_t2"): sensor.sensor_schema(
+        cv.Optional("cumulative_active_import_t2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("cumulative_active_export_t1"): sensor.sensor_schema(
+        cv.Optional("cumulative_active_export_t1"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("cumulative_active_export_t2"): sensor.sensor_schema(
+        cv.Optional("cumulative_active_export_t2"): p1_sensor_schema(
             unit_of_measurement=UNIT_KILOWATT_HOURS,
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_ENERGY,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
         # Gas and water consumption
-        cv.Optional("gas_consumption"): sensor.sensor_schema(
+        cv.Optional("gas_consumption"): p1_sensor_schema(
             unit_of_measurement="m³",
             accuracy_decimals=3,
             device_class=DEVICE_CLASS_GAS,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
-        cv.Optional("water_consumption"): sensor.sensor_schema(
+        cv.Optional("water_consumption"): p1_sensor_schema(
             unit_of_measurement="m³",
             accuracy_decimals=3,
             state_class=STATE_CLASS_TOTAL_INCREASING,
         ),
+        # Average import power per peak_period, for effect tariffs
+        cv.Optional("peak_average"): p1_sensor_schema(
+            unit_of_measurement=UNIT_KILOWATT,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional("peak_projected"): p1_sensor_schema(
+            unit_of_measurement=UNIT_KILOWATT,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional("peak_max"): p1_sensor_schema(
+            unit_of_measurement=UNIT_KILOWATT,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        cv.Optional("peak_top_average"): p1_sensor_schema(
+            unit_of_measurement=UNIT_KILOWATT,
+            accuracy_decimals=3,
+            device_class=DEVICE_CLASS_POWER,
+            state_class=STATE_CLASS_MEASUREMENT,
+        ),
+        # Diagnostics
+        cv.Optional("suppressed_publishes"): p1_sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("bytes_per_second"): p1_sensor_schema(
+            unit_of_measurement="B/s",
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("telegrams_per_second"): p1_sensor_schema(
+            unit_of_measurement="1/s",
+            accuracy_decimals=3,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("crc_failures"): p1_sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("buffer_overflows"): p1_sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("frames_dropped"): p1_sensor_schema(
+            accuracy_decimals=0,
+            state_class=STATE_CLASS_TOTAL_INCREASING,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # Time between telegrams, as learned by the reader
+        cv.Optional("telegram_interval"): p1_sensor_schema(
+            unit_of_measurement=UNIT_SECOND,
+            accuracy_decimals=1,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # Average time from the meter's timestamp to the sensors being published, needs time_id
+        cv.Optional("telegram_latency"): p1_sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # Variation of the arrival of telegrams against the meter's timestamps
+        cv.Optional("telegram_jitter"): p1_sensor_schema(
+            unit_of_measurement=UNIT_MILLISECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        # Longest time in a single call over the last diagnostics period
+        cv.Optional("read_time_max"): p1_sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("parse_time_max"): p1_sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("publish_time_max"): p1_sensor_schema(
+            unit_of_measurement=UNIT_MICROSECOND,
+            accuracy_decimals=0,
+            device_class=DEVICE_CLASS_DURATION,
+            state_class=STATE_CLASS_MEASUREMENT,
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
@@ -226,6 +395,25 @@ async def to_code(config):
         if not isinstance(conf, dict):
             continue
         id = conf[CONF_ID]
-        if id and id.type == sensor.Sensor:
-            sens = await sensor.new_sensor(conf)
+        if id and id.type == P1Sensor:
+            sens = await new_p1_sensor(conf)
             cg.add(getattr(hub, f"set_sensor_{key}")(sens))
+
+    if CONF_OBIS_SENSORS in config:
+        # The table has a fixed size, so several sensor blocks and readers share the define.
+        # The codes of a block are added sorted, add_obis_sensor() keeps them sorted across
+        # blocks and setup() merges them with the built-in fields the reader uses.
+        cg.add_define("USE_P1READER_OBIS_SENSORS")
+        for conf in sorted(config[CONF_OBIS_SENSORS], key=lambda conf: obis_key(conf[CONF_OBIS])):
+            sens = await new_p1_sensor(conf)
+            key = cg.RawExpression("p1_reader::obisKey({}, {}, {}, {}, {})".format(*conf[CONF_OBIS]))
+            cg.add(hub.add_obis_sensor(key, sens))
+
+
+async def new_p1_sensor(conf):
+    sens = await sensor.new_sensor(conf)
+    if CONF_DEADBAND in conf or CONF_MAX_INTERVAL in conf:
+        cg.add(sens.set_deadband(conf.get(CONF_DEADBAND, 0.0)))
+    if CONF_MAX_INTERVAL in conf:
+        cg.add(sens.set_max_interval(conf[CONF_MAX_INTERVAL]))
+    return sens
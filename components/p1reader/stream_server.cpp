@@ -0,0 +1,139 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#include "stream_server.h"
+
+#ifdef USE_P1READER_STREAM
+#include "esphome/core/log.h"
+#include <cerrno>
+#include <new>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        bool StreamServer::setup(uint16_t port, uint32_t ringSize)
+        {
+            uint32_t capacity = 1;
+            while (capacity < ringSize)
+                capacity *= 2;
+
+            _ring = new (std::nothrow) uint8_t[capacity];
+            if (_ring == nullptr)
+                return false;
+            _mask = capacity - 1;
+
+            _server = socket::socket_ip(SOCK_STREAM, 0);
+            if (_server == nullptr)
+            {
+                ESP_LOGE("stream", "Failed to create socket");
+                return false;
+            }
+
+            int enable = 1;
+            _server->setsockopt(SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+            _server->setblocking(false);
+
+            struct sockaddr_storage address;
+            socklen_t length = socket::set_sockaddr_any((struct sockaddr *)&address, sizeof(address), port);
+            if (_server->bind((struct sockaddr *)&address, length) != 0 || _server->listen(MAX_CLIENTS) != 0)
+            {
+                ESP_LOGE("stream", "Failed to listen on port %u (errno %d)", port, errno);
+                _server = nullptr;
+                return false;
+            }
+
+            _port = port;
+            return true;
+        }
+
+        void StreamServer::loop()
+        {
+            if (_server == nullptr)
+                return;
+
+            accept();
+
+            for (Client& client : _clients)
+            {
+                if (client.socket != nullptr && !flush(client))
+                    disconnect(client);
+            }
+        }
+
+        void StreamServer::accept()
+        {
+            struct sockaddr_storage address;
+            socklen_t length = sizeof(address);
+            std::unique_ptr<socket::Socket> socket = _server->accept((struct sockaddr *)&address, &length);
+            if (socket == nullptr)
+                return;
+
+            for (Client& client : _clients)
+            {
+                if (client.socket == nullptr)
+                {
+                    socket->setblocking(false);
+                    ESP_LOGI("stream", "Client %s connected", socket->getpeername().c_str());
+
+                    // Clients start with the next byte read from the uart
+                    client.socket = std::move(socket);
+                    client.cursor = _head;
+                    _clientCount++;
+                    return;
+                }
+            }
+
+            ESP_LOGW("stream", "Too many clients, refusing %s", socket->getpeername().c_str());
+        }
+
+        bool StreamServer::flush(Client& client)
+        {
+            // Anything sent by the client is read and ignored, a read of 0 is a closed connection
+            uint8_t discard[16];
+            ssize_t received = client.socket->read(discard, sizeof(discard));
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                return false;
+
+            uint32_t pending = _head - client.cursor;
+            if (pending > _mask + 1)
+            {
+                _droppedClients++;
+                ESP_LOGW("stream", "Client %s too slow, %u bytes behind", client.socket->getpeername().c_str(), pending);
+                return false;
+            }
+
+            // At most two writes, up to the end of the ring and from its start
+            while (pending > 0)
+            {
+                uint32_t offset = client.cursor & _mask;
+                uint32_t chunk = _mask + 1 - offset;
+                if (chunk > pending)
+                    chunk = pending;
+
+                ssize_t sent = client.socket->write(_ring + offset, chunk);
+                if (sent < 0)
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+
+                client.cursor += sent;
+                pending -= sent;
+                if ((uint32_t)sent < chunk)
+                    break;
+            }
+            return true;
+        }
+
+        void StreamServer::disconnect(Client& client)
+        {
+            ESP_LOGI("stream", "Client %s disconnected", client.socket->getpeername().c_str());
+            client.socket->close();
+            client.socket = nullptr;
+            _clientCount--;
+        }
+    } // namespace p1_reader
+} // namespace esphome
+#endif
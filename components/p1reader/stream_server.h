@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_P1READER_STREAM
+#include "esphome/components/socket/socket.h"
+#include <cstdint>
+#include <memory>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        // Forwards the raw bytes read from the uart to TCP clients. The bytes are kept once in
+        // a ring and each client has its own position in it, clients are written straight from
+        // the ring. A client that falls more than the ring behind is disconnected, skipping
+        // data would hand it broken telegrams.
+        class StreamServer
+        {
+        public:
+            static const uint8_t MAX_CLIENTS = 4;
+
+            // Ring size is rounded up to a power of two
+            bool setup(uint16_t port, uint32_t ringSize);
+            bool enabled() const { return _server != nullptr; }
+
+            void write(const uint8_t* data, size_t len)
+            {
+                if (_clientCount == 0)
+                    return;
+
+                while (len-- > 0)
+                    _ring[_head++ & _mask] = *data++;
+            }
+
+            // Accept new clients and send them what they have not got yet, called from loop()
+            void loop();
+
+            uint16_t port() const { return _port; }
+            uint32_t ringSize() const { return _ring != nullptr ? _mask + 1 : 0; }
+            uint8_t clientCount() const { return _clientCount; }
+            uint32_t droppedClients() const { return _droppedClients; }
+
+        protected:
+            struct Client
+            {
+                std::unique_ptr<socket::Socket> socket;
+                uint32_t cursor;
+            };
+
+            void accept();
+            bool flush(Client& client);
+            void disconnect(Client& client);
+
+            std::unique_ptr<socket::Socket> _server;
+            Client _clients[MAX_CLIENTS];
+            uint8_t _clientCount{0};
+            uint32_t _droppedClients{0};
+            uint16_t _port{0};
+
+            uint8_t* _ring{nullptr};
+            uint32_t _mask{0};
+            uint32_t _head{0};     // Total bytes written, wraps
+        };
+    } // namespace p1_reader
+} // namespace esphome
+#endif
@@ -1,14 +1,91 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import text_sensor
-from esphome.const import CONF_INTERNAL
-from . import P1Reader, CONF_P1READER_ID
+from esphome.const import CONF_INTERNAL, ENTITY_CATEGORY_DIAGNOSTIC
+from . import P1Reader, CONF_P1READER_ID, p1reader_ns
 
 AUTO_LOAD = ["p1reader"]
 
+CONF_FIELDS = "fields"
+
+P1Field = p1reader_ns.enum("P1Field")
+
+# Same names as the sensors, each maps to FIELD_<NAME> in parsed_message.h
+TELEGRAM_FIELDS = [
+    "cumulative_active_import",
+    "cumulative_active_import_t1",
+    "cumulative_active_import_t2",
+    "cumulative_active_export",
+    "cumulative_active_export_t1",
+    "cumulative_active_export_t2",
+    "cumulative_reactive_import",
+    "cumulative_reactive_export",
+    "momentary_active_import",
+    "momentary_active_export",
+    "momentary_reactive_import",
+    "momentary_reactive_export",
+    "momentary_active_import_l1",
+    "momentary_active_export_l1",
+    "momentary_active_import_l2",
+    "momentary_active_export_l2",
+    "momentary_active_import_l3",
+    "momentary_active_export_l3",
+    "momentary_reactive_import_l1",
+    "momentary_reactive_export_l1",
+    "momentary_reactive_import_l2",
+    "momentary_reactive_export_l2",
+    "momentary_reactive_import_l3",
+    "momentary_reactive_export_l3",
+    "voltage_l1",
+    "voltage_l2",
+    "voltage_l3",
+    "current_l1",
+    "current_l2",
+    "current_l3",
+    "gas_consumption",
+    "water_consumption",
+]
+
+# Home Assistant rejects states over 255 characters. A field takes up to 11, a value like
+# 123456.789 and the comma, so this many fit in the array. Longer telegrams are cut short
+# at runtime.
+TELEGRAM_STATE_MAX = 255
+TELEGRAM_MAX_FIELDS = (TELEGRAM_STATE_MAX + 1 - 2) // 11
+
+
+def validate_telegram_fields(value):
+    if len(value) > TELEGRAM_MAX_FIELDS:
+        raise cv.Invalid(
+            f"At most {TELEGRAM_MAX_FIELDS} fields fit in the {TELEGRAM_STATE_MAX} characters "
+            "of a state, use sensors for the other fields"
+        )
+    return value
+
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(CONF_P1READER_ID): cv.use_id(P1Reader),
+        # Text rows of the telegram, published when they change
+        cv.Optional("equipment_id"): text_sensor.text_sensor_schema(
+            icon="mdi:identifier",
+            entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+        ),
+        cv.Optional("timestamp"): text_sensor.text_sensor_schema(
+            icon="mdi:clock-outline",
+        ),
+        cv.Optional("tariff_indicator"): text_sensor.text_sensor_schema(
+            icon="mdi:swap-horizontal",
+        ),
+        # All fields in one JSON array per telegram, in the order of fields
+        cv.Optional("telegram"): text_sensor.text_sensor_schema().extend(
+            {
+                cv.Required(CONF_FIELDS): cv.All(
+                    cv.ensure_list(cv.one_of(*TELEGRAM_FIELDS, lower=True)),
+                    cv.Length(min=1),
+                    validate_telegram_fields,
+                ),
+            }
+        ),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
@@ -23,3 +100,7 @@ async def to_code(config):
         if id and id.type == text_sensor.TextSensor:
             var = await text_sensor.new_text_sensor(conf)
             cg.add(getattr(hub, f"set_{key}")(var))
+
+    if "telegram" in config:
+        for field in config["telegram"][CONF_FIELDS]:
+            cg.add(hub.add_telegram_field(getattr(P1Field, f"FIELD_{field.upper()}")))
@@ -0,0 +1,124 @@
+//-------------------------------------------------------------------------------------
+// ESPHome P1 Electricity Meter custom sensor
+// Copyright 2020 Pär Svanström
+//
+// MIT License
+//-------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "fixed_point.h"
+#include <cstdio>
+#include <new>
+
+namespace esphome
+{
+    namespace p1_reader
+    {
+        const uint8_t TRACE_TELEGRAM_START = 1;
+        const uint8_t TRACE_ROW = 2;
+        const uint8_t TRACE_CRC_OK = 3;
+        const uint8_t TRACE_CRC_FAIL = 4;
+        const uint8_t TRACE_OVERFLOW = 5;
+        const uint8_t TRACE_FRAME_DROPPED = 6;
+        const uint8_t TRACE_PUBLISH = 7;
+
+        // Row values are kept as parsed, raw * 10^scale, so the dump shows the meter's digits.
+        // The CRC and publish events keep the CRC in raw.
+        struct TraceEntry
+        {
+            int64_t raw;
+            uint32_t timeMs;
+            uint32_t obisKey;
+            int8_t scale;
+            uint8_t event;
+        };
+
+        // Fixed size ring of binary trace entries, cheap enough to record every row.
+        // Entries are only formatted when the trace is dumped.
+        class TraceBuffer
+        {
+        public:
+            // Size is rounded down to a power of two, 0 disables tracing
+            bool allocate(uint16_t size)
+            {
+                if (size == 0)
+                    return true;
+
+                uint16_t capacity = 1;
+                while (capacity * 2 <= size && capacity < 0x8000)
+                    capacity *= 2;
+
+                _entries = new (std::nothrow) TraceEntry[capacity];
+                if (_entries == nullptr)
+                    return false;
+
+                _mask = capacity - 1;
+                return true;
+            }
+
+            uint16_t capacity() const { return _entries == nullptr ? 0 : _mask + 1; }
+
+            void record(uint8_t event, uint32_t obisKey = 0, int64_t raw = 0, int8_t scale = 0)
+            {
+                if (_entries == nullptr)
+                    return;
+
+                TraceEntry &entry = _entries[_head & _mask];
+                entry.raw = raw;
+                entry.timeMs = millis();
+                entry.obisKey = obisKey;
+                entry.scale = scale;
+                entry.event = event;
+                _head++;
+            }
+
+            void dump() const
+            {
+                if (_entries == nullptr)
+                {
+                    ESP_LOGI("trace", "Tracing is disabled, set trace_size to enable it");
+                    return;
+                }
+
+                uint32_t count = _head > _mask ? _mask + 1 : _head;
+                ESP_LOGI("trace", "Last %u of %u trace entries:", count, _head);
+                for (uint32_t i = _head - count; i != _head; i++)
+                {
+                    const TraceEntry &entry = _entries[i & _mask];
+                    char value[32] = "";
+                    if (entry.event == TRACE_ROW)
+                        formatFixed(value, entry.raw, entry.scale);
+                    else if (entry.event == TRACE_CRC_OK || entry.event == TRACE_CRC_FAIL || entry.event == TRACE_PUBLISH)
+                        snprintf(value, sizeof(value), "%04X", (unsigned)entry.raw);
+                    ESP_LOGI("trace", "%10u %-14s %u-%u:%u.%u.%u %s", (unsigned)entry.timeMs, eventName(entry.event),
+                             (unsigned)(entry.obisKey >> 28), (unsigned)((entry.obisKey >> 24) & 0x0f),
+                             (unsigned)((entry.obisKey >> 16) & 0xff), (unsigned)((entry.obisKey >> 8) & 0xff),
+                             (unsigned)(entry.obisKey & 0xff), value);
+                }
+            }
+
+            static const char* eventName(uint8_t event)
+            {
+                switch (event)
+                {
+                    case TRACE_TELEGRAM_START: return "telegram_start";
+                    case TRACE_ROW: return "row";
+                    case TRACE_CRC_OK: return "crc_ok";
+                    case TRACE_CRC_FAIL: return "crc_fail";
+                    case TRACE_OVERFLOW: return "overflow";
+                    case TRACE_FRAME_DROPPED: return "frame_dropped";
+                    case TRACE_PUBLISH: return "publish";
+                    default: return "?";
+                }
+            }
+
+        private:
+            TraceEntry* _entries{nullptr};
+            uint16_t _mask{0};
+            uint32_t _head{0};
+        };
+    } // namespace p1_reader
+} // namespace esphome
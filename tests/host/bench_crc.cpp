@@ -0,0 +1,82 @@
+// CRC throughput on the host: the XMODEM byte update as the ASCII parser calls it and the X-25
+// buffer CRC over HDLC sized frames, each against a bitwise loop. bench_crc_esp8266 runs the
+// same on the ESP8266 nibble tables.
+//
+//   make -C tests/host bench [BENCH_CRC_BYTES=n]
+#include "host_test.h"
+
+#include <chrono>
+
+#ifndef BENCH_CRC_BYTES
+#define BENCH_CRC_BYTES (64 << 20)
+#endif
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    // The largest frame the default HDLC buffer holds
+    const size_t FRAME_BYTES = 4096;
+
+    uint16_t xmodemBitwise(uint16_t crc, uint8_t b)
+    {
+        crc ^= (uint16_t)(b << 8);
+        for (int k = 0; k < 8; k++)
+            crc = (crc & 0x8000) != 0 ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        return crc;
+    }
+
+    uint16_t x25Bitwise(const uint8_t* data, size_t len, uint16_t crc)
+    {
+        crc = ~crc;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            for (int k = 0; k < 8; k++)
+                crc = (crc & 1) != 0 ? (uint16_t)((crc >> 1) ^ 0x8408) : (uint16_t)(crc >> 1);
+        }
+        return ~crc;
+    }
+
+    template <typename F>
+    void bench(const char* name, F crcOfFrame, const std::vector<uint8_t>& frame)
+    {
+        // Every result feeds the next so the calls can't be dropped or overlapped
+        uint16_t crc = 0;
+        size_t frames = BENCH_CRC_BYTES / frame.size();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < frames; i++)
+            crc = crcOfFrame(frame.data(), frame.size(), crc);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double bytes = (double)frames * frame.size();
+        printf("%-24s %8.3f ns/B %9.1f MB/s  (crc %04x)\n", name, seconds * 1e9 / bytes, bytes / seconds / 1e6, crc);
+    }
+} // namespace
+
+int main()
+{
+    std::vector<uint8_t> frame(FRAME_BYTES);
+    for (size_t i = 0; i < frame.size(); i++)
+        frame[i] = (uint8_t)(i * 131 + 7);
+
+#ifdef USE_ESP8266
+    printf("ESP8266 nibble tables\n");
+#else
+    printf("Byte tables, X-25 slicing-by-4\n");
+#endif
+    bench("xmodem update", [](const uint8_t* data, size_t len, uint16_t crc) {
+        for (size_t i = 0; i < len; i++)
+            crc = crc16XmodemUpdate(crc, data[i]);
+        return crc;
+    }, frame);
+    bench("xmodem bitwise", [](const uint8_t* data, size_t len, uint16_t crc) {
+        for (size_t i = 0; i < len; i++)
+            crc = xmodemBitwise(crc, data[i]);
+        return crc;
+    }, frame);
+    bench("x25 buffer", [](const uint8_t* data, size_t len, uint16_t crc) { return crc16X25(data, len, crc); }, frame);
+    bench("x25 bitwise", x25Bitwise, frame);
+    return 0;
+}
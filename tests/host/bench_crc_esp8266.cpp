@@ -0,0 +1,2 @@
+// bench_crc on the ESP8266 nibble tables, the Makefile builds this with USE_ESP8266
+#include "bench_crc.cpp"
@@ -0,0 +1,146 @@
+// Decode throughput of the reader on the host: every corpus is fed through the host uart
+// and read with update() like on a device, reports ns per telegram, bytes per second and
+// the heap allocations made while reading.
+//
+//   make -C tests/host bench [BENCH_TELEGRAMS=n]
+#include "host_test.h"
+
+#include <chrono>
+#include <new>
+
+#ifndef BENCH_TELEGRAMS
+#define BENCH_TELEGRAMS 5000
+#endif
+
+using namespace esphome;
+
+// Every allocation of the program is counted, new and delete go to malloc and free
+namespace
+{
+    uint64_t allocations = 0;
+}
+
+#ifdef __GLIBC__
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+
+    void* malloc(size_t size)
+    {
+        allocations++;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        allocations++;
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        allocations++;
+        return __libc_realloc(ptr, size);
+    }
+}
+#endif
+
+void* operator new(size_t size)
+{
+#ifndef __GLIBC__
+    allocations++;
+#endif
+    void* ptr = malloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+#ifndef __GLIBC__
+    allocations++;
+#endif
+    return malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace
+{
+    struct Corpus
+    {
+        const char* file;
+        const char* protocol;
+    };
+
+    const Corpus CORPORA[] = {
+        {"dsmr50.txt", "ascii"},
+        {"ell5.txt", "ascii"},
+        {"aidon.hex", "hdlc"},
+        {"aidon_segmented.hex", "hdlc"},
+        {"kamstrup.hex", "hdlc"},
+        {"t211.txt", "ascii"},
+        {"kaifa.hex", "hdlc"},
+    };
+
+    void bench(const Corpus& corpus)
+    {
+        std::string telegram = host::readCorpus(corpus.file);
+
+        host::HostReader reader(corpus.protocol);
+        reader.setup();
+        for (int i = 0; i < BENCH_TELEGRAMS; i++)
+            reader.uart.feed(telegram);
+
+        // The device clock only moves between calls, so the reader's own time budget
+        // never cuts a call short and every run does the same work
+        uint64_t clockUs = 0;
+        host::holdClock(clockUs);
+
+        // Allocations are counted from the end of the first telegram, the host scheduler 
+        // allocates its entry for the deferred read once
+        uint64_t allocationsBefore = 0;
+        bool counting = false;
+        auto start = std::chrono::steady_clock::now();
+        while (reader.uart.pending() > 0)
+        {
+            reader.update();
+            host::advanceClock(reader.get_update_interval() * 1000ULL);
+            if (!counting && reader.diagnostics().telegrams > 0)
+            {
+                counting = true;
+                allocationsBefore = allocations;
+            }
+        }
+        reader.drain();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t readAllocations = counting ? allocations - allocationsBefore : 0;
+        host::useRealClock();
+
+        uint32_t telegrams = reader.diagnostics().telegrams;
+        uint64_t bytes = (uint64_t)telegram.size() * BENCH_TELEGRAMS;
+        printf("%-20s %5s %6u telegrams %6zu B/telegram %9.0f ns/telegram %8.2f MB/s %6.2f allocations/telegram\n",
+            corpus.file, corpus.protocol, telegrams, telegram.size(),
+            seconds * 1e9 / (telegrams > 0 ? telegrams : 1), bytes / seconds / 1e6, 
+            (double)readAllocations / (telegrams > 1 ? telegrams - 1 : 1));
+        CHECK(telegrams == BENCH_TELEGRAMS);
+        // Buffers are made in setup(), reading telegrams doesn't allocate
+        CHECK(readAllocations == 0);
+    }
+} // namespace
+
+int main()
+{
+    for (const Corpus& corpus : CORPORA)
+        bench(corpus);
+    return host::failures() == 0 ? 0 : 1;
+}
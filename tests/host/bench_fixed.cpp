@@ -0,0 +1,103 @@
+// Value parsing on the host: parseFixed() and the float conversion at publish against the
+// atof() to double path it replaced, over the numeric row values of the ASCII corpus. Also
+// counts the values where the published floats differ. On an ESP8266 the double path is
+// software floating point, so the host only shows the lower bound of the difference.
+//
+//   make -C tests/host bench [BENCH_FIXED_ROUNDS=n]
+#include "host_test.h"
+
+#include <chrono>
+
+#ifndef BENCH_FIXED_ROUNDS
+#define BENCH_FIXED_ROUNDS 20000
+#endif
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const char* const CORPORA[] = {"dsmr50.txt", "ell5.txt", "t211.txt"};
+
+    // The first value of every row that starts with a number, like the parser passes it on
+    std::vector<std::string> values()
+    {
+        std::vector<std::string> result;
+        for (const char* corpus : CORPORA)
+        {
+            std::string telegram = host::readCorpus(corpus);
+            size_t pos = 0;
+            while ((pos = telegram.find('\n', pos)) != std::string::npos)
+            {
+                size_t open = telegram.find('(', ++pos);
+                size_t end = telegram.find('\n', pos);
+                if (open == std::string::npos || open > end)
+                    continue;
+                size_t close = telegram.find(')', open);
+                std::string value = telegram.substr(open + 1, close - open - 1);
+                // Timestamps end with W or S, and ids are long strings of hex digits
+                if (!value.empty() && ((value[0] >= '0' && value[0] <= '9') || value[0] == '-') &&
+                    value.back() != 'W' && value.back() != 'S' && value.size() <= 16)
+                    result.push_back(value);
+            }
+        }
+        return result;
+    }
+
+    template <typename F>
+    double bench(const char* name, const std::vector<std::string>& values, F parse)
+    {
+        // Every result feeds the sum so the calls can't be dropped
+        float sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < BENCH_FIXED_ROUNDS; round++)
+        {
+            for (const std::string& value : values)
+                sum += parse(value.c_str());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double ns = seconds * 1e9 / ((double)values.size() * BENCH_FIXED_ROUNDS);
+        printf("%-28s %7.1f ns/value  (sum %g)\n", name, ns, sum);
+        return ns;
+    }
+} // namespace
+
+int main()
+{
+    std::vector<std::string> corpus = values();
+    printf("%zu values from %zu telegrams\n", corpus.size(), sizeof(CORPORA) / sizeof(CORPORA[0]));
+
+    bench("atof, float at publish", corpus, [](const char* value) { return (float)atof(value); });
+    bench("parseFixed, float at publish", corpus, [](const char* value)
+    {
+        int64_t raw;
+        int8_t scale;
+        return parseFixed(value, raw, scale) ? fixedToFloat(raw, scale) : 0.0f;
+    });
+    bench("parseFixed only", corpus, [](const char* value)
+    {
+        int64_t raw;
+        int8_t scale;
+        return parseFixed(value, raw, scale) ? (float)scale : 0.0f;
+    });
+
+    // atof() rounds the decimal value once, fixedToFloat() the integer and then the product,
+    // which may be a bit off but never more than float precision
+    int differ = 0;
+    for (const std::string& value : corpus)
+    {
+        int64_t raw = 0;
+        int8_t scale = 0;
+        CHECK(parseFixed(value.c_str(), raw, scale));
+        float fixed = fixedToFloat(raw, scale);
+        float old = (float)atof(value.c_str());
+        if (fixed != old)
+        {
+            differ++;
+            CHECK(fabs(fixed - old) <= 1e-6 * fabs(old));
+        }
+    }
+    printf("%d of %zu published values differ in the last bit\n", differ, corpus.size());
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+// Decryption cost per frame on the host: Aes128Gcm on its own for a few APDU sizes, and the
+// Kamstrup frame through the reader plain, encrypted and authenticated only.
+//
+//   make -C tests/host bench
+#include "host_test.h"
+
+#include <chrono>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+#ifdef P1READER_GCM_MBEDTLS
+namespace
+{
+    const uint8_t KEY[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    const uint8_t AUTHENTICATION_KEY[16] = { 0xd0, 0xd1, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xdb, 0xdc, 0xdd, 0xde, 0xdf };
+    const int FRAMES = 20000;
+
+    // Authenticated decryption of len bytes, the ciphertext is restored before every call
+    void benchDecrypt(size_t len)
+    {
+        uint8_t iv[12] = { 0x4d, 0x4d, 0x4d, 0x00, 0x00, 0xbc, 0x61, 0x4e, 0x01, 0x23, 0x45, 0x67 };
+        uint8_t aad[17] = { 0x30 };
+        memcpy(aad + 1, AUTHENTICATION_KEY, 16);
+
+        std::vector<uint8_t> plaintext(len);
+        for (size_t i = 0; i < len; i++)
+            plaintext[i] = (uint8_t)(i * 7);
+        std::vector<uint8_t> ciphertext(len);
+        uint8_t tag[16];
+        mbedtls_gcm_context gcm;
+        mbedtls_gcm_init(&gcm);
+        mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, KEY, 128);
+        mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, len, iv, sizeof(iv), aad, sizeof(aad), plaintext.data(),
+                                  ciphertext.data(), sizeof(tag), tag);
+        mbedtls_gcm_free(&gcm);
+
+        Aes128Gcm decryptor;
+        decryptor.setKey(KEY);
+        std::vector<uint8_t> data(len);
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; i++)
+        {
+            memcpy(data.data(), ciphertext.data(), len);
+            ok &= decryptor.decrypt(iv, sizeof(iv), aad, sizeof(aad), data.data(), len, tag, 12);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("decrypt %5zu B          %9.0f ns/frame %8.2f ns/B\n", len, seconds * 1e9 / FRAMES, seconds * 1e9 / FRAMES / len);
+        CHECK(ok);
+        CHECK(data == plaintext);
+    }
+
+    void benchReader(const char* name, const std::string& frame, bool withKeys)
+    {
+        host::HostReader reader("hdlc");
+        if (withKeys)
+        {
+            reader.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+            reader.set_authentication_key("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF");
+        }
+        reader.setup();
+        for (int i = 0; i < FRAMES; i++)
+            reader.uart.feed(frame);
+
+        uint64_t clockUs = 0;
+        host::holdClock(clockUs);
+        auto start = std::chrono::steady_clock::now();
+        reader.drain();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        host::useRealClock();
+
+        printf("reader %-18s %7.0f ns/frame %6zu B/frame\n", name, seconds * 1e9 / FRAMES, frame.size());
+        CHECK(reader.diagnostics().telegrams == (uint32_t)FRAMES);
+    }
+} // namespace
+
+int main()
+{
+    for (size_t len : { 128, 512, 1500, 4000 })
+        benchDecrypt(len);
+
+    std::string frame = host::readCorpus("kamstrup.hex");
+    benchReader("plain", frame, false);
+    benchReader("encrypted 0x30", host::securedFrame(frame, KEY, AUTHENTICATION_KEY, 0x30), true);
+    benchReader("authenticated 0x10", host::securedFrame(frame, KEY, AUTHENTICATION_KEY, 0x10), true);
+    return host::failures() == 0 ? 0 : 1;
+}
+#else
+int main()
+{
+    printf("mbedTLS not found, decryption benchmark skipped\n");
+    return 0;
+}
+#endif
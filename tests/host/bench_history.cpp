@@ -0,0 +1,80 @@
+// History compression on the host: bytes per sample for synthetic three phase readings,
+// and the time to serve the whole ring as CSV.
+//
+//   make -C tests/host bench
+#include "host_test.h"
+
+#include <chrono>
+#include <random>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const uint32_t RING_SIZE = 16384;
+
+    // Readings once a second, step is the largest change per telegram in W, 0.1 V and 0.01 A
+    struct Scenario
+    {
+        const char* name;
+        int32_t powerStep;
+        int32_t voltageStep;
+        int32_t currentStep;
+    };
+
+    const Scenario SCENARIOS[] = {
+        {"constant", 0, 0, 0},
+        {"quiet house", 20, 3, 10},
+        {"heat pump cycling", 400, 10, 170},
+        {"noisy", 3000, 50, 1300},
+    };
+
+    void bench(const Scenario& scenario)
+    {
+        HistoryRing ring;
+        ring.allocate(RING_SIZE);
+
+        std::mt19937 random(1);
+        auto step = [&random](int32_t max) { return max == 0 ? 0 : (int32_t)(random() % (2 * max + 1)) - max; };
+
+        HistorySample sample;
+        sample.timeMs = 0;
+        sample.mask = 0xff & ~(1 << HISTORY_EXPORT);
+        int32_t start[HISTORY_CHANNELS] = {1500, 0, 2300, 2310, 2295, 220, 180, 250};
+        memcpy(sample.values, start, sizeof(start));
+
+        // Enough to fill the ring several times
+        for (uint32_t i = 0; i < 20000; i++)
+        {
+            sample.timeMs += 1000 + step(20);
+            sample.values[HISTORY_IMPORT] += step(scenario.powerStep);
+            for (uint8_t c = HISTORY_VOLTAGE_L1; c <= HISTORY_VOLTAGE_L3; c++)
+                sample.values[c] += step(scenario.voltageStep);
+            for (uint8_t c = HISTORY_CURRENT_L1; c <= HISTORY_CURRENT_L3; c++)
+                sample.values[c] += step(scenario.currentStep);
+            ring.add(sample);
+        }
+
+        // The request comes right after the newest sample
+        host::holdClock((uint64_t)sample.timeMs * 1000);
+        HistoryHandler handler(&ring, "/history");
+        AsyncWebServerRequest request;
+        request.path = "/history";
+        auto begin = std::chrono::steady_clock::now();
+        handler.handleRequest(&request);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+        host::useRealClock();
+
+        printf("%-18s %5u samples %5.2f B/sample %4.1f min in %u B, CSV %6zu B in %5.0f us (%zu chunks)\n",
+               scenario.name, ring.samples(), (double)ring.bytesUsed() / ring.samples(), ring.samples() / 60.0, 
+               ring.size(), request.body.size(), us, request.chunks);
+    }
+} // namespace
+
+int main()
+{
+    for (const Scenario& scenario : SCENARIOS)
+        bench(scenario);
+    return host::failures() == 0 ? 0 : 1;
+}
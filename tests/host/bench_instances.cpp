@@ -0,0 +1,131 @@
+// Two readers in one build, a DSMR 5.0 meter at 115200 baud sending a telegram every second
+// and an Aidon HDLC meter at 2400 baud 8E1 sending a frame every 2.5 s. The meters' bytes
+// arrive on a held clock at their baud rates, 1 ms at a time, and the readers are called
+// like by the scheduler. Reports the telegrams read against those sent, the most bytes
+// waiting in each uart against its rx buffer and the host CPU time per simulated second.
+//
+//   make -C tests/host bench
+#include "host_test.h"
+
+#include <chrono>
+
+using namespace esphome;
+
+namespace
+{
+    const uint32_t SECONDS = 60;
+
+    struct Meter
+    {
+        const char* name;
+        const char* protocol;
+        std::string data;
+        uint32_t baudRate;
+        uart::UARTParityOptions parity;
+        size_t rxBufferSize;
+        uint32_t intervalMs;
+    };
+
+    struct Simulation
+    {
+        const Meter& meter;
+        host::HostReader reader;
+        uint32_t bitsPerByte;
+        uint32_t telegram{0};
+        size_t fed{0};
+        size_t peakFill{0};
+        uint32_t overflows{0};
+        uint32_t nextPollMs{0};
+        double cpuUs{0};
+
+        Simulation(const Meter& meter, const char* readMode) : meter(meter), reader(meter.protocol)
+        {
+            reader.uart.baudRate = meter.baudRate;
+            reader.uart.parity = meter.parity;
+            reader.uart.rxBufferSize = meter.rxBufferSize;
+            reader.set_read_mode(readMode);
+            bitsPerByte = 10 + (meter.parity != uart::UART_CONFIG_PARITY_NONE ? 1 : 0);
+        }
+
+        // Feeds the bytes of the telegram in progress that are on the wire by nowMs
+        void receive(uint32_t nowMs)
+        {
+            uint32_t index = nowMs / meter.intervalMs;
+            if (index >= SECONDS * 1000 / meter.intervalMs)
+                return;
+            if (index != telegram)
+            {
+                telegram = index;
+                fed = 0;
+            }
+            uint64_t bits = (uint64_t)(nowMs % meter.intervalMs) * meter.baudRate / 1000;
+            size_t bytes = std::min<size_t>(bits / bitsPerByte, meter.data.size());
+            reader.uart.feed(meter.data.data() + fed, bytes - fed);
+            fed = bytes;
+
+            // The driver drops what doesn't fit its ring
+            peakFill = std::max(peakFill, reader.uart.pending());
+            if (reader.uart.pending() > meter.rxBufferSize)
+                overflows++;
+        }
+
+        // What the scheduler runs in this millisecond: loop(), a deferred read and the poll
+        void run(uint32_t nowMs)
+        {
+            auto start = std::chrono::steady_clock::now();
+            reader.loop();
+            if (!reader.runTimeout("read") && reader.get_update_interval() != SCHEDULER_DONT_RUN &&
+                nowMs >= nextPollMs)
+            {
+                reader.update();
+                nextPollMs = nowMs + reader.get_update_interval();
+            }
+            cpuUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    void bench(const Meter& first, const Meter& second, const char* readMode)
+    {
+        Simulation simulations[] = {{first, readMode}, {second, readMode}};
+        for (Simulation& simulation : simulations)
+        {
+            host::holdClock(0);
+            simulation.reader.setup();
+        }
+
+        // A few seconds more for the last telegrams to be read
+        for (uint32_t nowMs = 0; nowMs < (SECONDS + 3) * 1000; nowMs++)
+        {
+            host::holdClock((uint64_t)nowMs * 1000);
+            for (Simulation& simulation : simulations)
+            {
+                simulation.receive(nowMs);
+                simulation.run(nowMs);
+            }
+        }
+        host::useRealClock();
+
+        for (Simulation& simulation : simulations)
+        {
+            const p1_reader::ReaderDiagnostics& diagnostics = simulation.reader.diagnostics();
+            uint32_t expected = SECONDS * 1000 / simulation.meter.intervalMs;
+            printf("%-7s %-5s %2u telegrams of %2u, %4zu/%4zu B peak uart fill, %u overflows, %u crc failures, %6.1f us CPU per s\n",
+                   readMode, simulation.meter.name, (unsigned)diagnostics.telegrams, (unsigned)expected,
+                   simulation.peakFill, simulation.meter.rxBufferSize, (unsigned)simulation.overflows,
+                   (unsigned)diagnostics.crcFailures, simulation.cpuUs / (SECONDS + 3));
+            CHECK(diagnostics.telegrams == expected);
+            CHECK(diagnostics.crcFailures == 0);
+            CHECK(simulation.overflows == 0);
+        }
+    }
+} // namespace
+
+int main()
+{
+    const Meter dsmr = {"dsmr50", "ascii", host::readCorpus("dsmr50.txt"), 115200, uart::UART_CONFIG_PARITY_NONE, 1024, 1000};
+    const Meter aidon = {"aidon", "hdlc", host::readCorpus("aidon.hex"), 2400, uart::UART_CONFIG_PARITY_EVEN, 256, 2500};
+
+    bench(dsmr, aidon, "polling");
+    bench(dsmr, aidon, "loop");
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// Worst case time and bytes per update() for adversarial uart input, with the uart always
+// holding more than the largest read. Bytes of a HDLC message decoded in a call count like
+// bytes read. The reader's byte limit is fixed and its clock held,
+// so repeated runs make the same calls. Each call is timed against the host clock and the
+// fastest of the runs is kept, which leaves out time the host spent elsewhere. From the
+// slowest bytes the limit that keeps a call within the reader's time budget is derived,
+// for the host and for a CPU that is SLOWDOWN times slower.
+//
+//   make -C tests/host bench
+#include "host_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace esphome;
+
+namespace
+{
+    const size_t INPUT_BYTES = 256 * 1024;
+    const uint32_t MAX_CALLS = 20000;
+    const int RUNS = 5;
+    const uint16_t LIMITS[] = {256, 1024, 4096};
+    const double BUDGET_US = 1000.0;
+    // Roughly an ESP8266 at 80 MHz against the host
+    const double SLOWDOWN = 50.0;
+
+    std::string repeat(const std::string& part)
+    {
+        std::string input;
+        while (input.size() < INPUT_BYTES)
+            input += part;
+        return input;
+    }
+
+    std::string noise()
+    {
+        std::mt19937 random(1);
+        std::string input(INPUT_BYTES, '\0');
+        for (char& c : input)
+            c = (char)random();
+        return input;
+    }
+
+    // A telegram of valid rows that never ends, every line is parsed
+    std::string endlessTelegram()
+    {
+        return "/ELL5\\253833635_A\r\n\r\n" + repeat("1-0:1.8.0(00006678.394*kWh)\r\n1-0:32.7.0(240.3*V)\r\n");
+    }
+
+    // Frames of the largest length the format field allows, full of rows to decode
+    std::string longestFrames()
+    {
+        std::string rows;
+        uint8_t count = 0;
+        while (rows.size() + 21 + 11 + 10 <= 0x7ff)
+        {
+            rows += std::string("\x02\x03\x09\x06\x01\x00\x20\x07\x00\xff\x12\x09\x63\x02\x02\x0f\xff\x16\x23", 19);
+            count++;
+        }
+        std::string apdu = std::string("\xe6\xe7\x00\x0f\x40\x00\x00\x00\x00\x01", 10) + (char)count + rows;
+        return repeat(host::hdlcFrame(apdu));
+    }
+
+    // Frames cut off halfway, the length field makes the reader take the next frame's start
+    // as the rest of the body
+    std::string truncatedFrames()
+    {
+        std::string frame = host::hdlcFrame(std::string("\xe6\xe7\x00\x0f\x40\x00\x00\x00\x00", 9) + std::string(2000, '\x00'));
+        return repeat(frame.substr(0, frame.size() / 2));
+    }
+
+    // Arrays and structures of the most elements the length allows, nested as deep as fits
+    std::string hugeCounts()
+    {
+        std::string items;
+        while (items.size() + 4 <= 2000)
+            items += items.size() % 8 == 0 ? std::string("\x01\x82\xff\xff", 4) : std::string("\x02\x82\xff\xff", 4);
+        return repeat(host::hdlcFrame(std::string("\xe6\xe7\x00\x0f\x40\x00\x00\x00\x00", 9) + items));
+    }
+
+    // Frames with a valid FCS around random A-XDR
+    std::string garbageItems()
+    {
+        std::mt19937 random(1);
+        std::string frames;
+        while (frames.size() < INPUT_BYTES)
+        {
+            std::string items(2000, '\0');
+            for (char& c : items)
+                c = (char)random();
+            frames += host::hdlcFrame(std::string("\xe6\xe7\x00\x0f\x40\x00\x00\x00\x00", 9) + items);
+        }
+        return frames;
+    }
+
+    // Messages of the largest buffer_size in segments, full of rows to decode
+    std::string largestMessages()
+    {
+        std::string rows;
+        uint16_t count = 0;
+        while (rows.size() + 19 + 14 <= 16384)
+        {
+            rows += std::string("\x02\x03\x09\x06\x01\x00\x20\x07\x00\xff\x12\x09\x63\x02\x02\x0f\xff\x16\x23", 19);
+            count++;
+        }
+        std::string info = std::string("\xe6\xe7\x00\x0f\x40\x00\x00\x00\x00\x00\x01\x82", 12) + (char)(count >> 8) + 
+                           (char)count + rows;
+        std::string frames;
+        for (size_t pos = 0; pos < info.size(); pos += 2000)
+            frames += host::hdlcFrame(info.substr(pos, 2000), pos + 2000 < info.size());
+        return repeat(frames);
+    }
+
+    struct Input
+    {
+        const char* name;
+        const char* protocol;
+        std::string data;
+        uint16_t bufferSize{0};
+    };
+
+    struct Call
+    {
+        double us;
+        size_t bytes;
+    };
+
+    std::vector<Call> run(const Input& input, uint16_t limit)
+    {
+        host::HostReader reader(input.protocol);
+        reader.uart.rxBufferSize = 4096;
+        if (input.bufferSize != 0)
+            reader.set_buffer_size(input.bufferSize);
+        reader.setup();
+        reader.fixSliceBytes(limit);
+        reader.uart.feed(input.data);
+
+        std::vector<Call> calls;
+        uint64_t clockUs = 0;
+        while (reader.uart.pending() > 0 && calls.size() < MAX_CALLS)
+        {
+            // Calls are a main loop interval apart on the reader's clock
+            host::holdClock(clockUs += 16000);
+            size_t pending = reader.uart.pending();
+            uint32_t decoded = reader.bytesDecoded();
+            auto start = std::chrono::steady_clock::now();
+            reader.step();
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            calls.push_back({us, pending - reader.uart.pending() + (reader.bytesDecoded() - decoded)});
+        }
+        host::useRealClock();
+        return calls;
+    }
+
+    // Returns the worst time per byte of the calls that read or decoded at least 32 bytes
+    double bench(const Input& input, uint16_t limit)
+    {
+        std::vector<Call> fastest = run(input, limit);
+        for (int i = 1; i < RUNS; i++)
+        {
+            std::vector<Call> calls = run(input, limit);
+            for (size_t c = 0; c < std::min(calls.size(), fastest.size()); c++)
+                fastest[c].us = std::min(fastest[c].us, calls[c].us);
+        }
+
+        double worstUs = 0;
+        double worstPerByte = 0;
+        size_t maxBytes = 0;
+        std::vector<double> times;
+        for (const Call& call : fastest)
+        {
+            worstUs = std::max(worstUs, call.us);
+            maxBytes = std::max(maxBytes, call.bytes);
+            if (call.bytes >= 32)
+                worstPerByte = std::max(worstPerByte, call.us / call.bytes);
+            times.push_back(call.us);
+        }
+        std::sort(times.begin(), times.end());
+
+        printf("%-17s %5s limit %4u: %6zu calls, %4zu B/call max, %7.1f us max, %7.1f us p99, %6.1f ns/B worst\n",
+               input.name, input.protocol, limit, fastest.size(), maxBytes, worstUs, times[times.size() * 99 / 100], 
+               worstPerByte * 1000.0);
+        return worstPerByte;
+    }
+} // namespace
+
+int main()
+{
+    const Input inputs[] = {
+        {"line noise", "ascii", noise()},
+        {"line noise", "hdlc", noise()},
+        {"endless line", "ascii", "/" + repeat("A")},
+        {"endless telegram", "ascii", endlessTelegram()},
+        {"flag flood", "hdlc", repeat("\x7e")},
+        {"longest frames", "hdlc", longestFrames()},
+        {"truncated frames", "hdlc", truncatedFrames()},
+        {"huge counts", "hdlc", hugeCounts()},
+        {"garbage items", "hdlc", garbageItems()},
+        {"largest messages", "hdlc", largestMessages(), 16384},
+        {"dsmr50.txt", "ascii", repeat(host::readCorpus("dsmr50.txt"))},
+        {"aidon.hex", "hdlc", repeat(host::readCorpus("aidon.hex"))},
+    };
+
+    double worstPerByte = 0;
+    for (const Input& input : inputs)
+    {
+        for (uint16_t limit : LIMITS)
+            worstPerByte = std::max(worstPerByte, bench(input, limit));
+    }
+
+    // The reader measures the time per byte on the device and sets its limit the same way
+    printf("Slowest input %.1f ns/B: a %.0f us budget allows %.0f B per call on the host, %.0f B at %.0fx slower\n",
+           worstPerByte * 1000.0, BUDGET_US, BUDGET_US / worstPerByte, BUDGET_US / worstPerByte / SLOWDOWN, SLOWDOWN);
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Shared helpers for the host tests and benchmarks, see README.md "Host tests"
+#pragma once
+
+#include "p1reader.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef CORPUS_DIR
+#define CORPUS_DIR "corpus/"
+#endif
+
+namespace esphome
+{
+    namespace host
+    {
+        // Failed checks, main() returns it so make stops at the first failing test
+        inline int& failures()
+        {
+            static int count = 0;
+            return count;
+        }
+
+        // Reads a corpus file. Telegrams (.txt) are used as they are, frames (.hex) are one
+        // frame per line as hex digits where lines starting with '#' are comments.
+        inline std::string readCorpus(const std::string& name)
+        {
+            std::ifstream file(CORPUS_DIR + name, std::ios::binary);
+            if (!file)
+            {
+                fprintf(stderr, "Can't open %s%s\n", CORPUS_DIR, name.c_str());
+                exit(2);
+            }
+            std::stringstream contents;
+            contents << file.rdbuf();
+            if (name.size() < 4 || name.compare(name.size() - 4, 4, ".hex") != 0)
+                return contents.str();
+
+            std::string bytes;
+            std::string line;
+            while (std::getline(contents, line))
+            {
+                if (line.empty() || line[0] == '#')
+                    continue;
+                for (size_t i = 0; i + 1 < line.size(); i += 2)
+                    bytes += (char)strtoul(line.substr(i, 2).c_str(), nullptr, 16);
+            }
+            return bytes;
+        }
+
+        // Completes an ASCII telegram that ends with '!' with its CRC
+        inline std::string withCrc(const std::string& telegram)
+        {
+            p1_reader::ParsedMessage message;
+            message.crc = 0;
+            for (char c : telegram)
+                message.updateCrc16(c);
+            char crc[8];
+            snprintf(crc, sizeof(crc), "%04X\r\n", message.crc);
+            return telegram + crc;
+        }
+
+        // HDLC frame around an information field: format type 3, one byte addresses, UI control
+        // and valid HCS and FCS. A segmented frame has more segments of the same message after it.
+        inline std::string hdlcFrame(const std::string& info, bool segmented = false)
+        {
+            uint16_t length = 8 + info.size() + 2;
+            std::string frame;
+            frame += (char)(0xa0 | (segmented ? 0x08 : 0) | (length >> 8));
+            frame += (char)(length & 0xff);
+            frame += "\x41\x08\x83\x13";
+            uint16_t hcs = p1_reader::crc16X25((const uint8_t*)frame.data(), frame.size());
+            frame += (char)(hcs & 0xff);
+            frame += (char)(hcs >> 8);
+            frame += info;
+            uint16_t fcs = p1_reader::crc16X25((const uint8_t*)frame.data(), frame.size());
+            frame += (char)(fcs & 0xff);
+            frame += (char)(fcs >> 8);
+            return "\x7e" + frame + "\x7e";
+        }
+
+#ifdef P1READER_GCM_MBEDTLS
+        // An HDLC frame with its APDU secured like a meter does, as general-glo-ciphering with
+        // system title 4D4D4D0000BC614E and invocation counter 01234567. Security control 0x30
+        // encrypts and authenticates, 0x20 only encrypts, 0x10 only authenticates and 0x00 does
+        // neither.
+        inline std::string securedFrame(const std::string& frame, const uint8_t* key, const uint8_t* authenticationKey,
+                                        uint8_t securityControl, bool corruptTag = false)
+        {
+            // Flag, header with HCS and LLC header before the APDU, FCS and flag after it
+            std::string apdu = frame.substr(1 + 8 + 3, frame.size() - 1 - 8 - 3 - 3);
+            const std::string systemTitle("\x4d\x4d\x4d\x00\x00\xbc\x61\x4e", 8);
+            const std::string invocationCounter("\x01\x23\x45\x67", 4);
+
+            mbedtls_gcm_context gcm;
+            mbedtls_gcm_init(&gcm);
+            mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, 128);
+            std::string iv = systemTitle + invocationCounter;
+            std::string aad = (char)securityControl + std::string((const char*)authenticationKey, 16);
+            std::string body = apdu;
+            uint8_t tag[16];
+            if (securityControl & 0x20)
+            {
+                mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, apdu.size(), (const uint8_t*)iv.data(), iv.size(),
+                                          (const uint8_t*)aad.data(), aad.size(), (const uint8_t*)apdu.data(),
+                                          (uint8_t*)&body[0], sizeof(tag), tag);
+            }
+            else
+            {
+                aad += apdu;
+                mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, 0, (const uint8_t*)iv.data(), iv.size(),
+                                          (const uint8_t*)aad.data(), aad.size(), nullptr, nullptr, sizeof(tag), tag);
+            }
+            mbedtls_gcm_free(&gcm);
+            if (corruptTag)
+                tag[0] ^= 0x01;
+
+            std::string secured = (char)securityControl + invocationCounter + body;
+            if (securityControl & 0x10)
+                secured += std::string((const char*)tag, 12);
+            std::string info = std::string("\xe6\xe7\x00\xdb\x08", 5) + systemTitle + "\x82" +
+                               (char)(secured.size() >> 8) + (char)(secured.size() & 0xff) + secured;
+            return hdlcFrame(info);
+        }
+#endif
+
+#ifdef USE_P1READER_STREAM
+        // A free port from the kernel, the stream server binds it again with SO_REUSEADDR
+        inline uint16_t freePort()
+        {
+            auto probe = socket::socket_ip(SOCK_STREAM, 0);
+            struct sockaddr_storage address;
+            socklen_t length = socket::set_sockaddr_any((struct sockaddr*)&address, sizeof(address), 0);
+            probe->bind((struct sockaddr*)&address, length);
+            return probe->localPort();
+        }
+#endif
+
+        // P1Reader with a sensor on every field and access to what the tests look at
+        class HostReader : public p1_reader::P1Reader
+        {
+        public:
+            uart::UARTComponent uart;
+            p1_reader::P1Sensor sensors[p1_reader::FIELD_COUNT];
+
+            // Buffer sizes default like in __init__.py
+            HostReader(const std::string& protocol) : P1Reader(&uart)
+            {
+                set_protocol_type(protocol);
+                set_buffer_size(protocol == "hdlc" ? 4096 : 256);
+                for (uint8_t field = 0; field < p1_reader::FIELD_COUNT; field++)
+                    _fieldSensors[field] = &sensors[field];
+            }
+
+            // Runs update() until everything fed is read and the last telegram is published
+            void drain()
+            {
+                while (uart.pending() > 0 || _publishMessage->telegramComplete || _parseHDLCState == FOUND_FRAME)
+                    update();
+            }
+
+            const p1_reader::ReaderDiagnostics& diagnostics() const { return _diagnostics; }
+            const p1_reader::ParsedMessage& published() const { return *_publishMessage; }
+            uint16_t sliceBytes() const { return _sliceBytes; }
+            uint32_t bytesDecoded() const { return _bytesDecoded; }
+            uint32_t telegramPeriodMs() const { return _periodSamples >= ADAPTIVE_MIN_SAMPLES ? _telegramPeriodMs : 0; }
+            uint32_t pollGuardMs() const { return _pollGuardMs; }
+            int pollingIntervalMs() const { return _pollingIntervalMs; }
+#ifdef USE_P1READER_STREAM
+            const p1_reader::StreamServer& stream() const { return _stream; }
+#endif
+#ifdef USE_P1READER_HISTORY
+            const p1_reader::HistoryRing& history() const { return _history; }
+#endif
+
+            // Stops the limit from adapting, for runs with a held clock
+            void fixSliceBytes(uint16_t bytes) { _sliceBytes = _sliceMinBytes = _sliceMaxBytes = bytes; }
+
+            // Like the scheduler: a deferred read when there is one, otherwise the next poll
+            void step()
+            {
+                if (!runTimeout("read"))
+                    update();
+            }
+        };
+    } // namespace host
+} // namespace esphome
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ::esphome::host::failures()++; \
+        } \
+    } while (0)
+
+// Published values are floats converted from fixed point, compare to 7 significant digits
+#define CHECK_NEAR(value, expected) CHECK(fabs((double)(value) - (double)(expected)) <= 1e-6 * (fabs((double)(expected)) + 1.0))
@@ -0,0 +1,30 @@
+#pragma once
+#include "esphome/core/component.h"
+#include <string>
+
+namespace esphome
+{
+    namespace sensor
+    {
+        class Sensor
+        {
+        public:
+            float state{0.0f};
+            uint32_t publishCount{0};
+
+            void publish_state(float value)
+            {
+                state = value;
+                publishCount++;
+            }
+
+            bool has_state() const { return publishCount > 0; }
+            float get_raw_state() const { return state; }
+            void set_name(const std::string& name) { _name = name; }
+            const char* get_name() const { return _name.c_str(); }
+
+        protected:
+            std::string _name{"sensor"};
+        };
+    } // namespace sensor
+} // namespace esphome
@@ -0,0 +1,89 @@
+#pragma once
+// BSD sockets behind the interface of esphome/components/socket
+#include <arpa/inet.h>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace esphome
+{
+    namespace socket
+    {
+        class Socket
+        {
+        public:
+            explicit Socket(int fd) : _fd(fd) {}
+            ~Socket()
+            {
+                if (_fd >= 0)
+                    ::close(_fd);
+            }
+
+            std::unique_ptr<Socket> accept(struct sockaddr* address, socklen_t* length)
+            {
+                int fd = ::accept(_fd, address, length);
+                return fd < 0 ? nullptr : std::unique_ptr<Socket>(new Socket(fd));
+            }
+
+            int bind(const struct sockaddr* address, socklen_t length) { return ::bind(_fd, address, length); }
+            int listen(int backlog) { return ::listen(_fd, backlog); }
+            ssize_t read(void* buffer, size_t length) { return ::recv(_fd, buffer, length, 0); }
+            ssize_t write(const void* buffer, size_t length) { return ::send(_fd, buffer, length, MSG_NOSIGNAL); }
+            int setsockopt(int level, int name, const void* value, socklen_t length) { return ::setsockopt(_fd, level, name, value, length); }
+
+            int close()
+            {
+                int result = ::close(_fd);
+                _fd = -1;
+                return result;
+            }
+
+            int setblocking(bool blocking)
+            {
+                int flags = fcntl(_fd, F_GETFL);
+                return fcntl(_fd, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+            }
+
+            std::string getpeername()
+            {
+                struct sockaddr_in address;
+                socklen_t length = sizeof(address);
+                ::getpeername(_fd, (struct sockaddr*)&address, &length);
+                return inet_ntoa(address.sin_addr);
+            }
+
+            // Host: the port the socket is bound to, for servers started on port 0
+            uint16_t localPort()
+            {
+                struct sockaddr_in address;
+                socklen_t length = sizeof(address);
+                ::getsockname(_fd, (struct sockaddr*)&address, &length);
+                return ntohs(address.sin_port);
+            }
+
+        protected:
+            int _fd;
+        };
+
+        inline std::unique_ptr<Socket> socket_ip(int type, int protocol)
+        {
+            int fd = ::socket(AF_INET, type, protocol);
+            return fd < 0 ? nullptr : std::unique_ptr<Socket>(new Socket(fd));
+        }
+
+        // Tests only listen on the loopback interface
+        inline socklen_t set_sockaddr_any(struct sockaddr* address, socklen_t /*length*/, uint16_t port)
+        {
+            struct sockaddr_in* in = (struct sockaddr_in*)address;
+            memset(in, 0, sizeof(*in));
+            in->sin_family = AF_INET;
+            in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            in->sin_port = htons(port);
+            return sizeof(*in);
+        }
+    } // namespace socket
+} // namespace esphome
@@ -0,0 +1,24 @@
+#pragma once
+#include "esphome/core/component.h"
+#include <string>
+
+namespace esphome
+{
+    namespace text_sensor
+    {
+        class TextSensor
+        {
+        public:
+            std::string state;
+            uint32_t publishCount{0};
+
+            void publish_state(const std::string& value)
+            {
+                state = value;
+                publishCount++;
+            }
+
+            bool has_state() const { return publishCount > 0; }
+        };
+    } // namespace text_sensor
+} // namespace esphome
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+
+namespace esphome
+{
+    struct ESPTime
+    {
+        uint8_t second;
+        uint8_t minute;
+        uint8_t hour;
+        uint8_t day_of_week;
+        uint8_t day_of_month;
+        uint16_t day_of_year;
+        uint8_t month;
+        uint16_t year;
+        bool is_dst;
+        time_t timestamp;
+
+        bool is_valid() const { return year >= 2019; }
+    };
+
+    namespace time
+    {
+        // Host clock: the system time shifted by utcOffset seconds for the local time fields
+        class RealTimeClock
+        {
+        public:
+            int32_t utcOffset{0};
+            bool valid{true};
+
+            ESPTime now()
+            {
+                ESPTime result{};
+                if (!valid)
+                    return result;
+
+                time_t utc = ::time(nullptr);
+                time_t local = utc + utcOffset;
+                struct tm fields;
+                gmtime_r(&local, &fields);
+                result.second = fields.tm_sec;
+                result.minute = fields.tm_min;
+                result.hour = fields.tm_hour;
+                result.day_of_week = fields.tm_wday + 1;
+                result.day_of_month = fields.tm_mday;
+                result.day_of_year = fields.tm_yday + 1;
+                result.month = fields.tm_mon + 1;
+                result.year = fields.tm_year + 1900;
+                result.timestamp = utc;
+                return result;
+            }
+        };
+    } // namespace time
+} // namespace esphome
@@ -0,0 +1,104 @@
+#pragma once
+#include "esphome/core/component.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace esphome
+{
+    namespace uart
+    {
+        enum UARTParityOptions
+        {
+            UART_CONFIG_PARITY_NONE,
+            UART_CONFIG_PARITY_EVEN,
+            UART_CONFIG_PARITY_ODD,
+        };
+
+        // Host uart: tests append received bytes with feed(). At most rx_buffer_size bytes are
+        // available at a time, like the driver's ring, the rest is still on the wire.
+        class UARTComponent
+        {
+        public:
+            size_t rxBufferSize{256};
+            uint32_t baudRate{115200};
+            uint8_t dataBits{8};
+            uint8_t stopBits{1};
+            UARTParityOptions parity{UART_CONFIG_PARITY_NONE};
+
+            std::string rx;
+            size_t rxPos{0};
+
+            // Time reading a byte takes on a held clock, like the work done per byte on a device
+            uint32_t readCostNs{0};
+            uint32_t readCostCarryNs{0};
+
+            void charge(size_t bytes)
+            {
+                uint64_t ns = (uint64_t)readCostNs * bytes + readCostCarryNs;
+                host::advanceClock(ns / 1000);
+                readCostCarryNs = ns % 1000;
+            }
+
+            void feed(const std::string& data) { feed(data.data(), data.size()); }
+            void feed(const char* data, size_t len)
+            {
+                // Drop what has been read so the buffer doesn't grow in long runs
+                if (rxPos > 65536)
+                {
+                    rx.erase(0, rxPos);
+                    rxPos = 0;
+                }
+                rx.append(data, len);
+            }
+
+            size_t pending() const { return rx.size() - rxPos; }
+            size_t available() const { return std::min(pending(), rxBufferSize); }
+
+            size_t get_rx_buffer_size() { return rxBufferSize; }
+            uint32_t get_baud_rate() const { return baudRate; }
+            uint8_t get_data_bits() const { return dataBits; }
+            uint8_t get_stop_bits() const { return stopBits; }
+            UARTParityOptions get_parity() const { return parity; }
+        };
+
+        class UARTDevice
+        {
+        public:
+            UARTDevice() {}
+            UARTDevice(UARTComponent* parent) : parent_(parent) {}
+
+            int available() { return (int)parent_->available(); }
+
+            bool read_byte(uint8_t* data)
+            {
+                if (parent_->available() == 0)
+                    return false;
+                *data = (uint8_t)parent_->rx[parent_->rxPos++];
+                parent_->charge(1);
+                return true;
+            }
+
+            bool peek_byte(uint8_t* data)
+            {
+                if (parent_->available() == 0)
+                    return false;
+                *data = (uint8_t)parent_->rx[parent_->rxPos];
+                return true;
+            }
+
+            bool read_array(uint8_t* data, size_t len)
+            {
+                if (parent_->available() < len)
+                    return false;
+                memcpy(data, parent_->rx.data() + parent_->rxPos, len);
+                parent_->rxPos += len;
+                parent_->charge(len);
+                return true;
+            }
+
+        protected:
+            UARTComponent* parent_{nullptr};
+        };
+    } // namespace uart
+} // namespace esphome
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace esphome
+{
+    enum WebRequestMethod
+    {
+        HTTP_GET = 1,
+        HTTP_POST = 2,
+    };
+
+    // Host: responses are collected in body, peakBuffered is the most response data held at once
+    // by the web server
+    class AsyncResponseStream
+    {
+    public:
+        std::string data;
+        void print(const char* text) { data += text; }
+    };
+
+    // Chunked response, send() asks for chunks like a connection with chunkSize bytes free
+    class AsyncWebServerResponse
+    {
+    public:
+        std::function<size_t(uint8_t*, size_t, size_t)> fill;
+    };
+
+    class AsyncWebServerRequest
+    {
+    public:
+        std::string path;
+        std::string body;
+        std::string contentType;
+        size_t peakBuffered{0};
+        size_t chunkSize{1436};
+        size_t chunks{0};
+
+        WebRequestMethod method() const { return HTTP_GET; }
+        std::string url() const { return path; }
+
+        AsyncResponseStream* beginResponseStream(const char* type)
+        {
+            contentType = type;
+            return new AsyncResponseStream();
+        }
+
+        void send(AsyncResponseStream* stream)
+        {
+            body = stream->data;
+            peakBuffered = stream->data.capacity();
+            delete stream;
+        }
+
+        AsyncWebServerResponse* beginChunkedResponse(const char* type, std::function<size_t(uint8_t*, size_t, size_t)> fill)
+        {
+            contentType = type;
+            AsyncWebServerResponse* response = new AsyncWebServerResponse();
+            response->fill = fill;
+            return response;
+        }
+
+        void send(AsyncWebServerResponse* response)
+        {
+            std::string chunk(chunkSize, '\0');
+            size_t len;
+            while ((len = response->fill((uint8_t*)&chunk[0], chunkSize, body.size())) > 0)
+            {
+                body.append(chunk, 0, len);
+                chunks++;
+            }
+            peakBuffered = chunkSize;
+            delete response;
+        }
+    };
+
+    class AsyncWebHandler
+    {
+    public:
+        virtual ~AsyncWebHandler() {}
+        virtual bool canHandle(AsyncWebServerRequest*) { return false; }
+        virtual void handleRequest(AsyncWebServerRequest*) {}
+    };
+
+    namespace web_server_base
+    {
+        class WebServerBase
+        {
+        public:
+            AsyncWebHandler* handler{nullptr};
+
+            void init() {}
+            void add_handler(AsyncWebHandler* h) { handler = h; }
+        };
+    } // namespace web_server_base
+} // namespace esphome
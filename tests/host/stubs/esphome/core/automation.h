@@ -0,0 +1,23 @@
+#pragma once
+#include "esphome/core/component.h"
+
+namespace esphome
+{
+    template<typename... Ts> class Action
+    {
+    public:
+        virtual ~Action() {}
+        virtual void play(Ts... x) = 0;
+    };
+
+    template<typename T> class Parented
+    {
+    public:
+        Parented() {}
+        Parented(T* parent) : parent_(parent) {}
+        void set_parent(T* parent) { parent_ = parent; }
+
+    protected:
+        T* parent_{nullptr};
+    };
+} // namespace esphome
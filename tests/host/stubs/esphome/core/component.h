@@ -0,0 +1,71 @@
+#pragma once
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace esphome
+{
+    const uint32_t SCHEDULER_DONT_RUN = 4294967295UL;
+
+    namespace setup_priority
+    {
+        const float DATA = 600.0f;
+        const float LATE = -100.0f;
+    } // namespace setup_priority
+
+    class Component
+    {
+    public:
+        virtual ~Component() {}
+        virtual void setup() {}
+        virtual void loop() {}
+        virtual void dump_config() {}
+        virtual float get_setup_priority() const { return 0.0f; }
+
+        bool is_failed() const { return _failed; }
+
+        // Host: pending timeouts by name, tests run them with runTimeout()
+        std::map<std::string, std::pair<uint32_t, std::function<void()>>> timeouts;
+
+        bool runTimeout(const std::string& name)
+        {
+            auto timeout = timeouts.find(name);
+            if (timeout == timeouts.end())
+                return false;
+            std::function<void()> f = std::move(timeout->second.second);
+            timeouts.erase(timeout);
+            f();
+            return true;
+        }
+
+    protected:
+        void mark_failed() { _failed = true; }
+
+        void set_interval(const std::string&, uint32_t, std::function<void()>&&) {}
+        void set_timeout(const std::string& name, uint32_t timeout, std::function<void()>&& f)
+        {
+            timeouts[name] = std::make_pair(timeout, std::move(f));
+        }
+
+        bool _failed{false};
+    };
+
+    class PollingComponent : public Component
+    {
+    public:
+        PollingComponent() {}
+        explicit PollingComponent(uint32_t updateInterval) : _updateInterval(updateInterval) {}
+
+        virtual void update() = 0;
+        virtual void set_update_interval(uint32_t updateInterval) { _updateInterval = updateInterval; }
+        virtual uint32_t get_update_interval() const { return _updateInterval; }
+        void start_poller() {}
+        void stop_poller() {}
+
+    protected:
+        uint32_t _updateInterval{0};
+    };
+} // namespace esphome
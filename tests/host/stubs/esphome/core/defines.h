@@ -0,0 +1,5 @@
+#pragma once
+// Host build: features are selected with -D flags by the Makefile
+#ifndef USE_HOST
+#define USE_HOST
+#endif
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome
+{
+    // Host clock, see host_stubs.cpp. Runs from the real clock unless a test holds it.
+    uint32_t millis();
+    uint32_t micros();
+    void delay(uint32_t ms);
+    void delayMicroseconds(uint32_t us);
+    void yield();
+
+    namespace host
+    {
+        // Hold the clock at a time, or advance a held clock. useRealClock() releases it.
+        void holdClock(uint64_t us);
+        void advanceClock(uint64_t us);
+        void useRealClock();
+    } // namespace host
+} // namespace esphome
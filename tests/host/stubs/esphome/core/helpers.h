@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace esphome
+{
+    // Same contract as esphome::parse_hex, true when count bytes were parsed
+    inline bool parse_hex(const std::string& str, uint8_t* data, size_t count)
+    {
+        if (str.size() < count * 2)
+            return false;
+        for (size_t i = 0; i < count; i++)
+        {
+            int value = 0;
+            for (size_t k = 0; k < 2; k++)
+            {
+                char c = str[i * 2 + k];
+                int nibble = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (nibble < 0)
+                    return false;
+                value = value * 16 + nibble;
+            }
+            data[i] = (uint8_t)value;
+        }
+        return true;
+    }
+} // namespace esphome
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace esphome
+{
+    namespace host
+    {
+        // 0 none, 1 error, 2 warning, 3 info, 4 config, 5 debug, 6 verbose, 7 very verbose.
+        // Set from the P1_LOG environment variable.
+        extern int logLevel;
+
+        // When set, every message of any level is also appended to it, one line each
+        extern std::string* logCapture;
+
+        void log(int level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+    } // namespace host
+} // namespace esphome
+
+#define ESP_LOGE(tag, ...) ::esphome::host::log(1, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::esphome::host::log(2, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::esphome::host::log(3, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ::esphome::host::log(4, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::esphome::host::log(5, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::esphome::host::log(6, tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ::esphome::host::log(7, tag, __VA_ARGS__)
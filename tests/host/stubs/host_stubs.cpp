@@ -0,0 +1,84 @@
+// Host implementations of the ESPHome functions used by the component
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdlib>
+
+namespace esphome
+{
+    namespace
+    {
+        const auto START = std::chrono::steady_clock::now();
+        bool held = false;
+        uint64_t heldUs = 0;
+
+        uint64_t nowUs()
+        {
+            if (held)
+                return heldUs;
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START).count();
+        }
+
+        int initialLogLevel()
+        {
+            const char* level = getenv("P1_LOG");
+            return level != nullptr ? atoi(level) : 0;
+        }
+    }
+
+    uint32_t millis() { return (uint32_t)(nowUs() / 1000); }
+    uint32_t micros() { return (uint32_t)nowUs(); }
+    void delay(uint32_t ms) { if (held) heldUs += (uint64_t)ms * 1000; }
+    void delayMicroseconds(uint32_t us) { if (held) heldUs += us; }
+    void yield() {}
+
+    namespace host
+    {
+        int logLevel = initialLogLevel();
+
+        void holdClock(uint64_t us)
+        {
+            held = true;
+            heldUs = us;
+        }
+
+        void advanceClock(uint64_t us)
+        {
+            if (held)
+                heldUs += us;
+        }
+
+        void useRealClock()
+        {
+            held = false;
+        }
+
+        std::string* logCapture = nullptr;
+
+        void log(int level, const char* tag, const char* format, ...)
+        {
+            if (logCapture != nullptr)
+            {
+                char line[256];
+                va_list args;
+                va_start(args, format);
+                vsnprintf(line, sizeof(line), format, args);
+                va_end(args);
+                *logCapture += line;
+                *logCapture += '\n';
+            }
+
+            if (level > logLevel)
+                return;
+
+            static const char LEVELS[] = "?EWICDVV";
+            printf("[%c][%s] ", LEVELS[level], tag);
+            va_list args;
+            va_start(args, format);
+            vprintf(format, args);
+            va_end(args);
+            printf("\n");
+        }
+    } // namespace host
+} // namespace esphome
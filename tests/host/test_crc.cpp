@@ -0,0 +1,85 @@
+// The table driven CRCs against bitwise references, over random buffers and the catalogue
+// check values. test_crc_esp8266 runs the same checks on the ESP8266 nibble tables.
+#include "host_test.h"
+
+#include <random>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const int BUFFERS = 2000;
+
+    // CRC-16/XMODEM one bit at a time, msb first
+    uint16_t xmodemBitwise(const uint8_t* data, size_t len)
+    {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= (uint16_t)(data[i] << 8);
+            for (int k = 0; k < 8; k++)
+                crc = (crc & 0x8000) != 0 ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        return crc;
+    }
+
+    // CRC-16/X-25 one bit at a time, lsb first
+    uint16_t x25Bitwise(const uint8_t* data, size_t len)
+    {
+        uint16_t crc = 0xffff;
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= data[i];
+            for (int k = 0; k < 8; k++)
+                crc = (crc & 1) != 0 ? (uint16_t)((crc >> 1) ^ 0x8408) : (uint16_t)(crc >> 1);
+        }
+        return (uint16_t)~crc;
+    }
+
+    uint16_t xmodem(const uint8_t* data, size_t len)
+    {
+        uint16_t crc = 0;
+        for (size_t i = 0; i < len; i++)
+            crc = crc16XmodemUpdate(crc, data[i]);
+        return crc;
+    }
+
+    void testCheckValues()
+    {
+        const uint8_t* check = (const uint8_t*)"123456789";
+        CHECK(xmodem(check, 9) == 0x31c3);
+        CHECK(crc16X25(check, 9) == 0x906e);
+        CHECK(xmodemBitwise(check, 9) == 0x31c3);
+        CHECK(x25Bitwise(check, 9) == 0x906e);
+        CHECK(crc16X25(check, 0) == 0);
+    }
+
+    // Random lengths around the slicing width and random alignment, each buffer also split in two
+    void testRandomBuffers()
+    {
+        std::mt19937 random(1);
+        std::vector<uint8_t> storage(1024 + 8);
+        for (int n = 0; n < BUFFERS; n++)
+        {
+            size_t len = n < 64 ? (size_t)n : random() % 1024;
+            uint8_t* data = storage.data() + random() % 8;
+            for (size_t i = 0; i < len; i++)
+                data[i] = (uint8_t)random();
+
+            uint16_t x25 = x25Bitwise(data, len);
+            CHECK(xmodem(data, len) == xmodemBitwise(data, len));
+            CHECK(crc16X25(data, len) == x25);
+
+            size_t split = len > 0 ? random() % (len + 1) : 0;
+            CHECK(crc16X25(data + split, len - split, crc16X25(data, split)) == x25);
+        }
+    }
+} // namespace
+
+int main()
+{
+    testCheckValues();
+    testRandomBuffers();
+    return host::failures() == 0 ? 0 : 1;
+}
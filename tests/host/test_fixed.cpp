@@ -0,0 +1,128 @@
+// parseFixed edge cases, and random values against atof
+#include "host_test.h"
+
+#include <random>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    bool parses(const char* text, int64_t expectedRaw, int8_t expectedScale)
+    {
+        int64_t raw = 0;
+        int8_t scale = 0;
+        if (!parseFixed(text, raw, scale))
+        {
+            fprintf(stderr, "parseFixed(\"%s\") failed\n", text);
+            return false;
+        }
+        if (raw != expectedRaw || scale != expectedScale)
+        {
+            fprintf(stderr, "parseFixed(\"%s\") gave %lld e%d\n", text, (long long)raw, scale);
+            return false;
+        }
+        return true;
+    }
+
+    bool fails(const char* text)
+    {
+        int64_t raw;
+        int8_t scale;
+        return !parseFixed(text, raw, scale);
+    }
+
+    void testValues()
+    {
+        CHECK(parses("00012345.678*kWh", 12345678, -3));
+        CHECK(parses("000000.000*kWh", 0, -3));
+        CHECK(parses("0", 0, 0));
+        CHECK(parses("-00.5", -5, -1));
+        CHECK(parses("+7)", 7, 0));
+        CHECK(parses("12.", 12, 0));
+        CHECK(parses(".5", 5, -1));
+        CHECK(parses("1.2.3", 12, -1));
+    }
+
+    void testNoDigits()
+    {
+        CHECK(fails(""));
+        CHECK(fails("-"));
+        CHECK(fails("+"));
+        CHECK(fails("."));
+        CHECK(fails("-.*kWh"));
+        CHECK(fails("*kWh"));
+    }
+
+    // Beyond 18 significant digits the integer part moves to the exponent, the fraction is dropped
+    void testSignificantDigits()
+    {
+        CHECK(parses("123456789012345678", 123456789012345678, 0));
+        CHECK(parses("1234567890123456789", 123456789012345678, 1));
+        CHECK(parses("0001234567890123456789.99", 123456789012345678, 1));
+        CHECK(parses("1.23456789012345678", 1234567890, -9)); // 9 decimals first
+        CHECK(parses("12345678901.2345678901", 123456789012345678, -7));
+        CHECK(parses("-999999999999999999", -999999999999999999, 0));
+        // 27 integer digits is the largest that fits with scale 9, one more overflows
+        CHECK(parses("999999999999999999000000000", 999999999999999999, 9));
+        CHECK(fails("9999999999999999990000000000"));
+        CHECK(fails("1000000000000000000000000000.5"));
+    }
+
+    // Decimals beyond 9 are dropped, not rounded
+    void testFractionDigits()
+    {
+        CHECK(parses("0.123456789", 123456789, -9));
+        CHECK(parses("0.1234567891", 123456789, -9));
+        CHECK(parses("0.0000000009", 0, -9));
+        CHECK(parses("0.00000000099", 0, -9));
+        CHECK(parses("5.0000000001", 5000000000, -9));
+    }
+
+    // Random values as meters send them, compared with atof to double precision
+    void testAgainstAtof()
+    {
+        std::mt19937_64 random(1);
+        char text[48];
+        for (int n = 0; n < 20000; n++)
+        {
+            int integerDigits = 1 + random() % 12;
+            int decimals = random() % 7;
+            int len = 0;
+            if (random() % 4 == 0)
+                text[len++] = '-';
+            for (int i = 0; i < integerDigits; i++)
+                text[len++] = '0' + random() % 10;
+            if (decimals > 0)
+            {
+                text[len++] = '.';
+                for (int i = 0; i < decimals; i++)
+                    text[len++] = '0' + random() % 10;
+            }
+            strcpy(text + len, "*kWh");
+
+            int64_t raw;
+            int8_t scale;
+            CHECK(parseFixed(text, raw, scale));
+            CHECK(scale == -decimals);
+            double expected = atof(text);
+            CHECK(fabs(raw * pow(10, scale) - expected) <= 1e-12 * fabs(expected) + 1e-9);
+            CHECK_NEAR(fixedToFloat(raw, scale), (float)expected);
+
+            // formatFixed gives back the text without the unit, minus the leading zeros
+            char formatted[32];
+            formatFixed(formatted, raw, scale);
+            CHECK(atof(formatted) == expected);
+        }
+    }
+} // namespace
+
+int main()
+{
+    testValues();
+    testNoDigits();
+    testSignificantDigits();
+    testFractionDigits();
+    testAgainstAtof();
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// AES-128-GCM known answers, and encrypted HDLC frames through the reader
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+#ifdef P1READER_GCM_MBEDTLS
+namespace
+{
+    std::string unhex(const char* hex)
+    {
+        std::string bytes;
+        for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2)
+            bytes += (char)strtoul(std::string(hex, 2).c_str(), nullptr, 16);
+        return bytes;
+    }
+
+    const uint8_t* bytes(const std::string& s) { return (const uint8_t*)s.data(); }
+
+    // DLMS UA 1000-2 (Green Book) general-glo-ciphering example: authenticated encryption
+    // with security control 0x30, the AAD is the security control and the authentication key
+    const std::string KEY = unhex("000102030405060708090A0B0C0D0E0F");
+    const std::string AUTHENTICATION_KEY = unhex("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF");
+    const std::string SYSTEM_TITLE = unhex("4D4D4D0000BC614E");
+    const std::string INVOCATION_COUNTER = unhex("01234567");
+    const std::string PLAINTEXT = unhex("C0010000080000010000FF0200");
+    const std::string CIPHERTEXT = unhex("411312FF935A47566827C467BC");
+    const std::string TAG = unhex("7D825C3BE4A77C3FCC056B6B");
+
+    void testKnownAnswer()
+    {
+        Aes128Gcm gcm;
+        CHECK(gcm.setKey(bytes(KEY)));
+
+        std::string iv = SYSTEM_TITLE + INVOCATION_COUNTER;
+        std::string aad = "\x30" + AUTHENTICATION_KEY;
+        std::string data = CIPHERTEXT;
+        CHECK(gcm.decrypt(bytes(iv), iv.size(), bytes(aad), aad.size(), (uint8_t*)&data[0], data.size(), bytes(TAG), TAG.size()));
+        CHECK(data == PLAINTEXT);
+
+        // Without a tag the data is only decrypted
+        data = CIPHERTEXT;
+        CHECK(gcm.decrypt(bytes(iv), iv.size(), nullptr, 0, (uint8_t*)&data[0], data.size(), nullptr, 0));
+        CHECK(data == PLAINTEXT);
+    }
+
+    void testBadTag()
+    {
+        Aes128Gcm gcm;
+        CHECK(gcm.setKey(bytes(KEY)));
+        std::string iv = SYSTEM_TITLE + INVOCATION_COUNTER;
+        std::string aad = "\x30" + AUTHENTICATION_KEY;
+
+        std::string tag = TAG;
+        tag[11] ^= 0x01;
+        std::string data = CIPHERTEXT;
+        CHECK(!gcm.decrypt(bytes(iv), iv.size(), bytes(aad), aad.size(), (uint8_t*)&data[0], data.size(), bytes(tag), tag.size()));
+
+        // A wrong authentication key fails the same way
+        aad[1] ^= 0x80;
+        data = CIPHERTEXT;
+        CHECK(!gcm.decrypt(bytes(iv), iv.size(), bytes(aad), aad.size(), (uint8_t*)&data[0], data.size(), bytes(TAG), TAG.size()));
+    }
+
+    std::string securedFrame(uint8_t securityControl, bool corruptTag = false)
+    {
+        return host::securedFrame(host::readCorpus("kamstrup.hex"), bytes(KEY), bytes(AUTHENTICATION_KEY),
+                                  securityControl, corruptTag);
+    }
+
+    void testReader()
+    {
+        host::HostReader reader("hdlc");
+        reader.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+        reader.set_authentication_key("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF");
+        reader.setup();
+        CHECK(!reader.is_failed());
+
+        reader.uart.feed(securedFrame(0x30));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK_NEAR(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].state, 1.727);
+
+        // A frame with a bad tag is dropped and counted apart from the CRC failures
+        reader.uart.feed(securedFrame(0x30, true));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK(reader.diagnostics().gcmFailures == 1);
+        CHECK(reader.diagnostics().crcFailures == 0);
+    }
+
+    // Authentication only is checked with a GMAC over the plaintext APDU
+    void testAuthenticationOnly()
+    {
+        host::HostReader reader("hdlc");
+        reader.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+        reader.set_authentication_key("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF");
+        reader.setup();
+
+        reader.uart.feed(securedFrame(0x10));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK_NEAR(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].state, 1.727);
+
+        reader.uart.feed(securedFrame(0x10, true));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK(reader.diagnostics().gcmFailures == 1);
+    }
+
+    // With an authentication key, frames without a tag are rejected, and 0x00 always is
+    void testUnauthenticated()
+    {
+        host::HostReader reader("hdlc");
+        reader.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+        reader.set_authentication_key("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF");
+        reader.setup();
+        reader.uart.feed(securedFrame(0x00));
+        reader.uart.feed(securedFrame(0x20));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 0);
+        CHECK(reader.diagnostics().gcmFailures == 2);
+
+        // Without the authentication key the tag can't be checked, only encrypted frames are read
+        host::HostReader decryptOnly("hdlc");
+        decryptOnly.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+        decryptOnly.setup();
+        decryptOnly.uart.feed(securedFrame(0x20));
+        decryptOnly.uart.feed(securedFrame(0x00));
+        decryptOnly.drain();
+        CHECK(decryptOnly.diagnostics().telegrams == 1);
+        CHECK(decryptOnly.diagnostics().gcmFailures == 1);
+    }
+
+    // USE_P1READER_DECRYPTION is set for the build, a reader without decryption_key has no key
+    void testReaderWithoutKey()
+    {
+        host::HostReader plain("hdlc");
+        plain.setup();
+        CHECK(!plain.is_failed());
+
+        std::string log;
+        host::logCapture = &log;
+        plain.dump_config();
+        plain.uart.feed(securedFrame(0x30));
+        plain.uart.feed(host::readCorpus("kamstrup.hex"));
+        plain.drain();
+        host::logCapture = nullptr;
+
+        CHECK(log.find("Decryption") == std::string::npos);
+        CHECK(log.find("set decryption_key") != std::string::npos);
+        CHECK(plain.diagnostics().telegrams == 1);
+        CHECK(plain.diagnostics().gcmFailures == 0);
+    }
+} // namespace
+
+int main()
+{
+    testKnownAnswer();
+    testBadTag();
+    testReader();
+    testAuthenticationOnly();
+    testUnauthenticated();
+    testReaderWithoutKey();
+    return host::failures() == 0 ? 0 : 1;
+}
+#else
+int main()
+{
+    printf("mbedTLS not found, decryption tests skipped\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,213 @@
+// HDLC notifications: units of rows without a scaler, 6 byte strings as values, frames with an item
+// that can't be decoded, messages too large to decode in one call and messages whose last segment was lost
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    // A data-notification without date-time around one flat structure of OBIS code and value pairs
+    std::string notification(const std::string& rows, uint8_t count)
+    {
+        return std::string("\xe6\xe7\x00\x0f\x00\x00\x00\x01\x00\x02", 10) + (char)count + rows;
+    }
+
+    std::string obis(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+    {
+        return std::string("\x09\x06", 2) + (char)a + (char)b + (char)c + (char)d + (char)e + '\xff';
+    }
+
+    std::string doubleLongUnsigned(uint32_t value)
+    {
+        return std::string("\x06", 1) + (char)(value >> 24) + (char)(value >> 16) + (char)(value >> 8) + (char)value;
+    }
+
+    std::string longUnsigned(uint16_t value)
+    {
+        return std::string("\x12", 1) + (char)(value >> 8) + (char)value;
+    }
+
+    // Without scaler/unit only electricity power and energy are taken as W and Wh
+    void testUnitsWithoutScaler()
+    {
+        host::HostReader reader("hdlc");
+        P1Sensor gas;
+        P1Sensor water;
+        reader.add_obis_sensor(obisKey(0, 1, 24, 2, 1), &gas);
+        reader.add_obis_sensor(obisKey(8, 0, 1, 0, 0), &water);
+        reader.setup();
+
+        reader.uart.feed(host::hdlcFrame(notification(
+            obis(1, 0, 1, 7, 0) + doubleLongUnsigned(1735) +
+            obis(1, 0, 3, 8, 0) + doubleLongUnsigned(2198) +
+            obis(1, 0, 32, 7, 0) + longUnsigned(240) +
+            obis(0, 1, 24, 2, 1) + doubleLongUnsigned(12345) +
+            obis(8, 0, 1, 0, 0) + doubleLongUnsigned(321), 10)));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK_NEAR(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].state, 1.735);
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_REACTIVE_IMPORT].state, 2.198);
+        CHECK_NEAR(reader.sensors[FIELD_VOLTAGE_L1].state, 240);
+        CHECK_NEAR(gas.state, 12345);
+        CHECK_NEAR(water.state, 321);
+    }
+
+    // A 6 byte string that follows a code is its value, in a structure per row and in a flat one
+    void testSixByteValue()
+    {
+        std::string id = std::string("\x09\x06", 2) + "A1B2C3";
+        std::string rows[] = {
+            notification(std::string("\x02\x02", 2) + obis(0, 0, 96, 1, 0) + id +
+                         std::string("\x02\x02", 2) + obis(1, 0, 1, 7, 0) + doubleLongUnsigned(1735), 2),
+            notification(obis(0, 0, 96, 1, 0) + id + obis(1, 0, 1, 7, 0) + doubleLongUnsigned(1735), 4),
+        };
+
+        for (const std::string& info : rows)
+        {
+            host::HostReader reader("hdlc");
+            text_sensor::TextSensor equipmentId;
+            reader.set_equipment_id(&equipmentId);
+            reader.setup();
+            reader.uart.feed(host::hdlcFrame(info));
+            reader.drain();
+
+            CHECK(reader.diagnostics().telegrams == 1);
+            CHECK(equipmentId.state == "A1B2C3");
+            CHECK_NEAR(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].state, 1.735);
+        }
+    }
+
+    // An unknown tag or an item running past the frame drops the frame, rows before it included
+    void testBadItem()
+    {
+        const std::string bad[] = {
+            std::string("\xff\x00", 2),
+            std::string("\x09\x10\x01\x02", 4),
+            std::string("\x06\x00\x01", 3),
+        };
+
+        for (const std::string& item : bad)
+        {
+            host::HostReader reader("hdlc");
+            reader.setup();
+            reader.uart.feed(host::hdlcFrame(notification(
+                obis(1, 0, 1, 7, 0) + doubleLongUnsigned(1735) + obis(1, 0, 32, 7, 0) + item, 4)));
+            reader.drain();
+
+            CHECK(reader.diagnostics().telegrams == 0);
+            CHECK(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].publishCount == 0);
+
+            // The next good frame is read as usual
+            reader.uart.feed(host::hdlcFrame(notification(obis(1, 0, 1, 7, 0) + doubleLongUnsigned(500), 2)));
+            reader.drain();
+            CHECK(reader.diagnostics().telegrams == 1);
+            CHECK_NEAR(reader.sensors[FIELD_MOMENTARY_ACTIVE_IMPORT].state, 0.5);
+        }
+    }
+    std::string scalerUnit(int8_t scaler, uint8_t unit)
+    {
+        return std::string("\x02\x02\x0f", 3) + (char)scaler + '\x16' + (char)unit;
+    }
+
+    // Segments of at most 1000 bytes, the largest message buffer_size allows
+    std::string segmented(const std::string& info)
+    {
+        std::string frames;
+        for (size_t pos = 0; pos < info.size(); pos += 1000)
+            frames += host::hdlcFrame(info.substr(pos, 1000), pos + 1000 < info.size());
+        return frames;
+    }
+
+    // A 16 KB message is decoded in calls of the byte limit, rows split across the calls 
+    // included, and a bad item at its end still drops all of it
+    void testLargeMessage()
+    {
+        std::string rows;
+        int count = 0;
+        while (rows.size() < 16000)
+        {
+            rows += obis(1, 0, 32, 7, 0) + longUnsigned(2300 + count) + scalerUnit(-1, 35);
+            count++;
+        }
+
+        for (bool bad : {false, true})
+        {
+            // More than 127 items, the count takes a length byte of its own
+            uint16_t items = count + (bad ? 1 : 0);
+            std::string info = std::string("\xe6\xe7\x00\x0f\x00\x00\x00\x01\x00\x02\x82", 11) + (char)(items >> 8) + 
+                               (char)items + rows + (bad ? std::string("\xff\x00", 2) : std::string());
+            CHECK(info.size() <= 16384);
+
+            host::HostReader reader("hdlc");
+            reader.set_buffer_size(16384);
+            reader.setup();
+            reader.fixSliceBytes(256);
+            reader.uart.rxBufferSize = 16384;
+            reader.uart.feed(segmented(info));
+
+            // Reading and decoding take about as many calls each
+            int calls = 0;
+            do
+            {
+                reader.step();
+                calls++;
+            } while (reader.timeouts.count("read") == 1 && calls < 1000);
+            reader.drain();
+
+            CHECK(calls >= (int)(2 * info.size() / 256));
+            CHECK(reader.diagnostics().telegrams == (bad ? 0u : 1u));
+            if (bad)
+                CHECK(reader.sensors[FIELD_VOLTAGE_L1].publishCount == 0);
+            else
+                CHECK_NEAR(reader.sensors[FIELD_VOLTAGE_L1].state, (2300 + count - 1) / 10.0);
+        }
+    }
+
+    // The segments before a lost final segment are dropped when the next message starts, either
+    // with an LLC header or, for meters without one, after a gap in the segments
+    void testLostSegment()
+    {
+        std::string rows = obis(1, 0, 1, 7, 0) + doubleLongUnsigned(1735) + obis(1, 0, 32, 7, 0) + longUnsigned(231);
+        for (bool llc : {true, false})
+        {
+            std::string info = notification(rows, 4);
+            if (!llc)
+                info = info.substr(3);
+
+            host::HostReader reader("hdlc");
+            reader.setup();
+            host::holdClock(1000000);
+            for (int i = 0; i < 4; i++)
+            {
+                reader.uart.feed(host::hdlcFrame(info));
+                reader.drain();
+                host::advanceClock(1000000);
+            }
+            CHECK(reader.diagnostics().telegrams == 4);
+
+            // The first half of a message, then the whole next one a telegram later
+            reader.uart.feed(host::hdlcFrame(info.substr(0, 20), true));
+            reader.drain();
+            host::advanceClock(1000000);
+            reader.uart.feed(host::hdlcFrame(info.substr(0, 20), true) + host::hdlcFrame(info.substr(20)));
+            reader.drain();
+            host::useRealClock();
+
+            CHECK(reader.diagnostics().messagesIncomplete == 1);
+            CHECK(reader.diagnostics().telegrams == 5);
+            CHECK_NEAR(reader.sensors[FIELD_VOLTAGE_L1].state, 231);
+        }
+    }
+} // namespace
+
+int main()
+{
+    testUnitsWithoutScaler();
+    testSixByteValue();
+    testBadItem();
+    testLargeMessage();
+    testLostSegment();
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// History ring cursor and the chunked CSV response
+#include "host_test.h"
+
+#include <random>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    HistorySample makeSample(uint32_t timeMs, int32_t import)
+    {
+        HistorySample sample;
+        sample.timeMs = timeMs;
+        sample.mask = (1 << HISTORY_IMPORT) | (1 << HISTORY_VOLTAGE_L1) | (1 << HISTORY_CURRENT_L1);
+        for (int32_t& value : sample.values)
+            value = 0;
+        sample.values[HISTORY_IMPORT] = import;
+        sample.values[HISTORY_VOLTAGE_L1] = 2300 + import % 17;
+        sample.values[HISTORY_CURRENT_L1] = -(import % 1000);
+        return sample;
+    }
+
+    void testCursor()
+    {
+        HistoryRing ring;
+        CHECK(ring.allocate(4 * HistoryRing::BLOCK_SIZE));
+
+        std::vector<HistorySample> added;
+        std::mt19937 random(1);
+        for (uint32_t i = 0; i < 60; i++)
+        {
+            added.push_back(makeSample(1000 * i, 1500 + (int32_t)(random() % 4000)));
+            ring.add(added.back());
+        }
+
+        HistoryCursor cursor;
+        HistorySample sample;
+        size_t count = 0;
+        while (ring.next(cursor, sample))
+        {
+            const HistorySample& expected = added[added.size() - ring.samples() + count];
+            CHECK(sample.timeMs == expected.timeMs);
+            CHECK(sample.mask == expected.mask);
+            CHECK(memcmp(sample.values, expected.values, sizeof(sample.values)) == 0);
+            count++;
+        }
+        CHECK(count == ring.samples());
+
+        // Samples added after the end are picked up by the same cursor
+        ring.add(makeSample(60000, 1234));
+        CHECK(ring.next(cursor, sample));
+        CHECK(sample.timeMs == 60000);
+        CHECK(!ring.next(cursor, sample));
+
+        // A cursor in a block that is dropped continues with the oldest sample left
+        HistoryCursor old;
+        CHECK(ring.next(old, sample));
+        uint32_t oldest = sample.timeMs;
+        for (uint32_t i = 61; i < 400; i++)
+            ring.add(makeSample(1000 * i, 1500 + (int32_t)(random() % 4000)));
+        CHECK(ring.next(old, sample));
+        CHECK(sample.timeMs > oldest);
+        uint32_t previous = sample.timeMs;
+        count = 1;
+        while (ring.next(old, sample))
+        {
+            CHECK(sample.timeMs == previous + 1000);
+            previous = sample.timeMs;
+            count++;
+        }
+        CHECK(count == ring.samples());
+        CHECK(previous == 399000);
+    }
+
+    std::string request(const HistoryRing& ring, size_t chunkSize, size_t* peak = nullptr)
+    {
+        HistoryHandler handler(&ring, "/history");
+        AsyncWebServerRequest request;
+        request.path = "/history";
+        request.chunkSize = chunkSize;
+        CHECK(handler.canHandle(&request));
+        handler.handleRequest(&request);
+        CHECK(request.contentType == "text/csv");
+        if (peak != nullptr)
+            *peak = request.peakBuffered;
+        return request.body;
+    }
+
+    void testCsv()
+    {
+        HistoryRing ring;
+        CHECK(ring.allocate(16384));
+        host::holdClock(0);
+        for (uint32_t i = 0; i < 2000; i++)
+            ring.add(makeSample(1000 * i, 1500 + (int32_t)(i * 37 % 4000)));
+        host::holdClock(1999500ULL * 1000);
+
+        size_t peak = 0;
+        std::string body = request(ring, 1436, &peak);
+        CHECK(peak <= 1436);
+        CHECK(body.size() > 16384);
+
+        // Chunks that split lines anywhere give the same response
+        CHECK(request(ring, 7) == body);
+
+        size_t lines = 0;
+        for (char c : body)
+            lines += (c == '\n');
+        CHECK(lines == ring.samples() + 1);
+        CHECK(body.compare(0, 7, "age_ms,") == 0);
+
+        // The newest sample is 500 ms old
+        std::string last = body.substr(body.rfind('\n', body.size() - 2) + 1);
+        HistorySample newest = makeSample(1999000, 1500 + (int32_t)(1999 * 37 % 4000));
+        char expected[128];
+        snprintf(expected, sizeof(expected), "500,%d,,%d.%d,,,-%d.%02d,,\n", (int)newest.values[HISTORY_IMPORT],
+                 (int)newest.values[HISTORY_VOLTAGE_L1] / 10, (int)newest.values[HISTORY_VOLTAGE_L1] % 10,
+                 (int)-newest.values[HISTORY_CURRENT_L1] / 100, (int)-newest.values[HISTORY_CURRENT_L1] % 100);
+        CHECK(last == expected);
+
+        // Samples after the request started are left out
+        ring.add(makeSample(2000000, 100));
+        std::string later = request(ring, 1436);
+        size_t laterLines = 0;
+        for (char c : later)
+            laterLines += (c == '\n');
+        CHECK(laterLines == ring.samples());
+        host::useRealClock();
+    }
+
+    class HistoryReader : public host::HostReader
+    {
+    public:
+        HistoryReader() : HostReader("ascii") {}
+        const HistoryRing& history() const { return _history; }
+    };
+
+    // USE_P1READER_HISTORY is set for the build, a reader without history: has none
+    void testTwoReaders()
+    {
+        web_server_base::WebServerBase server;
+        HistoryReader withHistory;
+        HistoryReader without;
+        withHistory.set_history(&server, 16384, "/p1reader/a/history");
+        withHistory.setup();
+        without.setup();
+
+        CHECK(withHistory.history().enabled());
+        CHECK(server.handler != nullptr);
+        CHECK(!without.history().enabled());
+
+        std::string telegram = host::readCorpus("dsmr50.txt");
+        withHistory.uart.feed(telegram);
+        without.uart.feed(telegram);
+        withHistory.drain();
+        without.drain();
+        CHECK(withHistory.diagnostics().telegrams == 1);
+        CHECK(without.diagnostics().telegrams == 1);
+        CHECK(withHistory.history().samples() == 1);
+        CHECK(without.history().samples() == 0);
+
+        HistoryRing ring;
+        CHECK(!ring.allocate(0));
+        CHECK(!ring.enabled());
+    }
+} // namespace
+
+int main()
+{
+    testCursor();
+    testCsv();
+    testTwoReaders();
+    return host::failures() == 0 ? 0 : 1;
+}
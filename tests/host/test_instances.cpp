@@ -0,0 +1,155 @@
+// Several readers in one build with every feature compiled in, like a main meter with history,
+// stream and OBIS sensors next to a plain sub-meter. Their data is fed interleaved and each
+// must decode exactly what a reader on its own does.
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const int TELEGRAMS = 3;
+
+    // Sensor states of a reader that had the data to itself
+    std::vector<float> reference(const char* protocol, const std::string& data)
+    {
+        host::HostReader reader(protocol);
+        reader.setup();
+        for (int i = 0; i < TELEGRAMS; i++)
+        {
+            reader.uart.feed(data);
+            reader.drain();
+        }
+        std::vector<float> states;
+        for (const P1Sensor& sensor : reader.sensors)
+            states.push_back(sensor.publishCount > 0 ? sensor.state : -1.0f);
+        return states;
+    }
+
+    bool sameStates(const host::HostReader& reader, const std::vector<float>& expected)
+    {
+        for (uint8_t field = 0; field < FIELD_COUNT; field++)
+        {
+            float state = reader.sensors[field].publishCount > 0 ? reader.sensors[field].state : -1.0f;
+            if (state != expected[field])
+            {
+                fprintf(stderr, "field %u: %f, alone %f\n", field, state, expected[field]);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string dumpConfig(host::HostReader& reader)
+    {
+        std::string log;
+        host::logCapture = &log;
+        reader.dump_config();
+        host::logCapture = nullptr;
+        return log;
+    }
+
+    void testInterleaved()
+    {
+        std::string telegram = host::readCorpus("dsmr50.txt");
+        std::string frame = host::readCorpus("aidon_segmented.hex");
+
+        web_server_base::WebServerBase server;
+        host::HostReader main("ascii");
+        text_sensor::TextSensor telegramSensor;
+        P1Sensor voltage;
+        main.set_history(&server, 16384, "/p1reader/main/history");
+        main.set_stream(host::freePort(), 2048);
+        main.set_telegram(&telegramSensor);
+        main.add_telegram_field(FIELD_VOLTAGE_L1);
+        main.add_obis_sensor(obisKey(1, 0, 52, 7, 0), &voltage);
+        main.set_trace_size(64);
+
+        host::HostReader sub("hdlc");
+        main.setup();
+        sub.setup();
+        CHECK(!main.is_failed());
+        CHECK(!sub.is_failed());
+
+        // Both uarts get data at the same time, the readers are called in turns like by the scheduler
+        for (int i = 0; i < TELEGRAMS; i++)
+        {
+            size_t mainPos = 0;
+            size_t subPos = 0;
+            while (mainPos < telegram.size() || subPos < frame.size())
+            {
+                size_t mainChunk = std::min<size_t>(97, telegram.size() - mainPos);
+                size_t subChunk = std::min<size_t>(31, frame.size() - subPos);
+                main.uart.feed(telegram.data() + mainPos, mainChunk);
+                sub.uart.feed(frame.data() + subPos, subChunk);
+                mainPos += mainChunk;
+                subPos += subChunk;
+                main.step();
+                sub.step();
+            }
+            main.drain();
+            sub.drain();
+        }
+
+        CHECK(main.diagnostics().telegrams == TELEGRAMS);
+        CHECK(sub.diagnostics().telegrams == TELEGRAMS);
+        CHECK(main.diagnostics().crcFailures == 0);
+        CHECK(sub.diagnostics().crcFailures == 0);
+        CHECK(sameStates(main, reference("ascii", telegram)));
+        CHECK(sameStates(sub, reference("hdlc", frame)));
+        CHECK_NEAR(voltage.state, 220.2);
+        CHECK(telegramSensor.publishCount == TELEGRAMS);
+
+        // Features only where they are configured
+        CHECK(main.history().samples() == TELEGRAMS);
+        CHECK(!sub.history().enabled());
+        CHECK(main.stream().enabled());
+        CHECK(!sub.stream().enabled());
+
+        std::string subConfig = dumpConfig(sub);
+        CHECK(subConfig.find("History") == std::string::npos);
+        CHECK(subConfig.find("Stream") == std::string::npos);
+        CHECK(subConfig.find("Decryption") == std::string::npos);
+        CHECK(dumpConfig(main).find("History") != std::string::npos);
+    }
+
+#ifdef P1READER_GCM_MBEDTLS
+    // Two HDLC readers with different keys, each only reads its own meter
+    void testKeys()
+    {
+        const uint8_t keyA[16] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+        const uint8_t keyB[16] = { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f };
+        std::string frame = host::readCorpus("kamstrup.hex");
+
+        host::HostReader a("hdlc");
+        host::HostReader b("hdlc");
+        a.set_decryption_key("000102030405060708090A0B0C0D0E0F");
+        a.set_authentication_key("101112131415161718191A1B1C1D1E1F");
+        b.set_decryption_key("101112131415161718191A1B1C1D1E1F");
+        b.set_authentication_key("000102030405060708090A0B0C0D0E0F");
+        a.setup();
+        b.setup();
+
+        std::string frameA = host::securedFrame(frame, keyA, keyB, 0x30);
+        std::string frameB = host::securedFrame(frame, keyB, keyA, 0x30);
+        a.uart.feed(frameA + frameB);
+        b.uart.feed(frameB + frameA);
+        a.drain();
+        b.drain();
+
+        CHECK(a.diagnostics().telegrams == 1);
+        CHECK(b.diagnostics().telegrams == 1);
+        CHECK(a.diagnostics().gcmFailures == 1);
+        CHECK(b.diagnostics().gcmFailures == 1);
+    }
+#endif
+} // namespace
+
+int main()
+{
+    testInterleaved();
+#ifdef P1READER_GCM_MBEDTLS
+    testKeys();
+#endif
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// Latency from the meter's timestamps and the interarrival jitter: LatencyStats, TransitJitter
+// and both measured by a reader with a clock
+#include "host_test.h"
+
+#include <ctime>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    // A telegram stamped with a local time in seconds since 1970
+    std::string telegram(int64_t localS)
+    {
+        time_t time = (time_t)localS;
+        struct tm fields;
+        gmtime_r(&time, &fields);
+        char stamp[16];
+        snprintf(stamp, sizeof(stamp), "%02d%02d%02d%02d%02d%02dW", fields.tm_year % 100, fields.tm_mon + 1, fields.tm_mday,
+                 fields.tm_hour, fields.tm_min, fields.tm_sec);
+        return host::withCrc(std::string("/ISk5\\2MT382-1000\r\n\r\n0-0:1.0.0(") + stamp +
+                             ")\r\n1-0:1.8.0(006678.394*kWh)\r\n!");
+    }
+
+    void testLatencyStats()
+    {
+        LatencyStats stats;
+        CHECK(stats.count == 0);
+        CHECK_NEAR(stats.averageMs(), 0.0);
+
+        const int32_t samples[] = {850, -20, 1200, 410};
+        for (int32_t ms : samples)
+            stats.record(ms);
+        CHECK(stats.count == 4);
+        CHECK(stats.minMs == -20);
+        CHECK(stats.maxMs == 1200);
+        CHECK_NEAR(stats.averageMs(), 610.0);
+
+        stats.reset();
+        stats.record(300);
+        CHECK(stats.minMs == 300 && stats.maxMs == 300);
+    }
+
+    // RFC 3550: J += (|D| - J) / 16 over the differences in transit time
+    void testTransitJitter()
+    {
+        TransitJitter jitter;
+        jitter.record(5000, 1000000);
+        CHECK_NEAR(jitter.jitterMs, 0.0);
+
+        // A constant offset between the clocks is no jitter, whatever it is
+        for (int i = 1; i <= 10; i++)
+            jitter.record(5000 + i * 1000, 1000000 + i * 1000);
+        CHECK_NEAR(jitter.jitterMs, 0.0);
+        CHECK(jitter.maxMs == 0);
+
+        // Late by 160 ms, then back on time
+        jitter.record(5000 + 11 * 1000 + 160, 1000000 + 11 * 1000);
+        jitter.record(5000 + 12 * 1000, 1000000 + 12 * 1000);
+        float expected = 160 / 16.0f;
+        expected += (160 - expected) / 16.0f;
+        CHECK_NEAR(jitter.jitterMs, expected);
+        CHECK(jitter.maxMs == 160);
+
+        // A meter clock that is set back or jumps ahead is not counted
+        jitter.record(5000 + 13 * 1000, 1000000 - 3600000);
+        jitter.record(5000 + 14 * 1000, 1000000 + 3600000);
+        CHECK_NEAR(jitter.jitterMs, expected);
+
+        // millis() wrapping between telegrams
+        TransitJitter wrapped;
+        wrapped.record(0xffffff00u, 1000000);
+        wrapped.record(0xffffff00u + 1000, 1001000);
+        CHECK_NEAR(wrapped.jitterMs, 0.0);
+    }
+
+    // Arrival by millis() against the meter's timestamps, no clock needed
+    void testReaderJitter()
+    {
+        host::HostReader reader("ascii");
+        reader.setup();
+
+        const uint32_t lateMs[] = {0, 0, 0, 250, 0, 0};
+        int64_t stamp = 1704067200;
+        host::holdClock(10000000);
+        for (uint32_t late : lateMs)
+        {
+            host::advanceClock(late * 1000);
+            reader.uart.feed(telegram(stamp));
+            reader.drain();
+            host::advanceClock(1000000 - late * 1000);
+            stamp++;
+        }
+        host::useRealClock();
+
+        // Late by 250 ms, back on time, and one more on time
+        float expected = 250 / 16.0f;
+        expected += (250 - expected) / 16.0f;
+        expected -= expected / 16.0f;
+        CHECK(reader.diagnostics().telegrams == 6);
+        CHECK(reader.diagnostics().jitter.maxMs == 250);
+        CHECK(fabs(reader.diagnostics().jitter.jitterMs - expected) < 0.01f);
+    }
+
+    // With a synced clock the latency is the time since the timestamp, which meters stamp in
+    // whole seconds. A meter clock an hour or more off is not used.
+    void testReaderLatency()
+    {
+        time::RealTimeClock clock;
+        clock.utcOffset = 3600;
+        for (int64_t meterOffset : {0, -7200})
+        {
+            host::HostReader reader("ascii");
+            reader.set_time(&clock);
+            reader.setup();
+
+            reader.uart.feed(telegram(::time(nullptr) + clock.utcOffset + meterOffset));
+            reader.drain();
+
+            CHECK(reader.diagnostics().telegrams == 1);
+            const LatencyStats& frame = reader.diagnostics().latencyFrame;
+            const LatencyStats& publish = reader.diagnostics().latencyPublish;
+            if (meterOffset == 0)
+            {
+                CHECK(frame.count == 1 && publish.count == 1);
+                CHECK(frame.minMs >= 0 && frame.maxMs < 2000);
+                CHECK(publish.minMs >= frame.minMs);
+            }
+            else
+            {
+                CHECK(frame.count == 0 && publish.count == 0);
+            }
+        }
+
+        // Without a valid clock there is no latency
+        clock.valid = false;
+        host::HostReader reader("ascii");
+        reader.set_time(&clock);
+        reader.setup();
+        reader.uart.feed(telegram(::time(nullptr)));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK(reader.diagnostics().latencyFrame.count == 0);
+    }
+} // namespace
+
+int main()
+{
+    testLatencyStats();
+    testTransitJitter();
+    testReaderJitter();
+    testReaderLatency();
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Sensors for OBIS codes, added out of order like from several sensor blocks, and the table of
+// rows a reader uses
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    class ObisReader : public host::HostReader
+    {
+    public:
+        // Without field sensors only the obis sensors and what else is configured read fields
+        ObisReader(bool fieldSensors = true) : HostReader("ascii")
+        {
+            if (!fieldSensors)
+                memset(_fieldSensors, 0, sizeof(_fieldSensors));
+        }
+        uint8_t obisCount() const { return _obisSensorKeys.count(); }
+        const RowTable& rows() const { return _rows; }
+    };
+
+    size_t count(const std::string& text, const std::string& part)
+    {
+        size_t n = 0;
+        for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1))
+            n++;
+        return n;
+    }
+
+    void testKeys()
+    {
+        ObisSensorKeys keys;
+        CHECK(keys.add(obisKey(1, 0, 32, 7, 0)) == 0);
+        CHECK(keys.add(obisKey(0, 0, 96, 14, 0)) == 0);
+        CHECK(keys.add(obisKey(1, 0, 52, 7, 0)) == 2);
+        CHECK(keys.add(obisKey(1, 0, 32, 32, 0)) == 2);
+        CHECK(keys.add(obisKey(1, 0, 32, 7, 0)) == -1);
+        CHECK(keys.count() == 4);
+        CHECK(keys.find(obisKey(0, 0, 96, 14, 0)) == 0);
+        CHECK(keys.find(obisKey(1, 0, 32, 7, 0)) == 1);
+        CHECK(keys.find(obisKey(1, 0, 32, 32, 0)) == 2);
+        CHECK(keys.find(obisKey(1, 0, 52, 7, 0)) == 3);
+        CHECK(keys.find(obisKey(1, 0, 72, 7, 0)) == -1);
+
+        ObisSensorKeys full;
+        for (uint8_t i = 0; i < OBIS_SENSORS_MAX; i++)
+            CHECK(full.add(obisKey(1, 0, 100 + i, 7, 0)) >= 0);
+        CHECK(full.add(obisKey(1, 0, 1, 7, 0)) == -1);
+        CHECK(full.count() == OBIS_SENSORS_MAX);
+    }
+
+    void testSensors()
+    {
+        // Two blocks, each sorted on its own but not together
+        ObisReader reader;
+        P1Sensor tariff;
+        P1Sensor sags;
+        P1Sensor voltage;
+        P1Sensor duplicate;
+        reader.add_obis_sensor(obisKey(1, 0, 32, 32, 0), &sags);
+        reader.add_obis_sensor(obisKey(1, 0, 52, 7, 0), &voltage);
+        reader.add_obis_sensor(obisKey(0, 0, 96, 14, 0), &tariff);
+        reader.add_obis_sensor(obisKey(1, 0, 52, 7, 0), &duplicate);
+        CHECK(reader.obisCount() == 3);
+
+        reader.setup();
+        reader.uart.feed(host::readCorpus("dsmr50.txt"));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK_NEAR(tariff.state, 2);
+        CHECK_NEAR(sags.state, 2);
+        CHECK_NEAR(voltage.state, 220.2);
+        CHECK(duplicate.publishCount == 0);
+    }
+    void testRowTable()
+    {
+        RowTable rows;
+        rows.add(obisKey(1, 0, 32, 7, 0), FIELD_VOLTAGE_L1, -1);
+        rows.add(obisKey(1, 0, 1, 7, 0), FIELD_MOMENTARY_ACTIVE_IMPORT, -1);
+        rows.add(obisKey(1, 0, 32, 7, 0), -1, 0);
+        rows.add(obisKey(0, 0, 96, 14, 0), -1, 1);
+        CHECK(rows.count() == 3);
+
+        const RowTarget* voltage = rows.find(obisKey(1, 0, 32, 7, 0));
+        CHECK(voltage != nullptr && voltage->field == FIELD_VOLTAGE_L1 && voltage->sensor == 0);
+        const RowTarget* power = rows.find(obisKey(1, 0, 1, 7, 0));
+        CHECK(power != nullptr && power->field == FIELD_MOMENTARY_ACTIVE_IMPORT && power->sensor == -1);
+        CHECK(rows.find(obisKey(0, 0, 96, 14, 0))->sensor == 1);
+        CHECK(rows.find(obisKey(1, 0, 52, 7, 0)) == nullptr);
+    }
+
+    // Only rows that something reads are stored, each of them once
+    void testUsedRows()
+    {
+        ObisReader reader(false);
+        P1Sensor power;
+        P1Sensor voltage;
+        reader.set_sensor_momentary_active_import(&power);
+        reader.add_obis_sensor(obisKey(1, 0, 1, 7, 0), &voltage);
+        reader.set_trace_size(64);
+        reader.setup();
+
+        // The tariffs for the accessors, and the sensor's code that is also a field
+        CHECK(reader.rows().count() == 3);
+
+        reader.uart.feed(host::readCorpus("dsmr50.txt"));
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+        // Values of rows that nothing reads are never stored
+        CHECK(reader.published().values[FIELD_VOLTAGE_L1] == 0);
+        CHECK(reader.published().values[FIELD_CUMULATIVE_ACTIVE_IMPORT_T1] == 123456789);
+        CHECK_NEAR(power.state, 1.193);
+        CHECK_NEAR(voltage.state, 1.193);
+
+        std::string log;
+        host::logCapture = &log;
+        reader.dump_trace();
+        host::logCapture = nullptr;
+        CHECK(count(log, "row ") == 3);
+        CHECK(count(log, "1-0:1.7.0 ") == 1);
+        CHECK(count(log, "1-0:32.7.0 ") == 0);
+    }
+} // namespace
+
+int main()
+{
+    testKeys();
+    testSensors();
+    testRowTable();
+    testUsedRows();
+    return host::failures() == 0 ? 0 : 1;
+}
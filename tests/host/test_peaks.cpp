@@ -0,0 +1,152 @@
+// PeakTracker: energy split at period boundaries, the sorted top list, the monthly restart and
+// periods aligned to the local clock
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    // 2024-01-01 00:00:00 UTC
+    const uint32_t JANUARY = 1704067200;
+    const uint32_t FEBRUARY = JANUARY + 31 * 86400;
+
+    // A meter sending its import register every 36 s
+    struct Meter
+    {
+        PeakTracker tracker;
+        uint32_t ms{1000};
+        uint32_t epoch{0};
+        int32_t utcOffset{0};
+        uint8_t month{0};
+        int64_t energyMWh{1000000000};
+
+        void run(uint32_t seconds, float kw)
+        {
+            for (uint32_t s = 0; s < seconds; s += 36)
+            {
+                tracker.update(ms, epoch, utcOffset, month, true, energyMWh, true, (int64_t)(kw * 1000000));
+                ms += 36000;
+                if (epoch != 0)
+                    epoch += 36;
+                energyMWh += (int64_t)(kw * 10000);
+            }
+        }
+    };
+
+    // The period boot started in is not ranked, telegrams across a boundary split their energy
+    void testRollover()
+    {
+        Meter meter;
+        meter.tracker.configure(900, 3);
+        meter.epoch = JANUARY + 18;
+        meter.month = 1;
+        meter.run(900, 2.0f);
+        meter.run(900, 2.0f);
+        CHECK(meter.tracker.peakCount() == 0);
+        CHECK(!meter.tracker.takePeaksChanged());
+
+        meter.run(36, 2.0f);
+        CHECK(meter.tracker.peakCount() == 1);
+        CHECK(meter.tracker.peak(0).start == JANUARY + 900);
+        CHECK_NEAR(meter.tracker.peak(0).averageKw, 2.0);
+        CHECK(meter.tracker.takePeaksChanged());
+        CHECK(!meter.tracker.takePeaksChanged());
+
+        // 54 s at 2 kW into the period, then no power: the average so far and the projection
+        // to the end of the period
+        meter.run(432, 0.0f);
+        CHECK(fabs(meter.tracker.averageKw() - 2.0f * 54 / 450) < 0.001f);
+        CHECK(fabs(meter.tracker.projectedKw() - 2.0f * 54 / 900) < 0.001f);
+    }
+
+    // The list keeps the top N highest first, a period below all of them is not added
+    void testTopN()
+    {
+        Meter meter;
+        meter.tracker.configure(900, 3);
+        meter.epoch = JANUARY;
+        meter.month = 1;
+
+        const float powers[] = {2.0f, 5.0f, 1.0f, 4.0f, 3.0f, 0.5f};
+        for (float kw : powers)
+            meter.run(900, kw);
+        meter.run(36, 0.0f);
+
+        CHECK(meter.tracker.peakCount() == 3);
+        CHECK_NEAR(meter.tracker.peak(0).averageKw, 5.0);
+        CHECK_NEAR(meter.tracker.peak(1).averageKw, 4.0);
+        CHECK_NEAR(meter.tracker.peak(2).averageKw, 3.0);
+        CHECK_NEAR(meter.tracker.maxKw(), 5.0);
+        CHECK_NEAR(meter.tracker.topAverageKw(), 4.0);
+    }
+
+    // The first period of a new month restarts the list
+    void testMonthlyReset()
+    {
+        Meter meter;
+        meter.tracker.configure(3600, 3);
+        meter.epoch = FEBRUARY - 86400;
+        meter.month = 1;
+        meter.run(2 * 86400, 3.0f);
+        CHECK(meter.tracker.peakCount() == 3);
+        CHECK_NEAR(meter.tracker.maxKw(), 3.0);
+
+        // The last January period ends in February and still counts for January, the first
+        // February period restarts the list
+        CHECK(meter.epoch == FEBRUARY + 86400);
+        meter.month = 2;
+        meter.run(3600, 1.0f);
+        CHECK(meter.tracker.peakCount() == 3);
+        meter.run(3600, 1.0f);
+        CHECK(meter.tracker.takePeaksChanged());
+        CHECK(meter.tracker.peakCount() == 1);
+        CHECK_NEAR(meter.tracker.maxKw(), 1.0);
+        CHECK(meter.tracker.peak(0).start >= FEBRUARY);
+    }
+
+    // Hours start at the local hour, in UTC+5:30 at half past the UTC hour, and west of UTC too
+    void testLocalTime()
+    {
+        const int32_t offsets[] = {19800, -12600, 3600};
+        for (int32_t offset : offsets)
+        {
+            Meter meter;
+            meter.tracker.configure(3600, 3);
+            meter.epoch = JANUARY;
+            meter.utcOffset = offset;
+            meter.month = 1;
+            meter.run(4 * 3600, 2.0f);
+
+            CHECK(meter.tracker.peakCount() >= 2);
+            for (uint8_t i = 0; i < meter.tracker.peakCount(); i++)
+            {
+                CHECK((meter.tracker.peak(i).start + offset) % 3600 == 0);
+                CHECK_NEAR(meter.tracker.peak(i).averageKw, 2.0);
+            }
+        }
+    }
+
+    // Without a clock the periods run from boot and the list is never restarted
+    void testWithoutClock()
+    {
+        Meter meter;
+        meter.tracker.configure(900, 3);
+        meter.run(3 * 900, 2.0f);
+        meter.run(36, 2.0f);
+
+        CHECK(meter.tracker.peakCount() == 2);
+        CHECK(meter.tracker.peak(0).start == 0);
+        CHECK_NEAR(meter.tracker.peak(0).averageKw, 2.0);
+    }
+} // namespace
+
+int main()
+{
+    testRollover();
+    testTopN();
+    testMonthlyReset();
+    testLocalTime();
+    testWithoutClock();
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Adaptive polling: learning the telegram interval, sleeping between telegrams, widening the
+// guard when a telegram comes early and narrowing it again. A DSMR meter at 115200 baud sends
+// a telegram every 10 s on a held clock, polls run when the reader scheduled them.
+#include "host_test.h"
+
+using namespace esphome;
+
+namespace
+{
+    const uint32_t INTERVAL_MS = 10000;
+
+    struct Simulation
+    {
+        host::HostReader reader{"ascii"};
+        std::string data = host::readCorpus("dsmr50.txt");
+        uint32_t shiftMs{0};        // The meter sends this much earlier from now on
+        uint32_t telegram{0};
+        size_t fed{0};
+        uint32_t overflows{0};
+        uint32_t polls{0};
+        uint32_t nextPollMs{0};
+
+        Simulation()
+        {
+            reader.uart.baudRate = 115200;
+            reader.uart.rxBufferSize = 2048;
+            reader.set_read_mode("adaptive");
+            host::holdClock(0);
+            reader.setup();
+            scheduled(0);
+        }
+
+        void scheduled(uint32_t nowMs)
+        {
+            auto poll = reader.timeouts.find("poll");
+            CHECK(poll != reader.timeouts.end());
+            if (poll != reader.timeouts.end())
+                nextPollMs = nowMs + poll->second.first;
+        }
+
+        // Telegram n starts at (n + 1) * INTERVAL_MS - shiftMs, its bytes arrive at the baud rate
+        void receive(uint32_t nowMs)
+        {
+            uint32_t t = nowMs + shiftMs;
+            uint32_t index = t / INTERVAL_MS;
+            if (index == 0)
+                return;
+            if (index != telegram)
+            {
+                telegram = index;
+                fed = 0;
+            }
+            size_t bytes = std::min<size_t>((uint64_t)(t % INTERVAL_MS) * 115200 / 10000, data.size());
+            reader.uart.feed(data.data() + fed, bytes - fed);
+            fed = bytes;
+            if (reader.uart.pending() > reader.uart.rxBufferSize)
+                overflows++;
+        }
+
+        void run(uint32_t fromMs, uint32_t toMs)
+        {
+            for (uint32_t nowMs = fromMs; nowMs < toMs; nowMs++)
+            {
+                host::holdClock((uint64_t)nowMs * 1000);
+                receive(nowMs);
+                reader.runTimeout("read");
+                if (nowMs >= nextPollMs)
+                {
+                    polls++;
+                    reader.runTimeout("poll");
+                    scheduled(nowMs);
+                }
+            }
+        }
+    };
+
+    // After a few telegrams the reader knows the interval and sleeps until shortly before the
+    // next one, without losing any
+    void testLearnInterval()
+    {
+        Simulation simulation;
+        int pollingIntervalMs = simulation.reader.pollingIntervalMs();
+        CHECK(pollingIntervalMs > 100 && pollingIntervalMs < 200);
+
+        simulation.run(0, 5 * INTERVAL_MS + 500);
+        CHECK(simulation.reader.diagnostics().telegrams == 5);
+        uint32_t periodMs = simulation.reader.telegramPeriodMs();
+        CHECK(periodMs + pollingIntervalMs >= INTERVAL_MS && periodMs <= INTERVAL_MS + pollingIntervalMs);
+
+        // Polling at the interval would take 10000 / 142 polls per telegram
+        simulation.polls = 0;
+        simulation.run(5 * INTERVAL_MS + 500, 15 * INTERVAL_MS + 500);
+        CHECK(simulation.reader.diagnostics().telegrams == 15);
+        CHECK(simulation.polls < 10 * 10);
+        CHECK(simulation.overflows == 0);
+        CHECK(simulation.reader.pollGuardMs() == (uint32_t)pollingIntervalMs);
+    }
+
+    // A telegram that is already in the uart buffer when the reader wakes up widens the guard,
+    // which narrows again while telegrams come on time
+    void testWidenGuard()
+    {
+        Simulation simulation;
+        uint32_t guardMs = simulation.reader.pollGuardMs();
+        simulation.run(0, 6 * INTERVAL_MS + 500);
+        CHECK(simulation.reader.diagnostics().telegrams == 6);
+
+        simulation.shiftMs = 400;
+        simulation.run(6 * INTERVAL_MS + 500, 8 * INTERVAL_MS);
+        uint32_t widenedMs = simulation.reader.pollGuardMs();
+        CHECK(widenedMs >= 2 * guardMs);
+        CHECK(widenedMs <= simulation.reader.telegramPeriodMs() / 2);
+        CHECK(simulation.overflows == 0);
+
+        simulation.run(8 * INTERVAL_MS, 40 * INTERVAL_MS);
+        // Up to the one sent at 400 s less the shift
+        CHECK(simulation.reader.diagnostics().telegrams == 40);
+        CHECK(simulation.reader.pollGuardMs() < widenedMs);
+        CHECK(simulation.overflows == 0);
+    }
+} // namespace
+
+int main()
+{
+    testLearnInterval();
+    testWidenGuard();
+    host::useRealClock();
+    return host::failures() == 0 ? 0 : 1;
+}
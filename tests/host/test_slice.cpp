@@ -0,0 +1,51 @@
+// The byte limit per read follows the time reading takes, within the floor the baud rate needs
+#include "host_test.h"
+
+using namespace esphome;
+
+namespace
+{
+    // Reads with a held clock that advances costNs per byte, returns the limit reached and
+    // checks that no call reads more than the limit set by the calls before
+    uint16_t adapt(const char* protocol, uint32_t costNs, uint32_t baudRate = 115200)
+    {
+        host::HostReader reader(protocol);
+        reader.uart.rxBufferSize = 4096;
+        reader.uart.baudRate = baudRate;
+        reader.uart.readCostNs = costNs;
+        reader.setup();
+        reader.uart.feed(std::string(256 * 1024, 'A'));
+
+        host::holdClock(0);
+        for (int i = 0; i < 200 && reader.uart.pending() > 0; i++)
+        {
+            size_t pending = reader.uart.pending();
+            uint16_t limit = reader.sliceBytes();
+            reader.step();
+            CHECK(pending - reader.uart.pending() <= limit);
+            // Data left is read again from the main loop, not at the next poll
+            CHECK(reader.uart.pending() == 0 || reader.timeouts.count("read") == 1);
+        }
+        host::useRealClock();
+        return reader.sliceBytes();
+    }
+} // namespace
+
+int main()
+{
+    // 1000 us budget at 2 us per byte
+    uint16_t limit = adapt("ascii", 2000);
+    CHECK(limit >= 480 && limit <= 520);
+    limit = adapt("hdlc", 2000);
+    CHECK(limit >= 480 && limit <= 520);
+
+    // Cheap bytes are read up to rx_buffer_size at a time
+    CHECK(adapt("ascii", 100) == 4096);
+
+    // Slow bytes still as fast as 115200 baud sends them, 24 ms of data
+    CHECK(adapt("ascii", 10000) == 279);
+    // At 9600 baud that is 23 bytes, at least 32 are read
+    CHECK(adapt("ascii", 100000, 9600) == 32);
+
+    return host::failures() == 0 ? 0 : 1;
+}
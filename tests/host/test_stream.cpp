@@ -0,0 +1,146 @@
+// The TCP stream over loopback: clients get the uart bytes unchanged while the reader decodes them
+#include "host_test.h"
+
+#include <poll.h>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    int connectTo(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_storage address;
+        socklen_t length = socket::set_sockaddr_any((struct sockaddr*)&address, sizeof(address), port);
+        if (::connect(fd, (struct sockaddr*)&address, length) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Everything the client can read within timeoutMs of the last byte
+    std::string receive(int fd, int timeoutMs = 200)
+    {
+        std::string received;
+        struct pollfd poller = { fd, POLLIN, 0 };
+        char buffer[4096];
+        while (::poll(&poller, 1, timeoutMs) > 0)
+        {
+            ssize_t len = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (len <= 0)
+                break;
+            received.append(buffer, len);
+        }
+        return received;
+    }
+
+    // Reads like in loop mode, the stream is served from loop() after every read
+    void run(host::HostReader& reader)
+    {
+        while (reader.uart.pending() > 0)
+        {
+            reader.update();
+            reader.loop();
+        }
+        reader.drain();
+        reader.loop();
+    }
+
+    void testLoopback(const char* file, const char* protocol)
+    {
+        std::string data = host::readCorpus(file);
+        if (data.back() != '\n' && std::string(protocol) == "ascii")
+            data = host::withCrc(data);
+
+        host::HostReader reader(protocol);
+        reader.set_stream(host::freePort(), 2048);
+        reader.setup();
+        CHECK(reader.stream().enabled());
+
+        int client = connectTo(reader.stream().port());
+        CHECK(client >= 0);
+        if (client < 0)
+            return;
+        reader.loop();
+        CHECK(reader.stream().clientCount() == 1);
+
+        // Several telegrams, more than the ring holds in total
+        std::string fed;
+        for (int i = 0; i < 4; i++)
+        {
+            reader.uart.feed(data);
+            fed += data;
+            run(reader);
+        }
+        std::string received = receive(client);
+
+        CHECK(received == fed);
+        CHECK(reader.diagnostics().telegrams == 4);
+        CHECK(reader.stream().droppedClients() == 0);
+
+        // A closed client frees its slot on the next loop
+        ::close(client);
+        receive(-1, 50);
+        reader.loop();
+        CHECK(reader.stream().clientCount() == 0);
+    }
+
+    // A ring smaller than one read is raised to the read, reads of a full uart buffer don't drop clients
+    void testSmallBuffer()
+    {
+        host::HostReader reader("hdlc");
+        reader.uart.rxBufferSize = 1024;
+        reader.set_stream(host::freePort(), 256);
+        reader.setup();
+        CHECK(reader.stream().ringSize() == 1024);
+
+        int client = connectTo(reader.stream().port());
+        CHECK(client >= 0);
+        if (client < 0)
+            return;
+        reader.loop();
+
+        host::holdClock(0);
+        reader.fixSliceBytes(1024);
+        std::string data = host::readCorpus("aidon.hex") + host::readCorpus("aidon.hex");
+        reader.uart.feed(data);
+        run(reader);
+        host::useRealClock();
+
+        CHECK(receive(client) == data);
+        CHECK(reader.stream().droppedClients() == 0);
+        CHECK(reader.diagnostics().telegrams == 2);
+        ::close(client);
+    }
+
+    // USE_P1READER_STREAM is set for the build, a reader without stream: doesn't listen
+    void testTwoReaders()
+    {
+        host::HostReader withStream("ascii");
+        host::HostReader without("ascii");
+        withStream.set_stream(host::freePort(), 2048);
+        withStream.setup();
+        without.setup();
+
+        CHECK(withStream.stream().enabled());
+        CHECK(!without.stream().enabled());
+        CHECK(without.stream().port() == 0);
+        CHECK(without.stream().ringSize() == 0);
+
+        without.uart.feed(host::readCorpus("dsmr50.txt"));
+        run(without);
+        CHECK(without.diagnostics().telegrams == 1);
+    }
+} // namespace
+
+int main()
+{
+    testLoopback("dsmr50.txt", "ascii");
+    testLoopback("aidon.hex", "hdlc");
+    testSmallBuffer();
+    testTwoReaders();
+    return host::failures() == 0 ? 0 : 1;
+}
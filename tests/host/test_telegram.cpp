@@ -0,0 +1,61 @@
+// The telegram text sensor: one JSON array per telegram, cut short to fit in a state
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const char* TELEGRAM = "/ISk5\\2MT382-1000\r\n\r\n1-0:1.8.0(006678.394*kWh)\r\n1-0:32.7.0(123456.789*V)\r\n!";
+
+    void testFields()
+    {
+        host::HostReader reader("ascii");
+        text_sensor::TextSensor telegram;
+        reader.set_telegram(&telegram);
+        reader.add_telegram_field(FIELD_CUMULATIVE_ACTIVE_IMPORT);
+        reader.add_telegram_field(FIELD_CURRENT_L1);
+        reader.add_telegram_field(FIELD_VOLTAGE_L1);
+        reader.setup();
+
+        reader.uart.feed(host::withCrc(TELEGRAM));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK(telegram.state == "[6678.394,null,123456.789]");
+    }
+
+    // With 11 characters per value 23 values fit in 255 characters, a 24th doesn't
+    void testTruncated()
+    {
+        host::HostReader reader("ascii");
+        text_sensor::TextSensor telegram;
+        reader.set_telegram(&telegram);
+        for (int i = 0; i < 30; i++)
+            reader.add_telegram_field(FIELD_VOLTAGE_L1);
+        reader.setup();
+
+        for (int n = 0; n < 2; n++)
+        {
+            reader.uart.feed(host::withCrc(TELEGRAM));
+            reader.drain();
+        }
+
+        std::string expected = "[123456.789";
+        for (int i = 1; i < 23; i++)
+            expected += ",123456.789";
+        expected += ']';
+
+        CHECK(reader.diagnostics().telegrams == 2);
+        CHECK(telegram.publishCount == 2);
+        CHECK(expected.size() == 254);
+        CHECK(telegram.state == expected);
+    }
+} // namespace
+
+int main()
+{
+    testFields();
+    testTruncated();
+    return host::failures() == 0 ? 0 : 1;
+}
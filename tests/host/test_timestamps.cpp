@@ -0,0 +1,160 @@
+// Text rows: ASCII YYMMDDhhmmssX timestamps, COSEM date-time in HDLC, equipment id and tariff
+// indicator, and civilSeconds against timegm
+#include "host_test.h"
+
+#include <ctime>
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    std::string obis(uint8_t a, uint8_t b, uint8_t c, uint8_t d, uint8_t e)
+    {
+        return std::string("\x09\x06", 2) + (char)a + (char)b + (char)c + (char)d + (char)e + '\xff';
+    }
+
+    // COSEM date-time with an unspecified weekday, deviation and clock status
+    std::string dateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second,
+                         uint8_t hundredths)
+    {
+        return std::string("\x09\x0c", 2) + (char)(year >> 8) + (char)year + (char)month + (char)day + '\xff' +
+               (char)hour + (char)minute + (char)second + (char)hundredths + std::string("\x80\x00\x00", 3);
+    }
+
+    int64_t utc(int year, int month, int day, int hour, int minute, int second)
+    {
+        struct tm fields{};
+        fields.tm_year = year - 1900;
+        fields.tm_mon = month - 1;
+        fields.tm_mday = day;
+        fields.tm_hour = hour;
+        fields.tm_min = minute;
+        fields.tm_sec = second;
+        return timegm(&fields);
+    }
+
+    void testCivilSeconds()
+    {
+        CHECK(civilSeconds(1970, 1, 1, 0, 0, 0) == 0);
+        CHECK(civilSeconds(2000, 2, 29, 12, 0, 0) == utc(2000, 2, 29, 12, 0, 0));
+        CHECK(civilSeconds(2024, 12, 31, 23, 59, 59) == utc(2024, 12, 31, 23, 59, 59));
+        CHECK(civilSeconds(2100, 3, 1, 0, 0, 0) == utc(2100, 3, 1, 0, 0, 0));
+
+        // Every day of a leap year and the years around it
+        for (int64_t t = utc(2023, 1, 1, 0, 0, 0); t < utc(2026, 1, 1, 0, 0, 0); t += 86400 + 3661)
+        {
+            time_t time = (time_t)t;
+            struct tm fields;
+            gmtime_r(&time, &fields);
+            CHECK(civilSeconds(fields.tm_year + 1900, fields.tm_mon + 1, fields.tm_mday, fields.tm_hour, fields.tm_min,
+                               fields.tm_sec) == t);
+        }
+    }
+
+    // YYMMDDhhmmss and W or S, the time is the meter's local time whatever the letter
+    void testAsciiTimestamp()
+    {
+        ParsedMessage message;
+        message.initNewTelegram();
+        message.parseText(TEXT_TIMESTAMP, "240229235958S)");
+        CHECK(message.hasMeterTime);
+        CHECK(message.meterTimeMs == utc(2024, 2, 29, 23, 59, 58) * 1000);
+        CHECK(strcmp(message.texts[TEXT_TIMESTAMP], "2024-02-29 23:59:58") == 0);
+        CHECK(message.textReceived == 1 << TEXT_TIMESTAMP);
+
+        // Not digits or not 13 characters: kept as sent, without a meter time
+        const char* bad[] = {"24022923595XW)", "2402292359W)", "240229235958WW)", ")"};
+        for (const char* value : bad)
+        {
+            message.initNewTelegram();
+            message.parseText(TEXT_TIMESTAMP, value);
+            CHECK(!message.hasMeterTime);
+            CHECK(strncmp(message.texts[TEXT_TIMESTAMP], value, strlen(value) - 1) == 0);
+            CHECK(strlen(message.texts[TEXT_TIMESTAMP]) == strlen(value) - 1);
+        }
+
+        // Digits out of range are shown, but are not a time
+        message.initNewTelegram();
+        message.parseText(TEXT_TIMESTAMP, "241301246000W)");
+        CHECK(!message.hasMeterTime);
+        CHECK(strcmp(message.texts[TEXT_TIMESTAMP], "2024-13-01 24:60:00") == 0);
+    }
+
+    // Characters that can't be shown become '?', long values are cut
+    void testText()
+    {
+        ParsedMessage message;
+        message.initNewTelegram();
+        message.parseText(TEXT_TARIFF_INDICATOR, "0002)");
+        message.setText(TEXT_EQUIPMENT_ID, "A\x01\xff", 3);
+        CHECK(strcmp(message.texts[TEXT_TARIFF_INDICATOR], "0002") == 0);
+        CHECK(strcmp(message.texts[TEXT_EQUIPMENT_ID], "A??") == 0);
+
+        std::string id(60, '7');
+        message.parseText(TEXT_EQUIPMENT_ID, (id + ")").c_str());
+        CHECK(strlen(message.texts[TEXT_EQUIPMENT_ID]) == TEXT_FIELD_SIZE - 1);
+        CHECK(message.textReceived == ((1 << TEXT_TARIFF_INDICATOR) | (1 << TEXT_EQUIPMENT_ID)));
+    }
+
+    void testAsciiTelegram()
+    {
+        host::HostReader reader("ascii");
+        text_sensor::TextSensor equipmentId;
+        text_sensor::TextSensor timestamp;
+        text_sensor::TextSensor tariff;
+        reader.set_equipment_id(&equipmentId);
+        reader.set_timestamp(&timestamp);
+        reader.set_tariff_indicator(&tariff);
+        reader.setup();
+
+        reader.uart.feed(host::withCrc("/ISk5\\2MT382-1000\r\n\r\n0-0:1.0.0(231029020000S)\r\n"
+                                       "0-0:96.1.1(4B384547303034303436333935353037)\r\n0-0:96.14.0(0001)\r\n"
+                                       "1-0:1.8.0(006678.394*kWh)\r\n!"));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK(timestamp.state == "2023-10-29 02:00:00");
+        CHECK(equipmentId.state == "4B384547303034303436333935353037");
+        CHECK(tariff.state == "0001");
+    }
+
+    // COSEM date-time: weekday, deviation and clock status are not used, hundredths 0xff is none
+    void testCosemDateTime()
+    {
+        for (uint8_t hundredths : {(uint8_t)0xff, (uint8_t)50})
+        {
+            host::HostReader reader("hdlc");
+            text_sensor::TextSensor timestamp;
+            reader.set_timestamp(&timestamp);
+            reader.setup();
+
+            std::string rows = obis(0, 0, 1, 0, 0) + dateTime(2024, 2, 29, 23, 59, 58, hundredths) +
+                               obis(0, 0, 96, 14, 0) + std::string("\x12\x00\x02", 3);
+            reader.uart.feed(host::hdlcFrame(std::string("\xe6\xe7\x00\x0f\x00\x00\x00\x01\x00\x02\x04", 11) + rows));
+            reader.drain();
+
+            CHECK(reader.diagnostics().telegrams == 1);
+            CHECK(timestamp.state == "2024-02-29 23:59:58");
+        }
+
+        // Hundredths are part of the meter time, unspecified (0xff) date fields make it unknown
+        ParsedMessage message;
+        message.initNewTelegram();
+        message.setTimestamp(2024, 2, 29, 23, 59, 58, 50);
+        CHECK(message.hasMeterTime);
+        CHECK(message.meterTimeMs == utc(2024, 2, 29, 23, 59, 58) * 1000 + 500);
+        message.setTimestamp(2024, 0xff, 0xff, 23, 59, 58);
+        CHECK(!message.hasMeterTime);
+    }
+} // namespace
+
+int main()
+{
+    testCivilSeconds();
+    testAsciiTimestamp();
+    testText();
+    testAsciiTelegram();
+    testCosemDateTime();
+    return host::failures() == 0 ? 0 : 1;
+}
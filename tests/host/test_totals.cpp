@@ -0,0 +1,66 @@
+// Cumulative totals from tariff registers, only summed when both tariffs are in the telegram
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    const char* HEADER = "/ISk5\\2MT382-1000\r\n\r\n";
+
+    void testBothTariffs()
+    {
+        host::HostReader reader("ascii");
+        reader.setup();
+        reader.uart.feed(host::withCrc(std::string(HEADER) +
+            "1-0:1.8.1(001000.500*kWh)\r\n1-0:1.8.2(002000.250*kWh)\r\n"
+            "1-0:2.8.1(000010.000*kWh)\r\n1-0:2.8.2(000001.125*kWh)\r\n!"));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 1);
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_IMPORT].state, 3000.75);
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_EXPORT].state, 11.125);
+    }
+
+    void testMissingTariff()
+    {
+        host::HostReader reader("ascii");
+        reader.setup();
+        reader.uart.feed(host::withCrc(std::string(HEADER) +
+            "1-0:1.8.1(001000.500*kWh)\r\n1-0:1.8.2(002000.250*kWh)\r\n"
+            "1-0:2.8.1(000010.000*kWh)\r\n1-0:2.8.2(000001.125*kWh)\r\n!"));
+        reader.drain();
+        // T2 is missing in the second telegram, the T2 values of the first are still in the message
+        reader.uart.feed(host::withCrc(std::string(HEADER) +
+            "1-0:1.8.1(001001.500*kWh)\r\n1-0:2.8.2(000002.125*kWh)\r\n!"));
+        reader.drain();
+
+        CHECK(reader.diagnostics().telegrams == 2);
+        CHECK(reader.sensors[FIELD_CUMULATIVE_ACTIVE_IMPORT].publishCount == 1);
+        CHECK(reader.sensors[FIELD_CUMULATIVE_ACTIVE_EXPORT].publishCount == 1);
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_IMPORT].state, 3000.75);
+        // 1.8.1 is the night tariff, T2
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_IMPORT_T2].state, 1001.5);
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_EXPORT_T2].state, 2.125);
+    }
+
+    void testTotalInTelegram()
+    {
+        // A meter that sends the total itself is published as sent
+        host::HostReader reader("ascii");
+        reader.setup();
+        reader.uart.feed(host::withCrc(std::string(HEADER) +
+            "1-0:1.8.0(005000.000*kWh)\r\n1-0:1.8.1(001000.500*kWh)\r\n1-0:1.8.2(002000.250*kWh)\r\n!"));
+        reader.drain();
+
+        CHECK_NEAR(reader.sensors[FIELD_CUMULATIVE_ACTIVE_IMPORT].state, 5000.0);
+    }
+} // namespace
+
+int main()
+{
+    testBothTariffs();
+    testMissingTariff();
+    testTotalInTelegram();
+    return host::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// The trace ring keeps row values in fixed point, dumped with the meter's digits
+#include "host_test.h"
+
+using namespace esphome;
+using namespace esphome::p1_reader;
+
+namespace
+{
+    void testDump()
+    {
+        host::HostReader reader("ascii");
+        reader.set_trace_size(16);
+        reader.setup();
+
+        // Digits that a float would round: 12345678.901 has 11 significant digits
+        std::string telegram = host::withCrc("/ISk5\\2MT382-1000\r\n\r\n"
+            "1-0:1.8.0(12345678.901*kWh)\r\n1-0:32.7.0(230.1*V)\r\n1-0:2.7.0(-00.012*kW)\r\n!");
+        reader.uart.feed(telegram);
+        reader.drain();
+        CHECK(reader.diagnostics().telegrams == 1);
+
+        std::string log;
+        host::logCapture = &log;
+        reader.dump_trace();
+        host::logCapture = nullptr;
+
+        std::string crc = telegram.substr(telegram.size() - 6, 4);
+        CHECK(log.find("row            1-0:1.8.0 12345678.901\n") != std::string::npos);
+        CHECK(log.find("row            1-0:32.7.0 230.1\n") != std::string::npos);
+        CHECK(log.find("row            1-0:2.7.0 -0.012\n") != std::string::npos);
+        CHECK(log.find("crc_ok         0-0:0.0.0 " + crc + "\n") != std::string::npos);
+        CHECK(log.find("publish        0-0:0.0.0 " + crc + "\n") != std::string::npos);
+        CHECK(log.find("telegram_start 0-0:0.0.0 \n") != std::string::npos);
+    }
+
+    // Only the newest entries are kept
+    void testWrap()
+    {
+        TraceBuffer trace;
+        CHECK(trace.allocate(6));
+        CHECK(trace.capacity() == 4);
+        for (int i = 0; i < 10; i++)
+            trace.record(TRACE_ROW, obisKey(1, 0, 1, 8, 0), i, -1);
+
+        std::string log;
+        host::logCapture = &log;
+        trace.dump();
+        host::logCapture = nullptr;
+
+        CHECK(log.find("Last 4 of 10 trace entries") != std::string::npos);
+        CHECK(log.find(" 0.5\n") == std::string::npos);
+        CHECK(log.find(" 0.6\n") != std::string::npos);
+        CHECK(log.find(" 0.9\n") != std::string::npos);
+    }
+} // namespace
+
+int main()
+{
+    testDump();
+    testWrap();
+    return host::failures() == 0 ? 0 : 1;
+}